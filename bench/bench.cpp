@@ -0,0 +1,486 @@
+// 压测工具：多线程 HTTP(S) 负载生成器，内置常见场景，每个场景输出 RPS 与延迟分位数（JSON）。
+//
+//   ./bench                                  # 所有场景，默认 https://127.0.0.1:8080
+//   ./bench --scenario static,gzip --connections 64 --pipeline 8 --duration 10 --out result.json
+//
+// 需要在服务器的工作目录（或用 --site-root 指定站点根目录）下运行，以便生成大文件场景用的测试文件。
+// 衡量 TLS 开销：在 config.ini 的 [listen] 中同时配置 TLS 与明文监听（如 plain = 127.0.0.1:8081），
+// 分别运行 ./bench --port 8080 与 ./bench --port 8081 --plain 对比；单次写出的开销见 microbench 的 BM_ResponseSendTls
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "metrics.hpp"
+
+namespace {
+
+struct Options {
+    std::string host = "127.0.0.1";
+    int port = 8080;
+    bool tls = true;
+    size_t connections = 16;
+    size_t pipeline = 1;
+    double duration = 5;
+    double warmup = 1;
+    std::string scenarios = "all";
+    std::string siteRoot = "./sites/demo1";
+    std::string out;
+};
+
+struct Scenario {
+    std::string name;
+    std::string method;
+    std::string path;
+    std::vector<std::pair<std::string, std::string>> headers;
+    std::string body;
+};
+
+// 客户端连接，可选 TLS，阻塞读写
+class Connection {
+public:
+    Connection(const Options &options, SSL_CTX *ctx) : m_options(options), m_ctx(ctx) {}
+    ~Connection() { close(); }
+
+    bool connected() const { return m_fd != -1; }
+
+    bool connect() {
+        close();
+        struct addrinfo hints {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        struct addrinfo *result = nullptr;
+        if (getaddrinfo(m_options.host.c_str(), std::to_string(m_options.port).c_str(), &hints, &result) != 0) {
+            return false;
+        }
+        for (auto *ai = result; ai; ai = ai->ai_next) {
+            m_fd = ::socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+            if (m_fd == -1) {
+                continue;
+            }
+            if (::connect(m_fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+                break;
+            }
+            ::close(m_fd);
+            m_fd = -1;
+        }
+        freeaddrinfo(result);
+        if (m_fd == -1) {
+            return false;
+        }
+        int one = 1;
+        setsockopt(m_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        if (m_ctx) {
+            m_ssl = SSL_new(m_ctx);
+            SSL_set_fd(m_ssl, m_fd);
+            SSL_set_tlsext_host_name(m_ssl, m_options.host.c_str());
+            if (SSL_connect(m_ssl) != 1) {
+                close();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void close() {
+        if (m_ssl) {
+            SSL_free(m_ssl);
+            m_ssl = nullptr;
+        }
+        if (m_fd != -1) {
+            ::close(m_fd);
+            m_fd = -1;
+        }
+        m_buffer.clear();
+    }
+
+    bool send(const std::string &data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t n = m_ssl ? SSL_write(m_ssl, data.data() + sent, static_cast<int>(data.size() - sent))
+                              : ::send(m_fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) {
+                return false;
+            }
+            sent += n;
+        }
+        return true;
+    }
+
+    // 读取一个完整响应；keepAlive 为 false 表示服务器会关闭连接
+    bool readResponse(int &status, size_t &bytes, bool &keepAlive) {
+        size_t headerEnd;
+        while ((headerEnd = m_buffer.find("\r\n\r\n")) == std::string::npos) {
+            if (!fill()) {
+                return false;
+            }
+        }
+        std::string head = m_buffer.substr(0, headerEnd);
+        size_t pos = headerEnd + 4;
+        if (head.size() < 12 || head.compare(0, 5, "HTTP/") != 0) {
+            return false;
+        }
+        status = std::atoi(head.c_str() + 9);
+        keepAlive = head.compare(0, 8, "HTTP/1.0") != 0;
+        bool chunked = false;
+        long long contentLength = -1;
+        std::istringstream lines(head);
+        std::string line;
+        std::getline(lines, line);
+        while (std::getline(lines, line)) {
+            size_t colon = line.find(':');
+            if (colon == std::string::npos) {
+                continue;
+            }
+            std::string name = line.substr(0, colon);
+            std::string value = line.substr(colon + 1);
+            value.erase(0, value.find_first_not_of(' '));
+            if (!value.empty() && value.back() == '\r') {
+                value.pop_back();
+            }
+            if (strcasecmp(name.c_str(), "Content-Length") == 0) {
+                contentLength = std::atoll(value.c_str());
+            } else if (strcasecmp(name.c_str(), "Transfer-Encoding") == 0) {
+                chunked = value.find("chunked") != std::string::npos;
+            } else if (strcasecmp(name.c_str(), "Connection") == 0) {
+                keepAlive = strcasecmp(value.c_str(), "close") != 0;
+            }
+        }
+
+        if (chunked) {
+            bytes = 0;
+            while (true) {
+                size_t lineEnd;
+                while ((lineEnd = m_buffer.find("\r\n", pos)) == std::string::npos) {
+                    if (!fill()) {
+                        return false;
+                    }
+                }
+                size_t size = std::strtoull(m_buffer.c_str() + pos, nullptr, 16);
+                pos = lineEnd + 2;
+                while (m_buffer.size() < pos + size + 2) {
+                    if (!fill()) {
+                        return false;
+                    }
+                }
+                pos += size + 2;
+                bytes += size;
+                if (size == 0) {
+                    break;
+                }
+            }
+        } else if (contentLength >= 0) {
+            while (m_buffer.size() < pos + contentLength) {
+                if (!fill()) {
+                    return false;
+                }
+            }
+            pos += contentLength;
+            bytes = contentLength;
+        } else {
+            // 没有长度信息，读到连接关闭为止
+            while (fill()) {
+            }
+            bytes = m_buffer.size() - pos;
+            pos = m_buffer.size();
+            keepAlive = false;
+        }
+        m_buffer.erase(0, pos);
+        return true;
+    }
+
+private:
+    const Options &m_options;
+    SSL_CTX *m_ctx;
+    int m_fd = -1;
+    SSL *m_ssl = nullptr;
+    std::string m_buffer;
+
+    bool fill() {
+        char chunk[65536];
+        ssize_t n = m_ssl ? SSL_read(m_ssl, chunk, sizeof(chunk)) : ::recv(m_fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) {
+            return false;
+        }
+        m_buffer.append(chunk, n);
+        return true;
+    }
+};
+
+// 单个连接线程的统计，结束后汇总
+struct WorkerResult {
+    uint64_t requests = 0;
+    uint64_t errors = 0;
+    uint64_t bytes = 0;
+    uint64_t maxLatencyUs = 0;
+    std::map<int, uint64_t> status;
+};
+
+std::string buildRequest(const Options &options, const Scenario &scenario) {
+    std::string request = scenario.method + " " + scenario.path + " HTTP/1.1\r\n";
+    request += "Host: " + options.host + ":" + std::to_string(options.port) + "\r\n";
+    request += "User-Agent: http_server-bench\r\n";
+    for (const auto &header: scenario.headers) {
+        request += header.first + ": " + header.second + "\r\n";
+    }
+    if (!scenario.body.empty() || scenario.method == "POST") {
+        request += "Content-Length: " + std::to_string(scenario.body.size()) + "\r\n";
+    }
+    request += "\r\n";
+    request += scenario.body;
+    return request;
+}
+
+void runWorker(const Options &options, SSL_CTX *ctx, const Scenario &scenario,
+               std::chrono::steady_clock::time_point measureFrom, std::chrono::steady_clock::time_point deadline,
+               metrics::Histogram &latency, WorkerResult &result) {
+    Connection connection(options, ctx);
+    std::string batch;
+    std::string request = buildRequest(options, scenario);
+    for (size_t i = 0; i < options.pipeline; ++i) {
+        batch += request;
+    }
+
+    while (std::chrono::steady_clock::now() < deadline) {
+        // 预热阶段的失败与请求一样不计入结果
+        if (!connection.connected() && !connection.connect()) {
+            if (std::chrono::steady_clock::now() >= measureFrom) {
+                ++result.errors;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+        auto start = std::chrono::steady_clock::now();
+        bool measure = start >= measureFrom;
+        if (!connection.send(batch)) {
+            if (measure) {
+                ++result.errors;
+            }
+            connection.close();
+            continue;
+        }
+        // 流水线模式下每个响应的延迟都从整批发出时算起
+        for (size_t i = 0; i < options.pipeline; ++i) {
+            int status = 0;
+            size_t bytes = 0;
+            bool keepAlive = true;
+            if (!connection.readResponse(status, bytes, keepAlive)) {
+                if (measure) {
+                    ++result.errors;
+                }
+                connection.close();
+                break;
+            }
+            auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                                                 start);
+            if (measure) {
+                latency.record(elapsed);
+                ++result.requests;
+                result.bytes += bytes;
+                ++result.status[status];
+                result.maxLatencyUs = std::max<uint64_t>(result.maxLatencyUs, elapsed.count());
+            }
+            if (!keepAlive) {
+                connection.close();
+                break;
+            }
+        }
+    }
+}
+
+std::string formatDouble(double value) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.2f", value);
+    return buffer;
+}
+
+std::string runScenario(const Options &options, SSL_CTX *ctx, const Scenario &scenario) {
+    std::cerr << "[bench] " << scenario.name << ": " << scenario.method << " " << scenario.path << ", "
+              << options.connections << " connection(s) x " << options.pipeline << " pipelined, " << options.duration
+              << "s" << std::endl;
+
+    auto latency = std::make_unique<metrics::Histogram>();
+    std::vector<WorkerResult> results(options.connections);
+    std::vector<std::thread> workers;
+    auto measureFrom = std::chrono::steady_clock::now() + std::chrono::duration<double>(options.warmup);
+    auto deadline = std::chrono::time_point_cast<std::chrono::steady_clock::duration>(
+            measureFrom + std::chrono::duration<double>(options.duration));
+    auto measureStart = std::chrono::time_point_cast<std::chrono::steady_clock::duration>(measureFrom);
+    for (size_t i = 0; i < options.connections; ++i) {
+        workers.emplace_back(runWorker, std::cref(options), ctx, std::cref(scenario), measureStart, deadline,
+                             std::ref(*latency), std::ref(results[i]));
+    }
+    for (auto &worker: workers) {
+        worker.join();
+    }
+
+    WorkerResult total;
+    for (const auto &result: results) {
+        total.requests += result.requests;
+        total.errors += result.errors;
+        total.bytes += result.bytes;
+        total.maxLatencyUs = std::max(total.maxLatencyUs, result.maxLatencyUs);
+        for (const auto &entry: result.status) {
+            total.status[entry.first] += entry.second;
+        }
+    }
+    auto snapshot = latency->snapshot();
+    // 分位数取桶上界，不超过实测最大值
+    auto quantile = [&](double q) { return std::to_string(std::min(snapshot.quantile(q), total.maxLatencyUs)); };
+    double seconds = options.duration;
+
+    std::string json = "{\"name\":\"" + scenario.name + "\",\"method\":\"" + scenario.method + "\",\"path\":\"" +
+                       scenario.path + "\",\"requests\":" + std::to_string(total.requests) +
+                       ",\"errors\":" + std::to_string(total.errors) + ",\"rps\":" +
+                       formatDouble(total.requests / seconds) + ",\"mb_per_sec\":" +
+                       formatDouble(total.bytes / seconds / 1024 / 1024) + ",\"status\":{";
+    bool first = true;
+    for (const auto &entry: total.status) {
+        json += (first ? "\"" : ",\"") + std::to_string(entry.first) + "\":" + std::to_string(entry.second);
+        first = false;
+    }
+    json += "},\"latency_us\":{\"mean\":" +
+            formatDouble(snapshot.count ? static_cast<double>(snapshot.sum) / snapshot.count : 0) +
+            ",\"p50\":" + quantile(0.5) + ",\"p90\":" + quantile(0.9) + ",\"p99\":" + quantile(0.99) +
+            ",\"p999\":" + quantile(0.999) + ",\"max\":" + std::to_string(total.maxLatencyUs) + "}}";
+    return json;
+}
+
+bool parseOptions(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        std::string value;
+        size_t eq = arg.find('=');
+        if (eq != std::string::npos) {
+            value = arg.substr(eq + 1);
+            arg = arg.substr(0, eq);
+        } else if (arg != "--plain" && arg != "--help" && i + 1 < argc) {
+            value = argv[++i];
+        }
+        try {
+            if (arg == "--host") {
+                options.host = value;
+            } else if (arg == "--port") {
+                options.port = std::stoi(value);
+            } else if (arg == "--plain") {
+                options.tls = false;
+            } else if (arg == "--connections") {
+                options.connections = std::max(1, std::stoi(value));
+            } else if (arg == "--pipeline") {
+                options.pipeline = std::max(1, std::stoi(value));
+            } else if (arg == "--duration") {
+                options.duration = std::stod(value);
+            } else if (arg == "--warmup") {
+                options.warmup = std::stod(value);
+            } else if (arg == "--scenario") {
+                options.scenarios = value;
+            } else if (arg == "--site-root") {
+                options.siteRoot = value;
+            } else if (arg == "--out") {
+                options.out = value;
+            } else {
+                return false;
+            }
+        } catch (...) {
+            return false;
+        }
+    }
+    return options.duration > 0;
+}
+
+void usage() {
+    std::cerr << "Usage: bench [--host 127.0.0.1] [--port 8080] [--plain] [--connections 16] [--pipeline 1]\n"
+                 "             [--duration 5] [--warmup 1] [--scenario all|static,large,gzip,cgi,upload]\n"
+                 "             [--site-root ./sites/demo1] [--out result.json]\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage();
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    // 大文件场景的测试文件
+    std::filesystem::path largeFile = std::filesystem::path(options.siteRoot) / "bench" / "large.bin";
+    std::error_code ec;
+    if (std::filesystem::file_size(largeFile, ec) != 10 * 1024 * 1024) {
+        std::filesystem::create_directories(largeFile.parent_path(), ec);
+        std::ofstream ofs(largeFile, std::ios::binary);
+        std::string block(1024 * 1024, 'x');
+        for (int i = 0; i < 10; ++i) {
+            ofs << block;
+        }
+        if (!ofs) {
+            std::cerr << "[bench] Cannot create " << largeFile << ", the large scenario will fail" << std::endl;
+        }
+    }
+
+    std::vector<Scenario> all = {
+            {"static", "GET", "/index.html", {}, ""},
+            {"large", "GET", "/bench/large.bin", {}, ""},
+            {"gzip", "GET", "/index.html", {{"Accept-Encoding", "gzip"}}, ""},
+            {"cgi", "GET", "/cgi/1.sh", {}, ""},
+            {"upload", "POST", "/upload", {{"Content-Type", "application/octet-stream"}}, std::string(64 * 1024, 'u')},
+    };
+    std::vector<Scenario> selected;
+    for (const auto &scenario: all) {
+        std::string list = "," + options.scenarios + ",";
+        if (options.scenarios == "all" || list.find("," + scenario.name + ",") != std::string::npos) {
+            selected.push_back(scenario);
+        }
+    }
+    if (selected.empty()) {
+        usage();
+        return 1;
+    }
+
+    SSL_CTX *ctx = nullptr;
+    if (options.tls) {
+        SSL_library_init();
+        SSL_load_error_strings();
+        ctx = SSL_CTX_new(TLS_client_method());
+        SSL_CTX_set_verify(ctx, SSL_VERIFY_NONE, nullptr);
+    }
+
+    std::string json = "{\"target\":\"" + std::string(options.tls ? "https" : "http") + "://" + options.host + ":" +
+                       std::to_string(options.port) + "\",\"connections\":" + std::to_string(options.connections) +
+                       ",\"pipeline\":" + std::to_string(options.pipeline) + ",\"duration_s\":" +
+                       formatDouble(options.duration) + ",\"scenarios\":[";
+    for (size_t i = 0; i < selected.size(); ++i) {
+        json += (i ? "," : "") + runScenario(options, ctx, selected[i]);
+    }
+    json += "]}\n";
+
+    if (ctx) {
+        SSL_CTX_free(ctx);
+    }
+
+    if (options.out.empty()) {
+        std::cout << json;
+    } else {
+        std::ofstream(options.out) << json;
+        std::cerr << "[bench] Results written to " << options.out << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,525 @@
+// 组件级微基准（Google Benchmark）：请求解析、响应生成（明文与 TLS）、gzip、Cookie 解析、MIME 查询、文件缓存、站点快照。
+// 除耗时外还统计每次操作的堆分配次数（allocs/op）。
+//
+//   ./microbench --benchmark_filter=Request
+#include <algorithm>
+#include <atomic>
+#include <benchmark/benchmark.h>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <new>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#include "arena.hpp"
+#include "bufferpool.hpp"
+#include "cookiemanager.hpp"
+#include "gzip.hpp"
+#include "http_handler.hpp"
+#include "httpscan.hpp"
+#include "server.hpp"
+#include "sitesnapshot.hpp"
+
+// 统计全局堆分配次数。替换的 new/delete 成对使用 malloc/free，GCC 内联后会误报不匹配
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+static std::atomic<uint64_t> g_allocations{0};
+
+void *operator new(std::size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+// std::pmr::new_delete_resource 走带对齐参数的版本
+void *operator new(std::size_t size, std::align_val_t align) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    size_t alignment = std::max(static_cast<size_t>(align), sizeof(void *));
+    if (void *p = std::aligned_alloc(alignment, (std::max<size_t>(size, 1) + alignment - 1) / alignment * alignment)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+namespace {
+
+// 在 state 结束时写入 allocs/op
+class AllocationCounter {
+public:
+    explicit AllocationCounter(benchmark::State &state) : m_state(state), m_start(g_allocations.load()) {}
+
+    ~AllocationCounter() {
+        m_state.counters["allocs/op"] = benchmark::Counter(static_cast<double>(g_allocations.load() - m_start),
+                                                           benchmark::Counter::kAvgIterations);
+    }
+
+private:
+    benchmark::State &m_state;
+    uint64_t m_start;
+};
+
+// 内存中的连接替身：socketpair 的一端交给 Socket，另一端由后台线程读空
+class LoopbackSocket {
+public:
+    LoopbackSocket() {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0) {
+            std::abort();
+        }
+        m_socket = std::make_shared<Socket>(fds[0]);
+        m_peer = fds[1];
+        m_drainer = std::thread([this] {
+            char buffer[65536];
+            while (::recv(m_peer, buffer, sizeof(buffer), 0) > 0) {
+            }
+        });
+    }
+
+    ~LoopbackSocket() {
+        m_socket.reset();
+        m_drainer.join();
+        ::close(m_peer);
+    }
+
+    Socket::ptr socket() const { return m_socket; }
+
+    // 对端，可向 socket() 写入数据
+    int peer() const { return m_peer; }
+
+private:
+    Socket::ptr m_socket;
+    int m_peer;
+    std::thread m_drainer;
+};
+
+// TLS 版本的连接替身：用临时生成的自签名证书，对端线程完成握手后把解密后的数据读空
+class TlsLoopbackSocket {
+public:
+    TlsLoopbackSocket() {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0) {
+            std::abort();
+        }
+        m_socket = std::make_shared<Socket>(fds[0]);
+        m_socket->setSSL(serverContext());
+        m_peer = fds[1];
+        m_drainer = std::thread([this] {
+            SSL_CTX *ctx = SSL_CTX_new(TLS_client_method());
+            SSL *ssl = SSL_new(ctx);
+            SSL_set_fd(ssl, m_peer);
+            char buffer[65536];
+            if (SSL_connect(ssl) == 1) {
+                while (SSL_read(ssl, buffer, sizeof(buffer)) > 0) {
+                }
+                // 回应 close_notify，Socket 析构时的双向关闭才会返回
+                SSL_shutdown(ssl);
+            }
+            SSL_free(ssl);
+            SSL_CTX_free(ctx);
+        });
+        if (!m_socket->handshake()) {
+            std::abort();
+        }
+    }
+
+    ~TlsLoopbackSocket() {
+        m_socket.reset();
+        m_drainer.join();
+        ::close(m_peer);
+    }
+
+    Socket::ptr socket() const { return m_socket; }
+
+private:
+    Socket::ptr m_socket;
+    int m_peer;
+    std::thread m_drainer;
+
+    // 由 Socket 接管并释放
+    static SSL_CTX *serverContext() {
+        EVP_PKEY *key = EVP_EC_gen("P-256");
+        X509 *cert = X509_new();
+        ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+        X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+        X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+        X509_NAME_add_entry_by_txt(X509_get_subject_name(cert), "CN", MBSTRING_ASC,
+                                   reinterpret_cast<const unsigned char *>("localhost"), -1, -1, 0);
+        X509_set_issuer_name(cert, X509_get_subject_name(cert));
+        X509_set_pubkey(cert, key);
+        X509_sign(cert, key, EVP_sha256());
+        SSL_CTX *ctx = SSL_CTX_new(TLS_server_method());
+        SSL_CTX_use_certificate(ctx, cert);
+        SSL_CTX_use_PrivateKey(ctx, key);
+        X509_free(cert);
+        EVP_PKEY_free(key);
+        return ctx;
+    }
+};
+
+const std::string kSimpleRequest = "GET /index.html HTTP/1.1\r\nHost: 127.0.0.1:8080\r\n\r\n";
+
+const std::string kBrowserRequest =
+        "GET /assets/main.css?v=3 HTTP/1.1\r\n"
+        "Host: 127.0.0.1:8080\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/124.0 Safari/537.36\r\n"
+        "Accept: text/css,*/*;q=0.1\r\n"
+        "Accept-Encoding: gzip, deflate, br\r\n"
+        "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+        "Cache-Control: no-cache\r\n"
+        "Connection: keep-alive\r\n"
+        "Cookie: sid=6f1c2a9be0d34c7a8f5e1b2c3d4e5f60; theme=dark; lang=zh-CN\r\n"
+        "Referer: https://127.0.0.1:8080/\r\n"
+        "\r\n";
+
+const std::string kPostRequest = "POST /upload HTTP/1.1\r\nHost: 127.0.0.1:8080\r\nContent-Type: "
+                                 "application/octet-stream\r\nContent-Length: 4096\r\n\r\n" +
+                                 std::string(4096, 'u');
+
+std::string htmlBody(size_t size) {
+    std::string body = "<!DOCTYPE html><html><head><title>bench</title></head><body>";
+    while (body.size() < size) {
+        body += "<p class=\"item\">The quick brown fox jumps over the lazy dog.</p>\n";
+    }
+    body.resize(size);
+    return body;
+}
+
+void BM_RequestParseBuffered(benchmark::State &state, const std::string &raw) {
+    AllocationCounter allocations(state);
+    for (auto _: state) {
+        size_t consumed = 0;
+        HttpRequest request;
+        auto result = request.parseBuffered(raw, consumed);
+        benchmark::DoNotOptimize(result);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * raw.size()));
+}
+BENCHMARK_CAPTURE(BM_RequestParseBuffered, simple, kSimpleRequest);
+BENCHMARK_CAPTURE(BM_RequestParseBuffered, browser, kBrowserRequest);
+BENCHMARK_CAPTURE(BM_RequestParseBuffered, post_4k, kPostRequest);
+
+// 与服务器一致：请求从连接的分配区构造，每轮结束后重置
+void BM_RequestParseArena(benchmark::State &state, const std::string &raw) {
+    RequestArena arena;
+    AllocationCounter allocations(state);
+    for (auto _: state) {
+        arena.reset();
+        size_t consumed = 0;
+        HttpRequest request(arena.resource());
+        auto result = request.parseBuffered(raw, consumed);
+        benchmark::DoNotOptimize(result);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * raw.size()));
+}
+BENCHMARK_CAPTURE(BM_RequestParseArena, simple, kSimpleRequest);
+BENCHMARK_CAPTURE(BM_RequestParseArena, browser, kBrowserRequest);
+BENCHMARK_CAPTURE(BM_RequestParseArena, post_4k, kPostRequest);
+
+// 头部尚未收全时的判断（每次 recv 之后都会执行一次）
+void BM_RequestIncomplete(benchmark::State &state) {
+    AllocationCounter allocations(state);
+    std::string_view partial(kBrowserRequest.data(), kBrowserRequest.size() - 2);
+    for (auto _: state) {
+        size_t consumed = 0;
+        HttpRequest request;
+        auto result = request.parseBuffered(partial, consumed);
+        benchmark::DoNotOptimize(result);
+    }
+}
+BENCHMARK(BM_RequestIncomplete);
+
+// 流水线：一个缓冲区中连续解析 16 个请求
+void BM_RequestParsePipelined(benchmark::State &state) {
+    AllocationCounter allocations(state);
+    std::string batch;
+    for (int i = 0; i < 16; ++i) {
+        batch += kBrowserRequest;
+    }
+    for (auto _: state) {
+        std::string_view rest = batch;
+        size_t consumed = 0;
+        HttpRequest request;
+        while (request.parseBuffered(rest, consumed) == HttpRequest::ParseResult::Complete) {
+            rest.remove_prefix(consumed);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * 16);
+}
+BENCHMARK(BM_RequestParsePipelined);
+
+// 头部扫描内核：逐行定位冒号与行尾，比较各实现
+void BM_HeaderScan(benchmark::State &state, httpscan::Kernel kernel) {
+    const char *begin = kBrowserRequest.data();
+    const char *end = begin + kBrowserRequest.size();
+    for (auto _: state) {
+        size_t lines = 0;
+        for (const char *p = begin; (p = kernel(p, end, lines > 0)) < end; ++p) {
+            if (*p == '\n') {
+                ++lines;
+            }
+        }
+        benchmark::DoNotOptimize(lines);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * kBrowserRequest.size()));
+}
+BENCHMARK_CAPTURE(BM_HeaderScan, scalar, httpscan::findSpecialScalar);
+#ifdef HTTPSCAN_X86
+BENCHMARK_CAPTURE(BM_HeaderScan, sse42, httpscan::findSpecialSse42);
+BENCHMARK_CAPTURE(BM_HeaderScan, avx2, httpscan::findSpecialAvx2);
+#endif
+
+// 请求路径解码与规范化：已规范的路径只做一次整段扫描
+void BM_PathNormalize(benchmark::State &state, const std::string &path) {
+    RequestArena arena;
+    AllocationCounter allocations(state);
+    for (auto _: state) {
+        arena.reset();
+        HttpRequest request(arena.resource());
+        bool valid = request.setPath(path);
+        benchmark::DoNotOptimize(valid);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * path.size()));
+}
+BENCHMARK_CAPTURE(BM_PathNormalize, canonical, std::string("/assets/vendor/bootstrap-5.3.2/dist/css/bootstrap.min.css?v=1"));
+BENCHMARK_CAPTURE(BM_PathNormalize, encoded, std::string("/assets/vendor/bootstrap%2D5.3.2/dist/css/bootstrap.min.css?v=1"));
+BENCHMARK_CAPTURE(BM_PathNormalize, dot_segments, std::string("/assets//vendor/./bootstrap-5.3.2/../bootstrap-5.3.2/dist/css/bootstrap.min.css"));
+
+// 经过 Socket 接收：请求由对端写入，读入池中的接收缓冲区后解析
+void BM_RequestParseSocket(benchmark::State &state, const std::string &raw) {
+    LoopbackSocket loopback;
+    RequestArena arena;
+    RecvBuffer buffer;
+    AllocationCounter allocations(state);
+    for (auto _: state) {
+        arena.reset();
+        if (::send(loopback.peer(), raw.data(), raw.size(), 0) != static_cast<ssize_t>(raw.size())) {
+            state.SkipWithError("send failed");
+            break;
+        }
+        HttpRequest request(arena.resource());
+        auto result = request.parse(loopback.socket(), buffer);
+        benchmark::DoNotOptimize(result);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * raw.size()));
+}
+BENCHMARK_CAPTURE(BM_RequestParseSocket, browser, kBrowserRequest);
+BENCHMARK_CAPTURE(BM_RequestParseSocket, post_4k, kPostRequest);
+
+HttpResponse makeResponse(Socket::ptr sock, const std::string &body,
+                          std::pmr::memory_resource *resource = std::pmr::get_default_resource()) {
+    HttpResponse response(sock, resource);
+    response.setStatus(200, "OK");
+    response.setHeader("Content-Type", "text/html");
+    response.setHeader("Transfer-Encoding", "");
+    response.setHeader("Set-Cookie", "sid=6f1c2a9be0d34c7a8f5e1b2c3d4e5f60; Path=/; Max-Age=300");
+    response.setBody(body);
+    return response;
+}
+
+void BM_ResponseSerialize(benchmark::State &state) {
+    AllocationCounter allocations(state);
+    std::string body = htmlBody(state.range(0));
+    for (auto _: state) {
+        HttpResponse response = makeResponse(nullptr, body);
+        std::pmr::string wire;
+        response.serialize(wire);
+        benchmark::DoNotOptimize(wire.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * body.size()));
+}
+BENCHMARK(BM_ResponseSerialize)->Arg(128)->Arg(4 << 10)->Arg(256 << 10);
+
+// 静态文件缓存命中：状态行与固定头部来自缓存项中预先序列化的头部块
+void BM_ResponseSerializePrepared(benchmark::State &state) {
+    static constexpr std::string_view covered[] = {"Content-Type", "ETag", "Cache-Control"};
+    auto file = std::make_shared<CachedFile>();
+    file->content = htmlBody(state.range(0));
+    file->head = "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nContent-Length: " + std::to_string(file->content.size()) +
+                 "\r\nETag: \"6ad53ead-14\"\r\nCache-Control: no-cache\r\n";
+    RequestArena arena;
+    AllocationCounter allocations(state);
+    for (auto _: state) {
+        arena.reset();
+        HttpResponse response(nullptr, arena.resource());
+        response.setStatus(200, "OK");
+        response.setHeader("Content-Type", "text/html");
+        response.setHeader("ETag", "\"6ad53ead-14\"");
+        response.setHeader("Cache-Control", "no-cache");
+        response.setHeader("Connection", "keep-alive");
+        response.setBody(file->content);
+        response.setPreparedHead(file, file->head, covered);
+        std::pmr::string wire(arena.resource());
+        response.serialize(wire);
+        benchmark::DoNotOptimize(wire.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * file->content.size()));
+}
+BENCHMARK(BM_ResponseSerializePrepared)->Arg(128)->Arg(4 << 10);
+
+void BM_HttpDate(benchmark::State &state) {
+    char date[HttpDate::kLength];
+    for (auto _: state) {
+        HttpDate::instance().copy(date);
+        benchmark::DoNotOptimize(date);
+    }
+}
+BENCHMARK(BM_HttpDate)->ThreadRange(1, 8);
+
+// 经过 Socket 写出（sendResponse 路径）
+void BM_ResponseSend(benchmark::State &state) {
+    LoopbackSocket loopback;
+    std::string body = htmlBody(state.range(0));
+    AllocationCounter allocations(state);
+    for (auto _: state) {
+        HttpResponse response = makeResponse(loopback.socket(), body);
+        response.send();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * body.size()));
+}
+BENCHMARK(BM_ResponseSend)->Arg(128)->Arg(4 << 10)->Arg(256 << 10);
+
+// 同一响应经 TLS 连接写出，与 BM_ResponseSend 对比即为加密与记录分帧的开销（不含握手）
+void BM_ResponseSendTls(benchmark::State &state) {
+    TlsLoopbackSocket loopback;
+    std::string body = htmlBody(state.range(0));
+    AllocationCounter allocations(state);
+    for (auto _: state) {
+        HttpResponse response = makeResponse(loopback.socket(), body);
+        response.send();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * body.size()));
+}
+BENCHMARK(BM_ResponseSendTls)->Arg(128)->Arg(4 << 10)->Arg(256 << 10);
+
+// 一个 keep-alive 请求的完整服务端路径：解析、构造响应、写出，稳态下应为 0 allocs/op
+void BM_RequestCycleArena(benchmark::State &state) {
+    LoopbackSocket loopback;
+    RequestArena arena;
+    std::string body = htmlBody(state.range(0));
+    AllocationCounter allocations(state);
+    for (auto _: state) {
+        arena.reset();
+        size_t consumed = 0;
+        HttpRequest request(arena.resource());
+        request.parseBuffered(kBrowserRequest, consumed);
+        HttpResponse response = makeResponse(loopback.socket(), body, arena.resource());
+        response.setHeader("Connection", "keep-alive");
+        response.send();
+    }
+}
+BENCHMARK(BM_RequestCycleArena)->Arg(128)->Arg(4 << 10);
+
+void BM_GzipCompress(benchmark::State &state) {
+    AllocationCounter allocations(state);
+    std::string body = htmlBody(state.range(0));
+    for (auto _: state) {
+        std::string compressed;
+        bool ok = GzipHandler::compress(body, compressed);
+        benchmark::DoNotOptimize(ok);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * body.size()));
+}
+BENCHMARK(BM_GzipCompress)->Arg(1 << 10)->Arg(16 << 10)->Arg(256 << 10);
+
+void BM_ParseCookies(benchmark::State &state) {
+    AllocationCounter allocations(state);
+    const std::string header = "sid=6f1c2a9be0d34c7a8f5e1b2c3d4e5f60; theme=dark; lang=zh-CN; _ga=GA1.1.123456789.1700000000";
+    for (auto _: state) {
+        auto cookies = CookieManager::parseCookies(header);
+        benchmark::DoNotOptimize(cookies);
+    }
+}
+BENCHMARK(BM_ParseCookies);
+
+void BM_GetMimeType(benchmark::State &state) {
+    AllocationCounter allocations(state);
+    const std::vector<std::string> paths = {"/index.html", "/assets/main.css", "/assets/main.js", "/chunked/2.jpeg",
+                                            "/favicon.ico", "/bench/large.bin"};
+    size_t i = 0;
+    for (auto _: state) {
+        auto type = StaticFileHandler::getMimeType(paths[i++ % paths.size()]);
+        benchmark::DoNotOptimize(type);
+    }
+}
+BENCHMARK(BM_GetMimeType);
+
+void BM_FileCacheGet(benchmark::State &state) {
+    FileCacheManager cache;
+    std::vector<std::string> paths;
+    for (int i = 0; i < 256; ++i) {
+        paths.push_back("./sites/demo1/assets/file" + std::to_string(i) + ".css");
+        auto file = std::make_shared<CachedFile>();
+        file->content = htmlBody(state.range(0));
+        cache.put(paths.back(), std::move(file));
+    }
+    AllocationCounter allocations(state);
+    size_t i = 0;
+    for (auto _: state) {
+        auto content = cache.get(paths[i++ & 255]);
+        benchmark::DoNotOptimize(content);
+    }
+}
+BENCHMARK(BM_FileCacheGet)->Arg(1 << 10)->Arg(64 << 10);
+
+// 生成含 count 个文件的站点目录（每个目录 1000 个文件，大小 1~8 KB），已存在时直接复用
+std::string siteTree(size_t count) {
+    auto root = std::filesystem::temp_directory_path() / ("microbench-site-" + std::to_string(count));
+    if (!std::filesystem::exists(root / "done")) {
+        for (size_t i = 0; i < count; ++i) {
+            auto dir = root / ("d" + std::to_string(i / 1000));
+            if (i % 1000 == 0) {
+                std::filesystem::create_directories(dir);
+            }
+            std::ofstream(dir / ("f" + std::to_string(i) + (i % 3 ? ".html" : ".png"))) << htmlBody(1024 << (i % 4));
+        }
+        std::ofstream(root / "done");
+    }
+    return root.string();
+}
+
+// 启动预热：遍历、读取、预压缩并建立完美哈希，报告整棵树的建立时间
+void BM_SiteSnapshotBuild(benchmark::State &state) {
+    std::string root = siteTree(state.range(0));
+    for (auto _: state) {
+        auto snapshot = SiteSnapshot::build(root, "no-cache");
+        benchmark::DoNotOptimize(snapshot);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * state.range(0)));
+}
+BENCHMARK(BM_SiteSnapshotBuild)->Arg(10000)->Arg(100000)->Iterations(1)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+void BM_SiteSnapshotFind(benchmark::State &state) {
+    auto snapshot = SiteSnapshot::build(siteTree(10000), "no-cache");
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < 256; ++i) {
+        size_t n = i * 37 % 10000;
+        paths.push_back("/d" + std::to_string(n / 1000) + "/f" + std::to_string(n) + (n % 3 ? ".html" : ".png"));
+    }
+    AllocationCounter allocations(state);
+    size_t i = 0;
+    for (auto _: state) {
+        auto file = snapshot->find(paths[i++ & 255]);
+        benchmark::DoNotOptimize(file);
+    }
+}
+BENCHMARK(BM_SiteSnapshotFind);
+
+} // namespace
+
+BENCHMARK_MAIN();
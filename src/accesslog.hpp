@@ -0,0 +1,309 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <mutex>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "server.hpp"
+
+// 访问日志：每个请求一条 JSON 记录。工作线程把记录写入各自的单生产者环形缓冲区（无锁），
+// 后台线程定期批量取出、格式化后一次写入文件，并按大小轮转
+class AccessLog {
+public:
+    struct Record {
+        std::chrono::system_clock::time_point time;
+        char client[64];
+        char method[16];
+        char target[256];
+        char version[16];
+        int status;
+        uint64_t bytes;
+        uint32_t latencyUs;
+        int64_t upstreamUs; // 没有上游（代理、CGI）时为 -1
+    };
+
+    static AccessLog &instance() {
+        static AccessLog log;
+        return log;
+    }
+
+    ~AccessLog() { close(); }
+
+    // maxSize 为单个文件的字节上限，超过后轮转为 path.1 ... path.maxFiles
+    bool open(const std::string &path, size_t maxSize, size_t maxFiles) {
+        close();
+        m_path = path;
+        m_maxSize = maxSize;
+        m_maxFiles = maxFiles;
+        if (!openFile()) {
+            return false;
+        }
+        m_running = true;
+        m_enabled = true;
+        m_writer = std::thread(&AccessLog::writerLoop, this);
+        return true;
+    }
+
+    // 停止后台线程，写出剩余记录
+    void close() {
+        if (!m_enabled.exchange(false)) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_running = false;
+        }
+        m_cond.notify_all();
+        if (m_writer.joinable()) {
+            m_writer.join();
+        }
+        if (m_fd != -1) {
+            ::close(m_fd);
+            m_fd = -1;
+        }
+    }
+
+    bool enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+    void log(std::string_view client, std::string_view method, std::string_view target, std::string_view version,
+             int status, uint64_t bytes, std::chrono::microseconds latency,
+             std::chrono::microseconds upstream) {
+        if (!enabled()) {
+            return;
+        }
+        Ring &ring = localRing();
+        Record *record = ring.reserve();
+        if (!record) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        record->time = std::chrono::system_clock::now();
+        copy(record->client, client);
+        copy(record->method, method);
+        copy(record->target, target);
+        copy(record->version, version);
+        record->status = status;
+        record->bytes = bytes;
+        record->latencyUs = static_cast<uint32_t>(latency.count());
+        record->upstreamUs = upstream.count();
+        ring.commit();
+    }
+
+    // latency 从 start 算起到调用时为止
+    void log(std::string_view client, const HttpRequest &request, const HttpResponse &response,
+             std::chrono::steady_clock::time_point start) {
+        if (!enabled()) {
+            return;
+        }
+        auto latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        log(client, request.getMethod(), request.getPath(), request.getVersion(), response.getStatus(),
+            response.getBody().size(), latency, response.getUpstreamTime());
+    }
+
+private:
+    static constexpr size_t kRingSize = 512; // 2 的幂
+    static constexpr auto kFlushInterval = std::chrono::milliseconds(100);
+
+    // 单生产者单消费者环形缓冲区：工作线程写，后台线程读
+    struct Ring {
+        std::array<Record, kRingSize> records;
+        std::atomic<size_t> head{0}; // 生产者写入位置
+        std::atomic<size_t> tail{0}; // 消费者读取位置
+        std::atomic<bool> orphaned{false};
+
+        Record *reserve() {
+            size_t h = head.load(std::memory_order_relaxed);
+            if (h - tail.load(std::memory_order_acquire) >= kRingSize) {
+                return nullptr;
+            }
+            return &records[h & (kRingSize - 1)];
+        }
+
+        void commit() { head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+    };
+
+    // 线程退出时标记缓冲区，由后台线程写完剩余记录后回收
+    struct RingHandle {
+        std::shared_ptr<Ring> ring;
+        ~RingHandle() {
+            if (ring) {
+                ring->orphaned.store(true, std::memory_order_release);
+            }
+        }
+    };
+
+    std::string m_path;
+    size_t m_maxSize = 0;
+    size_t m_maxFiles = 0;
+    int m_fd = -1;
+    size_t m_fileSize = 0;
+
+    std::atomic<bool> m_enabled{false};
+    std::atomic<uint64_t> m_dropped{0};
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_running = false;
+    std::thread m_writer;
+    std::vector<std::shared_ptr<Ring>> m_rings;
+
+    Ring &localRing() {
+        thread_local RingHandle handle;
+        if (!handle.ring) {
+            handle.ring = std::make_shared<Ring>();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_rings.push_back(handle.ring);
+        }
+        return *handle.ring;
+    }
+
+    template<size_t N>
+    static void copy(char (&dest)[N], std::string_view src) {
+        size_t length = std::min(src.size(), N - 1);
+        std::memcpy(dest, src.data(), length);
+        dest[length] = '\0';
+    }
+
+    bool openFile() {
+        m_fd = ::open(m_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (m_fd == -1) {
+            spdlog::error("[AccessLog] Failed to open {}: {}", m_path, std::strerror(errno));
+            return false;
+        }
+        m_fileSize = static_cast<size_t>(lseek(m_fd, 0, SEEK_END));
+        return true;
+    }
+
+    // path.(n-1) -> path.n，…，path -> path.1，然后重新打开 path
+    void rotate() {
+        ::close(m_fd);
+        m_fd = -1;
+        if (m_maxFiles == 0) {
+            std::remove(m_path.c_str());
+        } else {
+            for (size_t i = m_maxFiles; i > 1; --i) {
+                std::rename((m_path + "." + std::to_string(i - 1)).c_str(), (m_path + "." + std::to_string(i)).c_str());
+            }
+            std::rename(m_path.c_str(), (m_path + ".1").c_str());
+        }
+        openFile();
+    }
+
+    static void appendEscaped(std::string &out, const char *value) {
+        for (const char *p = value; *p; ++p) {
+            unsigned char c = static_cast<unsigned char>(*p);
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += static_cast<char>(c);
+            } else if (c < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out += escaped;
+            } else {
+                out += static_cast<char>(c);
+            }
+        }
+    }
+
+    static void format(std::string &out, const Record &record) {
+        auto seconds = std::chrono::system_clock::to_time_t(record.time);
+        auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(record.time.time_since_epoch()).count() % 1000;
+        struct tm tm {};
+        gmtime_r(&seconds, &tm);
+        char time[64];
+        std::snprintf(time, sizeof(time), "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ", tm.tm_year + 1900, tm.tm_mon + 1,
+                      tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, static_cast<int>(millis));
+
+        out += "{\"time\":\"";
+        out += time;
+        out += "\",\"client\":\"";
+        appendEscaped(out, record.client);
+        out += "\",\"request\":\"";
+        appendEscaped(out, record.method);
+        out += ' ';
+        appendEscaped(out, record.target);
+        out += ' ';
+        appendEscaped(out, record.version);
+        out += "\",\"status\":";
+        out += std::to_string(record.status);
+        out += ",\"bytes\":";
+        out += std::to_string(record.bytes);
+        out += ",\"latency_us\":";
+        out += std::to_string(record.latencyUs);
+        out += ",\"upstream_us\":";
+        out += record.upstreamUs < 0 ? "null" : std::to_string(record.upstreamUs);
+        out += "}\n";
+    }
+
+    // 取出所有缓冲区中的记录，回收已退出线程的空缓冲区
+    void drain(std::string &batch) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto it = m_rings.begin(); it != m_rings.end();) {
+            Ring &ring = **it;
+            bool orphaned = ring.orphaned.load(std::memory_order_acquire);
+            size_t tail = ring.tail.load(std::memory_order_relaxed);
+            size_t head = ring.head.load(std::memory_order_acquire);
+            for (; tail != head; ++tail) {
+                format(batch, ring.records[tail & (kRingSize - 1)]);
+            }
+            ring.tail.store(tail, std::memory_order_release);
+            if (orphaned) {
+                it = m_rings.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    void write(const std::string &batch) {
+        if (m_fd == -1 || batch.empty()) {
+            return;
+        }
+        size_t written = 0;
+        while (written < batch.size()) {
+            ssize_t n = ::write(m_fd, batch.data() + written, batch.size() - written);
+            if (n <= 0) {
+                if (n == -1 && errno == EINTR) {
+                    continue;
+                }
+                spdlog::error("[AccessLog] Write failed: {}", std::strerror(errno));
+                return;
+            }
+            written += n;
+        }
+        m_fileSize += batch.size();
+        if (m_maxSize && m_fileSize >= m_maxSize) {
+            rotate();
+        }
+    }
+
+    void writerLoop() {
+        std::string batch;
+        bool running = true;
+        while (running) {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cond.wait_for(lock, kFlushInterval, [this] { return !m_running; });
+                running = m_running;
+            }
+            batch.clear();
+            drain(batch);
+            write(batch);
+            uint64_t dropped = m_dropped.exchange(0, std::memory_order_relaxed);
+            if (dropped > 0) {
+                spdlog::warn("[AccessLog] Dropped {} record(s), writer could not keep up", dropped);
+            }
+        }
+    }
+};
@@ -6,7 +6,9 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <cstddef>
 #include <cstring>
+#include <sys/un.h>
 
 class Address
 {
@@ -17,6 +19,7 @@ public:
 
     virtual int getFamily() const = 0;
     virtual std::string toString() const = 0;
+    virtual std::string getIP() const = 0;
     virtual const struct sockaddr *getAddress() const = 0;
     virtual socklen_t getLength() const = 0; // 添加 getLength 方法
     virtual void setAddressInfo(const std::string &ip, uint16_t port) = 0;
@@ -25,6 +28,15 @@ public:
     static Address::ptr getPeerAddress(int sock);
 
     static Address::ptr createIPv4Address(uint16_t port, const std::string &ip = "0.0.0.0");
+    static Address::ptr createIPv6Address(uint16_t port, const std::string &ip = "::");
+    static Address::ptr createUnixAddress(const std::string &path);
+
+    // 按地址族构造，不支持的地址族返回 nullptr
+    static Address::ptr create(const struct sockaddr *addr, socklen_t len);
+
+    // 解析监听地址："0.0.0.0:8080"、"[::]:8080"、":8080"（所有 IPv4 地址）、"unix:/run/http.sock"；
+    // 格式错误返回 nullptr
+    static Address::ptr parse(const std::string &text);
 };
 
 class IPv4Address : public Address
@@ -82,7 +94,7 @@ public:
         return ntohs(addr_.sin_port);
     }
 
-    std::string getIP() const
+    std::string getIP() const override
     {
         char buffer[INET_ADDRSTRLEN];
         std::memset(buffer, 0, sizeof(buffer));
@@ -94,6 +106,159 @@ private:
     struct sockaddr_in addr_;
 };
 
+class IPv6Address : public Address
+{
+public:
+    IPv6Address(uint16_t port, const std::string &ip = "::")
+    {
+        std::memset(&addr_, 0, sizeof(addr_));
+        addr_.sin6_family = AF_INET6;
+        addr_.sin6_port = htons(port);
+        if (inet_pton(AF_INET6, ip.c_str(), &addr_.sin6_addr) <= 0)
+        {
+            addr_.sin6_addr = in6addr_any;
+        }
+    }
+
+    IPv6Address(const struct sockaddr_in6 &addr) : addr_(addr) {}
+
+    ~IPv6Address() override = default;
+
+    int getFamily() const override
+    {
+        return AF_INET6;
+    }
+
+    // IPv4 映射地址（双栈监听上的 IPv4 客户端）按 IPv4 的写法输出
+    std::string toString() const override
+    {
+        if (IN6_IS_ADDR_V4MAPPED(&addr_.sin6_addr))
+        {
+            return getIP() + ":" + std::to_string(getPort());
+        }
+        return "[" + getIP() + "]:" + std::to_string(getPort());
+    }
+
+    const struct sockaddr *getAddress() const override
+    {
+        return reinterpret_cast<const struct sockaddr *>(&addr_);
+    }
+
+    socklen_t getLength() const override
+    {
+        return sizeof(addr_);
+    }
+
+    void setAddressInfo(const std::string &ip, uint16_t port) override
+    {
+        addr_.sin6_port = htons(port);
+        if (inet_pton(AF_INET6, ip.c_str(), &addr_.sin6_addr) <= 0)
+        {
+            addr_.sin6_addr = in6addr_any;
+        }
+    }
+
+    uint16_t getPort() const
+    {
+        return ntohs(addr_.sin6_port);
+    }
+
+    std::string getIP() const override
+    {
+        char buffer[INET6_ADDRSTRLEN];
+        std::memset(buffer, 0, sizeof(buffer));
+        if (IN6_IS_ADDR_V4MAPPED(&addr_.sin6_addr))
+        {
+            inet_ntop(AF_INET, addr_.sin6_addr.s6_addr + 12, buffer, sizeof(buffer));
+        }
+        else
+        {
+            inet_ntop(AF_INET6, &addr_.sin6_addr, buffer, sizeof(buffer));
+        }
+        return buffer;
+    }
+
+private:
+    struct sockaddr_in6 addr_;
+};
+
+// UNIX 域套接字地址，供本机的前置代理连接。对端没有 IP，getIP 返回空串
+class UnixAddress : public Address
+{
+public:
+    explicit UnixAddress(const std::string &path)
+    {
+        std::memset(&addr_, 0, sizeof(addr_));
+        addr_.sun_family = AF_UNIX;
+        std::strncpy(addr_.sun_path, path.c_str(), sizeof(addr_.sun_path) - 1);
+        len_ = static_cast<socklen_t>(offsetof(struct sockaddr_un, sun_path) + std::strlen(addr_.sun_path) + 1);
+    }
+
+    UnixAddress(const struct sockaddr_un &addr, socklen_t len) : addr_(addr), len_(len) {}
+
+    ~UnixAddress() override = default;
+
+    int getFamily() const override
+    {
+        return AF_UNIX;
+    }
+
+    std::string toString() const override
+    {
+        return "unix:" + getPath();
+    }
+
+    const struct sockaddr *getAddress() const override
+    {
+        return reinterpret_cast<const struct sockaddr *>(&addr_);
+    }
+
+    socklen_t getLength() const override
+    {
+        return len_;
+    }
+
+    void setAddressInfo(const std::string &ip, uint16_t port) override
+    {
+        (void) port;
+        *this = UnixAddress(ip);
+    }
+
+    std::string getIP() const override
+    {
+        return "";
+    }
+
+    // 未绑定路径的客户端套接字没有名字
+    std::string getPath() const
+    {
+        if (len_ <= offsetof(struct sockaddr_un, sun_path))
+        {
+            return "";
+        }
+        return std::string(addr_.sun_path, strnlen(addr_.sun_path, len_ - offsetof(struct sockaddr_un, sun_path)));
+    }
+
+private:
+    struct sockaddr_un addr_;
+    socklen_t len_;
+};
+
+Address::ptr Address::create(const struct sockaddr *addr, socklen_t len)
+{
+    switch (addr->sa_family)
+    {
+        case AF_INET:
+            return std::make_shared<IPv4Address>(*reinterpret_cast<const struct sockaddr_in *>(addr));
+        case AF_INET6:
+            return std::make_shared<IPv6Address>(*reinterpret_cast<const struct sockaddr_in6 *>(addr));
+        case AF_UNIX:
+            return std::make_shared<UnixAddress>(*reinterpret_cast<const struct sockaddr_un *>(addr), len);
+        default:
+            return nullptr;
+    }
+}
+
 // 获取本地地址
 Address::ptr Address::getLocalAddress(int sock)
 {
@@ -103,12 +268,7 @@ Address::ptr Address::getLocalAddress(int sock)
     {
         return nullptr;
     }
-
-    if (addr.ss_family == AF_INET)
-    {
-        return std::make_shared<IPv4Address>(*reinterpret_cast<struct sockaddr_in *>(&addr));
-    }
-    return nullptr;
+    return create(reinterpret_cast<struct sockaddr *>(&addr), len);
 }
 
 // 获取对端地址
@@ -120,16 +280,76 @@ Address::ptr Address::getPeerAddress(int sock)
     {
         return nullptr;
     }
-
-    if (addr.ss_family == AF_INET)
-    {
-        return std::make_shared<IPv4Address>(*reinterpret_cast<struct sockaddr_in *>(&addr));
-    }
-    return nullptr;
+    return create(reinterpret_cast<struct sockaddr *>(&addr), len);
 }
 
 // 创建 IPv4 地址
 Address::ptr Address::createIPv4Address(uint16_t port, const std::string &ip)
 {
     return std::make_shared<IPv4Address>(port, ip);
-}
\ No newline at end of file
+}
+
+Address::ptr Address::createIPv6Address(uint16_t port, const std::string &ip)
+{
+    return std::make_shared<IPv6Address>(port, ip);
+}
+
+Address::ptr Address::createUnixAddress(const std::string &path)
+{
+    return std::make_shared<UnixAddress>(path);
+}
+
+Address::ptr Address::parse(const std::string &text)
+{
+    if (text.rfind("unix:", 0) == 0)
+    {
+        std::string path = text.substr(5);
+        if (path.empty() || path.size() >= sizeof(sockaddr_un::sun_path))
+        {
+            return nullptr;
+        }
+        return createUnixAddress(path);
+    }
+
+    size_t colon = text.rfind(':');
+    if (colon == std::string::npos || colon + 1 == text.size())
+    {
+        return nullptr;
+    }
+    int port = 0;
+    try
+    {
+        size_t used = 0;
+        port = std::stoi(text.substr(colon + 1), &used);
+        if (used != text.size() - colon - 1 || port < 0 || port > 65535)
+        {
+            return nullptr;
+        }
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+
+    std::string host = text.substr(0, colon);
+    if (host.size() >= 2 && host.front() == '[' && host.back() == ']')
+    {
+        host = host.substr(1, host.size() - 2);
+        struct in6_addr ip;
+        if (inet_pton(AF_INET6, host.c_str(), &ip) != 1)
+        {
+            return nullptr;
+        }
+        return createIPv6Address(static_cast<uint16_t>(port), host);
+    }
+    if (host.empty())
+    {
+        host = "0.0.0.0";
+    }
+    struct in_addr ip;
+    if (inet_pton(AF_INET, host.c_str(), &ip) != 1)
+    {
+        return nullptr;
+    }
+    return createIPv4Address(static_cast<uint16_t>(port), host);
+}
@@ -0,0 +1,296 @@
+#pragma once
+#include <algorithm>
+#include <arpa/inet.h>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <netinet/in.h>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <vector>
+
+// 客户端地址的统一表示。IPv4（含 IPv4 映射的 IPv6 地址）只用前 4 字节
+struct IpKey {
+    bool v4 = true;
+    std::array<uint8_t, 16> bytes{};
+
+    static IpKey of(const sockaddr *addr) {
+        IpKey key;
+        if (addr && addr->sa_family == AF_INET) {
+            std::memcpy(key.bytes.data(), &reinterpret_cast<const sockaddr_in *>(addr)->sin_addr, 4);
+        } else if (addr && addr->sa_family == AF_INET6) {
+            const in6_addr &ip = reinterpret_cast<const sockaddr_in6 *>(addr)->sin6_addr;
+            if (IN6_IS_ADDR_V4MAPPED(&ip)) {
+                std::memcpy(key.bytes.data(), ip.s6_addr + 12, 4);
+            } else {
+                key.v4 = false;
+                std::memcpy(key.bytes.data(), ip.s6_addr, 16);
+            }
+        }
+        return key;
+    }
+
+    bool bit(int index) const { return (bytes[index >> 3] >> (7 - (index & 7))) & 1; }
+};
+
+// CIDR 黑白名单，编译成 IPv4 / IPv6 两棵二叉前缀树，按最长前缀匹配：
+// 最具体的规则生效，同一前缀同时出现在两个列表时拒绝；没有任何 allow 规则时默认放行
+class IpFilter {
+public:
+    // 解析 "10.0.0.0/8"、"192.168.1.7"、"2001:db8::/32"，格式错误返回 false
+    bool add(std::string_view cidr, bool allow) {
+        size_t slash = cidr.find('/');
+        std::string ip(cidr.substr(0, slash));
+        IpKey key;
+        int maxBits = 32;
+        if (inet_pton(AF_INET, ip.c_str(), key.bytes.data()) != 1) {
+            if (inet_pton(AF_INET6, ip.c_str(), key.bytes.data()) != 1) {
+                return false;
+            }
+            key.v4 = false;
+            maxBits = 128;
+        }
+        int bits = maxBits;
+        if (slash != std::string_view::npos) {
+            std::string_view length = cidr.substr(slash + 1);
+            if (length.empty() || length.size() > 3 || !std::all_of(length.begin(), length.end(), ::isdigit)) {
+                return false;
+            }
+            bits = std::stoi(std::string(length));
+            if (bits > maxBits) {
+                return false;
+            }
+        }
+
+        int32_t node = key.v4 ? kRootV4 : kRootV6;
+        for (int i = 0; i < bits; ++i) {
+            int b = key.bit(i);
+            if (m_nodes[node].child[b] < 0) {
+                m_nodes[node].child[b] = static_cast<int32_t>(m_nodes.size());
+                m_nodes.emplace_back();
+            }
+            node = m_nodes[node].child[b];
+        }
+        Verdict verdict = allow ? Verdict::Allow : Verdict::Deny;
+        if (m_nodes[node].verdict != Verdict::Deny) {
+            m_nodes[node].verdict = verdict;
+        }
+        m_hasAllow = m_hasAllow || allow;
+        m_empty = false;
+        return true;
+    }
+
+    // 逗号或空白分隔的列表，跳过并报告无法解析的条目
+    void addList(const std::string &list, bool allow) {
+        size_t pos = 0;
+        while (pos < list.size()) {
+            size_t end = list.find_first_of(", \t", pos);
+            std::string_view item = std::string_view(list).substr(pos, end == std::string::npos ? end : end - pos);
+            if (!item.empty() && !add(item, allow)) {
+                spdlog::warn("[IpFilter] Ignoring invalid CIDR '{}'", item);
+            }
+            pos = end == std::string::npos ? list.size() : end + 1;
+        }
+    }
+
+    bool empty() const { return m_empty; }
+
+    bool allowed(const IpKey &key) const {
+        if (m_empty) {
+            return true;
+        }
+        Verdict verdict = m_hasAllow ? Verdict::Deny : Verdict::Allow;
+        int32_t node = key.v4 ? kRootV4 : kRootV6;
+        int bits = key.v4 ? 32 : 128;
+        for (int i = 0;; ++i) {
+            if (m_nodes[node].verdict != Verdict::None) {
+                verdict = m_nodes[node].verdict;
+            }
+            if (i == bits || (node = m_nodes[node].child[key.bit(i)]) < 0) {
+                break;
+            }
+        }
+        return verdict == Verdict::Allow;
+    }
+
+private:
+    enum class Verdict : uint8_t { None, Allow, Deny };
+
+    struct Node {
+        int32_t child[2] = {-1, -1};
+        Verdict verdict = Verdict::None;
+    };
+
+    static constexpr int32_t kRootV4 = 0;
+    static constexpr int32_t kRootV6 = 1;
+
+    std::vector<Node> m_nodes = std::vector<Node>(2);
+    bool m_hasAllow = false;
+    bool m_empty = true;
+};
+
+// 令牌桶参数：每秒补充 rate 个令牌，最多积攒 burst 个；rate 为 0 表示不限制
+struct RateLimit {
+    size_t rate = 0;
+    size_t burst = 0;
+};
+
+// 按客户端地址的令牌桶。固定大小的开放寻址表分成若干分片，每个槽位是键与状态两个原子量，
+// 状态把上次补充时间与剩余令牌打包进 64 位，用 CAS 更新，热路径上没有锁也不分配内存。
+// 表满时淘汰探测窗口内最久未使用的槽位，被淘汰的客户端下次以满桶重新开始
+class RateLimiter {
+public:
+    explicit RateLimiter(RateLimit limit) :
+        m_rate(limit.rate),
+        m_capacity(std::min<uint64_t>(std::max(limit.burst, limit.rate), kMaxTokens) * kUnit),
+        m_slots(std::make_unique<Slot[]>(kShards * kShardSlots)), m_epoch(std::chrono::steady_clock::now()) {}
+
+    // 取一个令牌，桶空时返回 false
+    bool tryAcquire(const IpKey &key) { return tryAcquire(key, std::chrono::steady_clock::now()); }
+
+    bool tryAcquire(const IpKey &key, std::chrono::steady_clock::time_point time) {
+        uint32_t now = static_cast<uint32_t>(
+                std::chrono::duration_cast<std::chrono::milliseconds>(time - m_epoch).count());
+        Slot &slot = locate(hash(key), now);
+        uint64_t state = slot.state.load(std::memory_order_acquire);
+        while (true) {
+            uint32_t last = static_cast<uint32_t>(state >> 32);
+            uint64_t tokens = static_cast<uint32_t>(state);
+            // 并发更新可能让本线程的时间略微落后于已记录的时间，差值为小负数，此时不补充；
+            // 更大的负差值来自 32 位毫秒时间戳回绕（条目闲置超过约 24.8 天），直接补满
+            int32_t elapsed = static_cast<int32_t>(now - last);
+            if (elapsed < -kMaxSkewMs) {
+                tokens = m_capacity;
+                last = now;
+            } else if (elapsed > 0) {
+                // 每毫秒补充 rate 个千分之一令牌，即每秒 rate 个
+                tokens = std::min<uint64_t>(m_capacity, tokens + static_cast<uint64_t>(elapsed) * m_rate);
+                last = now;
+            }
+            bool granted = tokens >= kUnit;
+            uint64_t next = (static_cast<uint64_t>(last) << 32) | (granted ? tokens - kUnit : tokens);
+            if (slot.state.compare_exchange_weak(state, next, std::memory_order_acq_rel)) {
+                return granted;
+            }
+        }
+    }
+
+private:
+    // 令牌以千分之一为单位存放，时间以毫秒为单位
+    static constexpr uint64_t kUnit = 1000;
+    static constexpr uint64_t kMaxTokens = UINT32_MAX / kUnit;
+    static constexpr size_t kShards = 64;
+    static constexpr size_t kShardSlots = 1024;
+    static constexpr size_t kProbe = 8;
+    // 并发更新造成的时间倒退不会超过这个量，更大的负差值只能来自时间戳回绕
+    static constexpr int32_t kMaxSkewMs = 1000;
+
+    struct alignas(16) Slot {
+        std::atomic<uint64_t> key{0}; // 0 表示空槽
+        std::atomic<uint64_t> state{0};
+    };
+
+    uint64_t m_rate;
+    uint64_t m_capacity;
+    std::unique_ptr<Slot[]> m_slots;
+    std::chrono::steady_clock::time_point m_epoch;
+
+    // IPv6 客户端通常独占一个 /64，按前缀计数，避免轮换地址绕过限制
+    static uint64_t hash(const IpKey &key) {
+        uint64_t high;
+        std::memcpy(&high, key.bytes.data(), 8);
+        if (key.v4) {
+            high = (high & 0xffffffffu) | (1ull << 32);
+        }
+        uint64_t x = high * 0x9e3779b97f4a7c15ull;
+        x ^= x >> 32;
+        x *= 0xd6e8feb86659fd93ull;
+        x ^= x >> 32;
+        return x | 1;
+    }
+
+    uint64_t fullState(uint32_t now) const { return (static_cast<uint64_t>(now) << 32) | m_capacity; }
+
+    Slot &locate(uint64_t key, uint32_t now) {
+        Slot *shard = &m_slots[((key >> 48) % kShards) * kShardSlots];
+        size_t start = (key >> 1) % kShardSlots;
+        Slot *victim = &shard[start];
+        int32_t victimAge = INT32_MIN;
+        for (size_t i = 0; i < kProbe; ++i) {
+            Slot &slot = shard[(start + i) % kShardSlots];
+            uint64_t current = slot.key.load(std::memory_order_acquire);
+            if (current == 0 && slot.key.compare_exchange_strong(current, key, std::memory_order_acq_rel)) {
+                slot.state.store(fullState(now), std::memory_order_release);
+                return slot;
+            }
+            if (current == key) {
+                return slot;
+            }
+            int32_t age = static_cast<int32_t>(now - static_cast<uint32_t>(slot.state.load(std::memory_order_relaxed) >> 32));
+            if (age < -kMaxSkewMs) {
+                age = INT32_MAX;
+            }
+            if (age > victimAge) {
+                victim = &slot;
+                victimAge = age;
+            }
+        }
+        victim->key.store(key, std::memory_order_release);
+        victim->state.store(fullState(now), std::memory_order_release);
+        return *victim;
+    }
+};
+
+// CoDel 式的排队时延控制（Adaptive CoDel 变体）：以 interval 为窗口记录出队时的最小排队时延，
+// 整个窗口内的最小值都超过 target 说明队列持续积压而不是瞬时突发，此后排队超过 target 的工作直接拒绝；
+// 未积压时只拒绝排队超过 interval 的工作。target 为 0 表示关闭
+class CoDel {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    CoDel(std::chrono::milliseconds target, std::chrono::milliseconds interval) :
+        m_target(target), m_interval(std::max(interval, target)) {}
+
+    bool enabled() const { return m_target.count() > 0; }
+
+    Clock::duration target() const { return m_target; }
+
+    // 出队时调用，sojourn 为排队时长；返回 true 表示应当拒绝
+    bool shouldShed(Clock::duration sojourn, Clock::time_point now = Clock::now()) {
+        if (!enabled()) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (now >= m_windowEnd) {
+            // 上个窗口没有出队样本（空闲或已隔了多个窗口）时不认为积压
+            m_overloaded = m_windowSamples > 0 && now < m_windowEnd + m_interval && m_windowMin > m_target;
+            m_windowMin = Clock::duration::max();
+            m_windowSamples = 0;
+            m_windowEnd = now + m_interval;
+        }
+        m_windowMin = std::min(m_windowMin, sojourn);
+        ++m_windowSamples;
+        return sojourn > (m_overloaded ? Clock::duration(m_target) : Clock::duration(m_interval));
+    }
+
+    bool overloaded() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_overloaded;
+    }
+
+private:
+    Clock::duration m_target;
+    Clock::duration m_interval;
+    std::mutex m_mutex;
+    Clock::time_point m_windowEnd{};
+    Clock::duration m_windowMin = Clock::duration::max();
+    size_t m_windowSamples = 0;
+    bool m_overloaded = false;
+};
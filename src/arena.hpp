@@ -0,0 +1,45 @@
+#pragma once
+#include <cstddef>
+#include <memory_resource>
+#include <optional>
+
+#include "bufferpool.hpp"
+
+// 连接级的单调分配区：请求、响应、头部和待发送报文都从这里分配，处理完一批请求后整体重置，
+// 稳态下不再调用全局 malloc。首次分配时才从缓冲区池借用 64K 的初始块，重置时归还，
+// 空闲连接不占用分配区内存。超出初始块的部分向 new/delete 申请，重置时一并归还
+class RequestArena : public std::pmr::memory_resource {
+public:
+    static constexpr size_t kDefaultSize = 64 * 1024;
+
+    RequestArena() = default;
+
+    RequestArena(const RequestArena &) = delete;
+    RequestArena &operator=(const RequestArena &) = delete;
+
+    ~RequestArena() override { reset(); }
+
+    std::pmr::memory_resource *resource() { return this; }
+
+    // 回收本轮的全部分配，调用前所有使用该分配区的对象必须已经销毁
+    void reset() {
+        m_resource.reset();
+        m_block.reset();
+    }
+
+private:
+    IoBuffer m_block;
+    std::optional<std::pmr::monotonic_buffer_resource> m_resource;
+
+    void *do_allocate(size_t bytes, size_t alignment) override {
+        if (!m_resource) {
+            m_block = IoBuffer(kDefaultSize);
+            m_resource.emplace(m_block.data(), m_block.capacity(), std::pmr::new_delete_resource());
+        }
+        return m_resource->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void *, size_t, size_t) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+};
@@ -0,0 +1,301 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// I/O 缓冲区池：按 4K/16K/64K 三种规格从 1 MB 的 slab 中切分，slab 只增不还。
+// 线程先在本地缓存中借还，本地缓存空或满时再与全局空闲链表成批交换，避免每次都加锁。
+// 缓冲区带引用计数，可以切成多个 IoSlice 在读取、解析、处理各阶段之间传递而不复制，
+// 最后一个引用释放时回到池中。超过 64K 的缓冲区直接向堆申请
+class BufferPool {
+public:
+    static constexpr std::array<size_t, 3> kSizes = {4 * 1024, 16 * 1024, 64 * 1024};
+    static constexpr uint32_t kHeapClass = kSizes.size();
+
+    // 缓冲区头部，数据紧随其后
+    struct Block {
+        std::atomic<uint32_t> refs;
+        uint32_t sizeClass;
+        size_t capacity;
+
+        char *data() { return reinterpret_cast<char *>(this + 1); }
+    };
+
+    static BufferPool &instance() {
+        static BufferPool pool;
+        return pool;
+    }
+
+    ~BufferPool() {
+        for (auto &sizeClass: m_classes) {
+            for (char *slab: sizeClass.slabs) {
+                std::free(slab);
+            }
+        }
+    }
+
+    // 返回容量不小于 size 的缓冲区，引用计数为 1
+    Block *acquire(size_t size) {
+        uint32_t sizeClass = classFor(size);
+        Block *block;
+        if (sizeClass == kHeapClass) {
+            void *memory = std::malloc(sizeof(Block) + size);
+            if (!memory) {
+                throw std::bad_alloc();
+            }
+            block = new (memory) Block;
+            block->sizeClass = kHeapClass;
+            block->capacity = size;
+        } else {
+            auto &cache = localCache()[sizeClass];
+            if (cache.empty()) {
+                refill(sizeClass, cache);
+            }
+            block = cache.back();
+            cache.pop_back();
+        }
+        block->refs.store(1, std::memory_order_relaxed);
+        return block;
+    }
+
+    void release(Block *block) {
+        if (block->sizeClass == kHeapClass) {
+            block->~Block();
+            std::free(block);
+            return;
+        }
+        auto &cache = localCache()[block->sizeClass];
+        cache.push_back(block);
+        size_t batch = batchSize(block->sizeClass);
+        if (cache.size() >= 2 * batch) {
+            // 本地缓存满，归还一半给全局链表
+            Class &global = m_classes[block->sizeClass];
+            std::lock_guard<std::mutex> lock(global.mutex);
+            global.free.insert(global.free.end(), cache.end() - batch, cache.end());
+            cache.resize(cache.size() - batch);
+        }
+    }
+
+    // 已向系统申请的 slab 总字节数
+    size_t slabBytes() const { return m_slabBytes.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr size_t kSlabSize = 1 << 20;
+    // 每个线程每种规格本地缓存的上限约为 2 × kBatchBytes
+    static constexpr size_t kBatchBytes = 64 * 1024;
+
+    struct Class {
+        std::mutex mutex;
+        std::vector<Block *> free;
+        std::vector<char *> slabs;
+    };
+
+    using LocalCache = std::array<std::vector<Block *>, kSizes.size()>;
+
+    // 线程退出时把本地缓存还给全局链表
+    struct LocalCacheHandle {
+        LocalCache cache;
+
+        LocalCacheHandle() {
+            for (uint32_t i = 0; i < cache.size(); ++i) {
+                cache[i].reserve(2 * batchSize(i));
+            }
+        }
+
+        ~LocalCacheHandle() {
+            for (size_t i = 0; i < cache.size(); ++i) {
+                Class &global = instance().m_classes[i];
+                std::lock_guard<std::mutex> lock(global.mutex);
+                global.free.insert(global.free.end(), cache[i].begin(), cache[i].end());
+            }
+        }
+    };
+
+    std::array<Class, kSizes.size()> m_classes;
+    std::atomic<size_t> m_slabBytes{0};
+
+    static uint32_t classFor(size_t size) {
+        for (uint32_t i = 0; i < kSizes.size(); ++i) {
+            if (size <= kSizes[i]) {
+                return i;
+            }
+        }
+        return kHeapClass;
+    }
+
+    // 本地缓存与全局链表之间一次交换的块数
+    static size_t batchSize(uint32_t sizeClass) { return std::max<size_t>(1, kBatchBytes / kSizes[sizeClass]); }
+
+    static LocalCache &localCache() {
+        thread_local LocalCacheHandle handle;
+        return handle.cache;
+    }
+
+    // 从全局链表取一批，全局也空时切分一个新的 slab
+    void refill(uint32_t sizeClass, std::vector<Block *> &cache) {
+        Class &global = m_classes[sizeClass];
+        std::lock_guard<std::mutex> lock(global.mutex);
+        if (global.free.empty()) {
+            size_t stride = sizeof(Block) + kSizes[sizeClass];
+            char *slab = static_cast<char *>(std::aligned_alloc(alignof(std::max_align_t), kSlabSize));
+            if (!slab) {
+                throw std::bad_alloc();
+            }
+            global.slabs.push_back(slab);
+            m_slabBytes.fetch_add(kSlabSize, std::memory_order_relaxed);
+            for (size_t offset = 0; offset + stride <= kSlabSize; offset += stride) {
+                Block *block = new (slab + offset) Block;
+                block->sizeClass = sizeClass;
+                block->capacity = kSizes[sizeClass];
+                global.free.push_back(block);
+            }
+        }
+        size_t count = std::min(global.free.size(), batchSize(sizeClass));
+        cache.insert(cache.end(), global.free.end() - count, global.free.end());
+        global.free.resize(global.free.size() - count);
+    }
+};
+
+// 池中缓冲区的引用计数句柄
+class IoBuffer {
+public:
+    IoBuffer() = default;
+
+    explicit IoBuffer(size_t size) : m_block(BufferPool::instance().acquire(size)) {}
+
+    IoBuffer(const IoBuffer &other) : m_block(other.m_block) {
+        if (m_block) {
+            m_block->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    IoBuffer(IoBuffer &&other) noexcept : m_block(std::exchange(other.m_block, nullptr)) {}
+
+    IoBuffer &operator=(IoBuffer other) noexcept {
+        std::swap(m_block, other.m_block);
+        return *this;
+    }
+
+    ~IoBuffer() { reset(); }
+
+    void reset() {
+        if (m_block && m_block->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            BufferPool::instance().release(m_block);
+        }
+        m_block = nullptr;
+    }
+
+    explicit operator bool() const { return m_block != nullptr; }
+
+    char *data() const { return m_block ? m_block->data() : nullptr; }
+
+    size_t capacity() const { return m_block ? m_block->capacity : 0; }
+
+    // 没有其他句柄或切片引用时才可以原地修改已写入的内容
+    bool unique() const { return m_block && m_block->refs.load(std::memory_order_acquire) == 1; }
+
+private:
+    BufferPool::Block *m_block = nullptr;
+};
+
+// 缓冲区中一段只读数据，持有缓冲区的一个引用
+class IoSlice {
+public:
+    IoSlice() = default;
+
+    IoSlice(IoBuffer buffer, size_t offset, size_t size) :
+        m_buffer(std::move(buffer)), m_data(m_buffer.data() + offset), m_size(size) {}
+
+    const char *data() const { return m_data; }
+
+    size_t size() const { return m_size; }
+
+    bool empty() const { return m_size == 0; }
+
+    char operator[](size_t index) const { return m_data[index]; }
+
+    IoSlice substr(size_t pos, size_t count = std::string_view::npos) const {
+        IoSlice result(*this);
+        result.m_data += pos;
+        result.m_size = std::min(count, m_size - pos);
+        return result;
+    }
+
+    std::string_view view() const { return {m_data, m_size}; }
+
+    operator std::string_view() const { return view(); }
+
+private:
+    IoBuffer m_buffer;
+    const char *m_data = nullptr;
+    size_t m_size = 0;
+};
+
+// 连接的接收缓冲区：有数据要读时才从池中借用，数据全部消费后立即归还，空闲连接不占用缓冲区。
+// 从 4K 开始，放不下时换用更大的规格
+class RecvBuffer {
+public:
+    std::string_view view() const { return {m_buffer.data() + m_begin, m_end - m_begin}; }
+
+    size_t size() const { return m_end - m_begin; }
+
+    bool empty() const { return m_begin == m_end; }
+
+    // 与缓冲区共享内存的切片，offset 相对于未消费数据的起点
+    IoSlice slice(size_t offset, size_t length) const { return IoSlice(m_buffer, m_begin + offset, length); }
+
+    void consume(size_t n) {
+        m_begin += n;
+        if (m_begin == m_end) {
+            release();
+        }
+    }
+
+    // 保证未消费数据加上可写空间至少为 total 字节
+    void reserve(size_t total) {
+        if (!m_buffer) {
+            m_buffer = IoBuffer(std::max(total, BufferPool::kSizes[0]));
+            m_begin = m_end = 0;
+            return;
+        }
+        if (m_buffer.capacity() - m_begin >= total) {
+            return;
+        }
+        size_t used = size();
+        if (m_buffer.unique() && m_buffer.capacity() >= total) {
+            std::memmove(m_buffer.data(), m_buffer.data() + m_begin, used);
+        } else {
+            // 切片仍在引用旧缓冲区时不能原地移动，换一块新的
+            IoBuffer larger(std::max(total, m_buffer.capacity() * 2));
+            std::memcpy(larger.data(), m_buffer.data() + m_begin, used);
+            m_buffer = std::move(larger);
+        }
+        m_begin = 0;
+        m_end = used;
+    }
+
+    char *writable() const { return m_buffer.data() + m_end; }
+
+    size_t writableSize() const { return m_buffer.capacity() - m_end; }
+
+    void commit(size_t n) { m_end += n; }
+
+    void release() {
+        m_buffer.reset();
+        m_begin = m_end = 0;
+    }
+
+private:
+    IoBuffer m_buffer;
+    size_t m_begin = 0;
+    size_t m_end = 0;
+};
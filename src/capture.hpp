@@ -0,0 +1,227 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <mutex>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "server.hpp"
+
+// 请求/响应抓包，用于调试。按 1/N 采样或按路径前缀选取请求，由后台线程异步写入并按大小轮转。
+// 关闭时只有一次原子读的开销。
+//
+// 文件格式（小端）：文件头 "HSCAP001"，随后是若干条记录：
+//   uint64 时间戳（微秒）| uint32 客户端地址长度 | uint32 请求长度 | uint32 响应长度 | 客户端地址 | 请求 | 响应
+// 请求由解析结果重建（路径为解码后的形式），响应为实际写出的报文
+class TrafficCapture {
+public:
+    static TrafficCapture &instance() {
+        static TrafficCapture capture;
+        return capture;
+    }
+
+    ~TrafficCapture() { close(); }
+
+    // sampleEvery 为 0 时不做随机采样，只抓取 prefixes 匹配的请求
+    bool open(const std::string &path, size_t sampleEvery, std::vector<std::string> prefixes, size_t maxSize,
+              size_t maxFiles) {
+        close();
+        m_path = path;
+        m_sampleEvery = sampleEvery;
+        m_prefixes = std::move(prefixes);
+        m_maxSize = maxSize;
+        m_maxFiles = maxFiles;
+        if (!openFile()) {
+            return false;
+        }
+        m_running = true;
+        m_enabled = true;
+        m_writer = std::thread(&TrafficCapture::writerLoop, this);
+        return true;
+    }
+
+    void close() {
+        if (!m_enabled.exchange(false)) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_running = false;
+        }
+        m_cond.notify_all();
+        if (m_writer.joinable()) {
+            m_writer.join();
+        }
+        if (m_fd != -1) {
+            ::close(m_fd);
+            m_fd = -1;
+        }
+    }
+
+    bool enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+    // 决定是否抓取该请求
+    bool shouldCapture(std::string_view path) {
+        if (!enabled()) {
+            return false;
+        }
+        for (const auto &prefix: m_prefixes) {
+            if (path.starts_with(prefix)) {
+                return true;
+            }
+        }
+        return m_sampleEvery && m_counter.fetch_add(1, std::memory_order_relaxed) % m_sampleEvery == 0;
+    }
+
+    // 入队后立即返回；队列满时丢弃
+    void record(std::string_view client, const HttpRequest &request, std::string_view response) {
+        std::string entry;
+        std::string requestBytes = serializeRequest(request);
+        uint64_t timestamp = std::chrono::duration_cast<std::chrono::microseconds>(
+                                     std::chrono::system_clock::now().time_since_epoch())
+                                     .count();
+        appendInt(entry, timestamp, 8);
+        appendInt(entry, client.size(), 4);
+        appendInt(entry, requestBytes.size(), 4);
+        appendInt(entry, response.size(), 4);
+        entry += client;
+        entry += requestBytes;
+        entry += response;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_queue.size() >= kMaxQueued) {
+                ++m_dropped;
+                return;
+            }
+            m_queue.push_back(std::move(entry));
+        }
+        m_cond.notify_one();
+    }
+
+private:
+    static constexpr size_t kMaxQueued = 1024;
+    static constexpr char kMagic[8] = {'H', 'S', 'C', 'A', 'P', '0', '0', '1'};
+
+    std::string m_path;
+    size_t m_sampleEvery = 0;
+    std::vector<std::string> m_prefixes;
+    size_t m_maxSize = 0;
+    size_t m_maxFiles = 0;
+    int m_fd = -1;
+    size_t m_fileSize = 0;
+
+    std::atomic<bool> m_enabled{false};
+    std::atomic<uint64_t> m_counter{0};
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<std::string> m_queue;
+    uint64_t m_dropped = 0;
+    bool m_running = false;
+    std::thread m_writer;
+
+    static void appendInt(std::string &out, uint64_t value, int bytes) {
+        for (int i = 0; i < bytes; ++i) {
+            out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+        }
+    }
+
+    static std::string serializeRequest(const HttpRequest &request) {
+        std::string out;
+        out += request.getMethod();
+        out += ' ';
+        out += request.getPath();
+        out += ' ';
+        out += request.getVersion();
+        out += "\r\n";
+        for (const auto &header: request.getHeaders()) {
+            out += header.first;
+            out += ": ";
+            out += header.second;
+            out += "\r\n";
+        }
+        out += "\r\n";
+        out += request.getBody();
+        return out;
+    }
+
+    bool openFile() {
+        m_fd = ::open(m_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+        if (m_fd == -1) {
+            spdlog::error("[TrafficCapture] Failed to open {}: {}", m_path, std::strerror(errno));
+            return false;
+        }
+        m_fileSize = static_cast<size_t>(lseek(m_fd, 0, SEEK_END));
+        if (m_fileSize == 0) {
+            writeAll(std::string(kMagic, sizeof(kMagic)));
+        }
+        return true;
+    }
+
+    void rotate() {
+        ::close(m_fd);
+        m_fd = -1;
+        if (m_maxFiles == 0) {
+            std::remove(m_path.c_str());
+        } else {
+            for (size_t i = m_maxFiles; i > 1; --i) {
+                std::rename((m_path + "." + std::to_string(i - 1)).c_str(), (m_path + "." + std::to_string(i)).c_str());
+            }
+            std::rename(m_path.c_str(), (m_path + ".1").c_str());
+        }
+        openFile();
+    }
+
+    void writeAll(const std::string &data) {
+        size_t written = 0;
+        while (m_fd != -1 && written < data.size()) {
+            ssize_t n = ::write(m_fd, data.data() + written, data.size() - written);
+            if (n <= 0) {
+                if (n == -1 && errno == EINTR) {
+                    continue;
+                }
+                spdlog::error("[TrafficCapture] Write failed: {}", std::strerror(errno));
+                return;
+            }
+            written += n;
+        }
+        m_fileSize += written;
+    }
+
+    void writerLoop() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true) {
+            m_cond.wait(lock, [this] { return !m_running || !m_queue.empty(); });
+            if (m_queue.empty()) {
+                break;
+            }
+            std::deque<std::string> pending;
+            pending.swap(m_queue);
+            uint64_t dropped = m_dropped;
+            m_dropped = 0;
+            lock.unlock();
+
+            std::string batch;
+            for (auto &entry: pending) {
+                batch += entry;
+            }
+            writeAll(batch);
+            if (m_maxSize && m_fileSize >= m_maxSize) {
+                rotate();
+            }
+            if (dropped > 0) {
+                spdlog::warn("[TrafficCapture] Dropped {} record(s), writer could not keep up", dropped);
+            }
+            lock.lock();
+        }
+    }
+};
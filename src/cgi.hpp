@@ -8,11 +8,13 @@
 #include <vector>
 #include <algorithm>
 #include <cerrno>
+#include <csignal>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <fcntl.h>
 #include <sstream>
+#include <metrics.hpp>
 #include <server.hpp>
 #include <socket.hpp>
 #include "configparser.hpp"
@@ -24,8 +26,8 @@ public:
     CGIHandler(std::string r):root(r) {};
 
     void handle(const HttpRequest& req, HttpResponse& res) {
-        string scriptPath = this->root + req.getPath(); // 去掉路径中的前导斜杠
-        std::cout << scriptPath << std::endl;
+        string scriptPath = this->root + string(req.getPath()); // 去掉路径中的前导斜杠
+        SPDLOG_DEBUG("[CGIHandler] Script path: {}", scriptPath);
         // 检查脚本是否存在
         if (!fileExists(scriptPath)) {
             res.setStatus(404, "Not Found");
@@ -34,20 +36,26 @@ public:
         }
 
         // 设置环境变量
-        setenv("REQUEST_METHOD", req.getMethod().c_str(), 1);
+        setenv("REQUEST_METHOD", string(req.getMethod()).c_str(), 1);
         setenv("CONTENT_LENGTH", to_string(req.getBody().size()).c_str(), 1);
-        setenv("CONTENT_TYPE", req.getHeader("Content-Type").c_str(), 1);
+        setenv("CONTENT_TYPE", string(req.getHeader("Content-Type")).c_str(), 1);
 
         // 创建管道
         int pipefd[2];
-        if (pipe(pipefd) == -1) {
+        // 并发的其他 fork（CGI 子进程、热重载的新进程）不能继承这个管道，否则读端要等它们都退出才见到 EOF
+        if (pipe2(pipefd, O_CLOEXEC) == -1) {
             res.setStatus(500, "Internal Server Error");
             res.setBody("Failed to create pipe");
             return;
         }
 
         // 创建子进程
+        auto start = std::chrono::steady_clock::now();
         pid_t pid = fork();
+        if (pid > 0) {
+            metrics::Registry::instance().cgiSpawnTime.record(
+                    std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start));
+        }
         if (pid == -1) {
             close(pipefd[0]);
             close(pipefd[1]);
@@ -57,7 +65,10 @@ public:
         }
 
         if (pid == 0) {
-            // 子进程
+            // 子进程：恢复被主线程屏蔽的信号，避免脚本无法被终止
+            sigset_t empty;
+            sigemptyset(&empty);
+            sigprocmask(SIG_SETMASK, &empty, nullptr);
             close(pipefd[0]);
             dup2(pipefd[1], STDOUT_FILENO);
             dup2(pipefd[1], STDERR_FILENO);
@@ -69,29 +80,36 @@ public:
         } else {
             // 父进程
             close(pipefd[1]);
-            char buffer[4096];
-            string output;
+            // 脚本输出直接读入池中的缓冲区，按需换用更大的规格
+            RecvBuffer output;
             ssize_t bytes_read;
-
-            while ((bytes_read = read(pipefd[0], buffer, sizeof(buffer) - 1)) > 0) {
-                buffer[bytes_read] = '\0';
-                output += buffer;
-            }
+            do {
+                output.reserve(output.size() + kReadSize);
+                bytes_read = read(pipefd[0], output.writable(), output.writableSize());
+                if (bytes_read > 0) {
+                    output.commit(bytes_read);
+                }
+            } while (bytes_read > 0 || (bytes_read == -1 && errno == EINTR));
             close(pipefd[0]);
 
             // 等待子进程结束
             int status;
             waitpid(pid, &status, 0);
+            auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+            metrics::Registry::instance().cgiTime.record(elapsed);
+            res.setUpstreamTime(elapsed);
 
             // 设置响应
             res.setStatus(200, "OK");
             res.setHeader("Content-Type", "text/html");
-            res.setBody(output);
+            res.setBody(output.view());
         }
     }
 
 
 private:
+    static constexpr size_t kReadSize = 4096;
+
     static bool fileExists(const string& path) {
         return access(path.c_str(), F_OK) == 0;
     }
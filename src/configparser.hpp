@@ -5,7 +5,12 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <string_view>
 #include <optional>
+#include <sstream>
+#include <vector>
+#include <admission.hpp>
+#include <connectionlimiter.hpp>
 #include <http_handler.hpp>
 
 class ConfigParser {
@@ -43,6 +48,51 @@ public:
         return m_tree.get<std::string>("session." + key);
     }
 
+    std::string getLogConfig(const std::string &key) {
+        return m_tree.get<std::string>("log." + key);
+    }
+
+    std::string getCaptureConfig(const std::string &key) {
+        return m_tree.get<std::string>("capture." + key);
+    }
+
+    std::string getMetricsConfig(const std::string &key) {
+        return m_tree.get<std::string>("metrics." + key);
+    }
+
+    std::string getAdmissionConfig(const std::string &key) {
+        return m_tree.get<std::string>("admission." + key);
+    }
+
+    // 读取开关型配置（on/true/1 为开启），缺失时返回默认值
+    bool getFlag(const std::string &key, bool defaultValue) const {
+        auto value = m_tree.get_optional<std::string>(key);
+        if (!value) {
+            return defaultValue;
+        }
+        return *value == "on" || *value == "true" || *value == "1";
+    }
+
+    // 读取非负整数配置，缺失或非法时返回默认值
+    size_t getCount(const std::string &key, size_t defaultValue) const {
+        auto value = m_tree.get_optional<std::string>(key);
+        if (!value) {
+            return defaultValue;
+        }
+        try {
+            long long count = std::stoll(*value);
+            if (count < 0) {
+                throw std::out_of_range("negative");
+            }
+            return static_cast<size_t>(count);
+        } catch (...) {
+            spdlog::warn("Invalid {}, defaulting to {}", key, defaultValue);
+            return defaultValue;
+        }
+    }
+
+    bool hasSection(const std::string &section) const { return static_cast<bool>(m_tree.get_child_optional(section)); }
+
     std::unordered_map<std::string, std::string> getSectionMap(const std::string &section) const {
         std::unordered_map<std::string, std::string> result;
         try {
@@ -60,6 +110,15 @@ private:
     boost::property_tree::ptree m_tree;
 };
 
+// 一个监听入口：地址（IPv4 / IPv6 / UNIX 域）及是否终结 TLS
+struct ListenerConfig {
+    std::string name;
+    Address::ptr address;
+    bool tls = true;
+    bool v6only = false; // 仅对 IPv6 地址有效，默认双栈
+    bool proxy = false;  // 连接来自四层负载均衡器，以 PROXY 协议头开始
+};
+
 class ServerConfig {
 public:
     explicit ServerConfig(ConfigParser &configParser) {
@@ -86,16 +145,97 @@ public:
             spdlog::warn("Missing server.allowed_ips, defaulting to '0.0.0.0'");
             m_allowedIps = "0.0.0.0";
         }
+
+        m_http2 = configParser.getFlag("server.http2", true);
+        m_pipelining = configParser.getFlag("server.pipelining", true);
+        m_pipelineParallel = configParser.getFlag("server.pipeline_parallel", false);
+
+        ConnectionLimits defaults;
+        m_limits.keepAliveTimeout = std::chrono::seconds(
+                configParser.getCount("server.keepalive_timeout", defaults.keepAliveTimeout.count()));
+        m_limits.headerTimeout =
+                std::chrono::seconds(configParser.getCount("server.header_timeout", defaults.headerTimeout.count()));
+        m_limits.bodyTimeout =
+                std::chrono::seconds(configParser.getCount("server.body_timeout", defaults.bodyTimeout.count()));
+        m_limits.maxRequestsPerConnection =
+                configParser.getCount("server.max_requests_per_connection", defaults.maxRequestsPerConnection);
+        m_limits.maxConnections = configParser.getCount("server.max_connections", defaults.maxConnections);
+        m_limits.maxConnectionsPerIp =
+                configParser.getCount("server.max_connections_per_ip", defaults.maxConnectionsPerIp);
+        m_limits.queueTarget = std::chrono::milliseconds(
+                configParser.getCount("server.queue_target_ms", defaults.queueTarget.count()));
+        m_limits.queueInterval = std::chrono::milliseconds(
+                configParser.getCount("server.queue_interval_ms", defaults.queueInterval.count()));
+        m_shutdownTimeout = std::chrono::seconds(configParser.getCount("server.shutdown_timeout", 30));
+
+        if (configParser.hasSection("listen")) {
+            loadListeners(configParser);
+        }
+        if (m_listeners.empty()) {
+            // 没有 [listen] 时沿用 port 与 allowed_ips，单个 TLS 监听
+            ListenerConfig listener;
+            listener.name = "default";
+            if (m_allowedIps.find(':') != std::string::npos) {
+                listener.address = Address::createIPv6Address(m_port, m_allowedIps);
+            } else {
+                listener.address = Address::createIPv4Address(m_port, m_allowedIps);
+            }
+            m_listeners.push_back(listener);
+        }
     }
 
     uint16_t getPort() const { return m_port; }
     int getThreads() const { return m_threads; }
     std::string getAllowedIps() const { return m_allowedIps; }
+    bool isHttp2Enabled() const { return m_http2; }
+    bool isPipeliningEnabled() const { return m_pipelining; }
+    bool isPipelineParallel() const { return m_pipelineParallel; }
+    const ConnectionLimits &getLimits() const { return m_limits; }
+    std::chrono::seconds getShutdownTimeout() const { return m_shutdownTimeout; }
+    const std::vector<ListenerConfig> &getListeners() const { return m_listeners; }
 
 private:
+    // 每行“名称 = 地址 [tls] [v6only] [proxy]”，按名称排序以保证启动顺序稳定
+    void loadListeners(ConfigParser &configParser) {
+        for (const auto &[name, value]: configParser.getSectionMap("listen")) {
+            std::istringstream ss(value);
+            std::string text;
+            ss >> text;
+            ListenerConfig listener;
+            listener.name = name;
+            listener.address = Address::parse(text);
+            listener.tls = false;
+            if (!listener.address) {
+                spdlog::warn("Invalid listen.{} address '{}', skipping", name, text);
+                continue;
+            }
+            std::string option;
+            while (ss >> option) {
+                if (option == "tls") {
+                    listener.tls = true;
+                } else if (option == "v6only") {
+                    listener.v6only = true;
+                } else if (option == "proxy") {
+                    listener.proxy = true;
+                } else {
+                    spdlog::warn("Unknown option '{}' in listen.{}", option, name);
+                }
+            }
+            m_listeners.push_back(listener);
+        }
+        std::sort(m_listeners.begin(), m_listeners.end(),
+                  [](const ListenerConfig &a, const ListenerConfig &b) { return a.name < b.name; });
+    }
+
     uint16_t m_port;
     int m_threads;
     std::string m_allowedIps;
+    bool m_http2;
+    bool m_pipelining;
+    bool m_pipelineParallel;
+    ConnectionLimits m_limits;
+    std::chrono::seconds m_shutdownTimeout;
+    std::vector<ListenerConfig> m_listeners;
 };
 
 class SiteConfig {
@@ -114,14 +254,29 @@ public:
             spdlog::warn("Missing site.default_site, defaulting to './index.html'");
             m_defaultSite = "./index.html";
         }
+
+        // 文件元数据缓存的有效期，inotify 可用时文件变化会立即失效，这里只是兜底
+        m_statCacheTtl = std::chrono::milliseconds(configParser.getCount("site.stat_cache_ttl_ms", 2000));
+        m_prewarm = configParser.getFlag("site.prewarm", false);
+        try {
+            m_bundle = configParser.getSiteConfig("bundle");
+        } catch (...) {
+            m_bundle.clear();
+        }
     }
 
     std::string getRootDirectory() const { return m_rootDirectory; }
     std::string getDefaultSite() const { return m_defaultSite; }
+    std::chrono::milliseconds getStatCacheTtl() const { return m_statCacheTtl; }
+    bool isPrewarm() const { return m_prewarm; }
+    std::string getBundle() const { return m_bundle; }
 
 private:
     std::string m_rootDirectory;
     std::string m_defaultSite;
+    std::chrono::milliseconds m_statCacheTtl{2000};
+    bool m_prewarm = false;
+    std::string m_bundle;
 };
 
 class ProxyConfig {
@@ -202,12 +357,237 @@ public:
             spdlog::warn("Invalid or missing session.timeout, defaulting to 5 minutes");
             m_timeoutMinutes = 5;
         }
+        m_maxSessions = configParser.getCount("session.max_sessions", 100000);
+
+        try {
+            m_mode = configParser.getSessionConfig("mode");
+        } catch (...) {
+            m_mode = "memory";
+        }
+        if (m_mode != "memory" && m_mode != "file" && m_mode != "redis" && m_mode != "signed") {
+            spdlog::warn("Invalid session.mode '{}', defaulting to memory", m_mode);
+            m_mode = "memory";
+        }
+        try {
+            m_secret = configParser.getSessionConfig("secret");
+        } catch (...) {
+            m_secret.clear();
+        }
+        m_encrypt = configParser.getFlag("session.encrypt", false);
+
+        try {
+            m_file = configParser.getSessionConfig("file");
+        } catch (...) {
+            m_file = "./sessions.db";
+        }
+        std::string redis;
+        try {
+            redis = configParser.getSessionConfig("redis");
+        } catch (...) {
+            redis = "127.0.0.1:6379";
+        }
+        size_t colon = redis.rfind(':');
+        m_redisHost = redis.substr(0, colon);
+        m_redisPort = 6379;
+        if (colon != std::string::npos) {
+            try {
+                m_redisPort = static_cast<uint16_t>(std::stoi(redis.substr(colon + 1)));
+            } catch (...) {
+                spdlog::warn("Invalid session.redis port, defaulting to 6379");
+            }
+        }
+        m_cacheTtl = std::chrono::milliseconds(configParser.getCount("session.cache_ttl_ms", 1000));
+
+        // 以空格或逗号分隔的路径前缀，匹配的请求不做会话处理
+        try {
+            std::string exclude = configParser.getSessionConfig("exclude");
+            std::replace(exclude.begin(), exclude.end(), ',', ' ');
+            std::istringstream ss(exclude);
+            std::string prefix;
+            while (ss >> prefix) {
+                m_excludePrefixes.push_back(prefix);
+            }
+        } catch (...) {
+        }
     }
 
     int getTimeoutMinutes() const { return m_timeoutMinutes; }
+    size_t getMaxSessions() const { return m_maxSessions; }
+    bool isSigned() const { return m_mode == "signed"; }
+    const std::string &getFile() const { return m_file; }
+    const std::string &getRedisHost() const { return m_redisHost; }
+    uint16_t getRedisPort() const { return m_redisPort; }
+    std::chrono::milliseconds getCacheTtl() const { return m_cacheTtl; }
+    bool isEncrypted() const { return m_encrypt; }
+    const std::string &getSecret() const { return m_secret; }
+    const std::string &getMode() const { return m_mode; }
+    const std::vector<std::string> &getExcludePrefixes() const { return m_excludePrefixes; }
+
+    bool isExcluded(std::string_view path) const {
+        for (const auto &prefix: m_excludePrefixes) {
+            if (path.starts_with(prefix)) {
+                return true;
+            }
+        }
+        return false;
+    }
 
 private:
     int m_timeoutMinutes;
+    size_t m_maxSessions;
+    std::string m_mode;
+    std::string m_secret;
+    bool m_encrypt;
+    std::string m_file;
+    std::string m_redisHost;
+    uint16_t m_redisPort;
+    std::chrono::milliseconds m_cacheTtl;
+    std::vector<std::string> m_excludePrefixes;
+};
+
+class LogConfig {
+public:
+    explicit LogConfig(ConfigParser &configParser) {
+        try {
+            m_accessLog = configParser.getLogConfig("access_log");
+        } catch (...) {
+            m_accessLog.clear();
+        }
+        m_maxSize = configParser.getCount("log.max_size_mb", 64) * 1024 * 1024;
+        m_maxFiles = configParser.getCount("log.max_files", 5);
+    }
+
+    // 为空表示不记录访问日志
+    const std::string &getAccessLog() const { return m_accessLog; }
+    size_t getMaxSize() const { return m_maxSize; }
+    size_t getMaxFiles() const { return m_maxFiles; }
+
+private:
+    std::string m_accessLog;
+    size_t m_maxSize;
+    size_t m_maxFiles;
+};
+
+class CaptureConfig {
+public:
+    explicit CaptureConfig(ConfigParser &configParser) {
+        m_enabled = configParser.getFlag("capture.enabled", false);
+        try {
+            m_file = configParser.getCaptureConfig("file");
+        } catch (...) {
+            m_file = "./capture.bin";
+        }
+        m_sampleEvery = configParser.getCount("capture.sample", 0);
+        try {
+            std::string paths = configParser.getCaptureConfig("paths");
+            std::replace(paths.begin(), paths.end(), ',', ' ');
+            std::istringstream ss(paths);
+            std::string prefix;
+            while (ss >> prefix) {
+                m_prefixes.push_back(prefix);
+            }
+        } catch (...) {
+        }
+        m_maxSize = configParser.getCount("capture.max_size_mb", 64) * 1024 * 1024;
+        m_maxFiles = configParser.getCount("capture.max_files", 3);
+    }
+
+    bool isEnabled() const { return m_enabled; }
+    const std::string &getFile() const { return m_file; }
+    size_t getSampleEvery() const { return m_sampleEvery; }
+    const std::vector<std::string> &getPrefixes() const { return m_prefixes; }
+    size_t getMaxSize() const { return m_maxSize; }
+    size_t getMaxFiles() const { return m_maxFiles; }
+
+private:
+    bool m_enabled;
+    std::string m_file;
+    size_t m_sampleEvery;
+    std::vector<std::string> m_prefixes;
+    size_t m_maxSize;
+    size_t m_maxFiles;
+};
+
+class MetricsConfig {
+public:
+    explicit MetricsConfig(ConfigParser &configParser) {
+        m_enabled = configParser.getFlag("metrics.enabled", true);
+        try {
+            m_path = configParser.getMetricsConfig("path");
+        } catch (...) {
+            m_path = "/metrics";
+        }
+        try {
+            std::string allow = configParser.getMetricsConfig("allow");
+            std::replace(allow.begin(), allow.end(), ',', ' ');
+            std::istringstream ss(allow);
+            std::string ip;
+            while (ss >> ip) {
+                m_allowedIps.push_back(ip);
+            }
+        } catch (...) {
+            m_allowedIps = {"127.0.0.1"};
+        }
+    }
+
+    bool isEnabled() const { return m_enabled; }
+    const std::string &getPath() const { return m_path; }
+    // 为空表示不限制来源
+    const std::vector<std::string> &getAllowedIps() const { return m_allowedIps; }
+
+private:
+    bool m_enabled;
+    std::string m_path;
+    std::vector<std::string> m_allowedIps;
+};
+
+class AdmissionConfig {
+public:
+    explicit AdmissionConfig(ConfigParser &configParser) {
+        try {
+            m_allow = configParser.getAdmissionConfig("allow");
+        } catch (...) {
+        }
+        try {
+            m_deny = configParser.getAdmissionConfig("deny");
+        } catch (...) {
+        }
+        try {
+            m_trustedProxies = configParser.getAdmissionConfig("trusted_proxies");
+        } catch (...) {
+        }
+        m_connectionRate.rate = configParser.getCount("admission.connection_rate", 0);
+        m_connectionRate.burst = configParser.getCount("admission.connection_burst", 0);
+        m_requestRate.rate = configParser.getCount("admission.request_rate", 0);
+        m_requestRate.burst = configParser.getCount("admission.request_burst", 0);
+    }
+
+    // 每次调用重新编译，列表中无法解析的条目会给出警告
+    IpFilter buildFilter() const {
+        IpFilter filter;
+        filter.addList(m_allow, true);
+        filter.addList(m_deny, false);
+        return filter;
+    }
+
+    IpFilter buildTrustedProxies() const {
+        IpFilter filter;
+        filter.addList(m_trustedProxies, true);
+        return filter;
+    }
+
+    const std::string &getAllow() const { return m_allow; }
+    const std::string &getDeny() const { return m_deny; }
+    const std::string &getTrustedProxies() const { return m_trustedProxies; }
+    const RateLimit &getConnectionRate() const { return m_connectionRate; }
+    const RateLimit &getRequestRate() const { return m_requestRate; }
+
+private:
+    std::string m_allow;
+    std::string m_deny;
+    std::string m_trustedProxies;
+    RateLimit m_connectionRate;
+    RateLimit m_requestRate;
 };
 
 class ConfigCenter {
@@ -226,6 +606,10 @@ public:
         m_uploadConfig = std::make_shared<UploadConfig>(*m_configParser);
         m_cookieConfig = std::make_shared<CookieConfig>(*m_configParser);
         m_sessionConfig = std::make_shared<SessionConfig>(*m_configParser);
+        m_logConfig = std::make_shared<LogConfig>(*m_configParser);
+        m_captureConfig = std::make_shared<CaptureConfig>(*m_configParser);
+        m_metricsConfig = std::make_shared<MetricsConfig>(*m_configParser);
+        m_admissionConfig = std::make_shared<AdmissionConfig>(*m_configParser);
     }
 
     void printConfigInfo() {
@@ -235,16 +619,54 @@ public:
         auto cookieConfig = ConfigCenter::instance().getCookieConfig();
         auto sessionConfig = ConfigCenter::instance().getSessionConfig();
         auto proxyConfig = ConfigCenter::instance().getProxyConfig();
+        auto logConfig = ConfigCenter::instance().getLogConfig();
+        auto captureConfig = ConfigCenter::instance().getCaptureConfig();
+        auto metricsConfig = ConfigCenter::instance().getMetricsConfig();
+        auto admissionConfig = ConfigCenter::instance().getAdmissionConfig();
 
         spdlog::info("========= Loaded Configuration =========");
         spdlog::info("Server:");
-        spdlog::info("  Port        : {}", serverConfig->getPort());
+        for (const auto &listener: serverConfig->getListeners()) {
+            spdlog::info("  Listen      : {} = {}{}{}{}", listener.name, listener.address->toString(),
+                         listener.tls ? " (tls)" : "",
+                         listener.v6only && listener.address->getFamily() == AF_INET6 ? " (v6only)" : "",
+                         listener.proxy ? " (proxy)" : "");
+        }
         spdlog::info("  Threads     : {}", serverConfig->getThreads());
         spdlog::info("  Allowed IPs : {}", serverConfig->getAllowedIps());
+        spdlog::info("  HTTP/2      : {}", serverConfig->isHttp2Enabled() ? "on" : "off");
+        spdlog::info("  Pipelining  : {}{}", serverConfig->isPipeliningEnabled() ? "on" : "off",
+                     serverConfig->isPipelineParallel() ? " (parallel)" : "");
+        const auto &limits = serverConfig->getLimits();
+        spdlog::info("  Timeouts    : idle {}s, header {}s, body {}s", limits.keepAliveTimeout.count(),
+                     limits.headerTimeout.count(), limits.bodyTimeout.count());
+        spdlog::info("  Conn Limits : {} total, {} per IP, {} requests each", limits.maxConnections,
+                     limits.maxConnectionsPerIp, limits.maxRequestsPerConnection);
+        if (limits.queueTarget.count() > 0) {
+            spdlog::info("  Queue Delay : target {} ms, interval {} ms", limits.queueTarget.count(),
+                         std::max(limits.queueInterval, limits.queueTarget).count());
+        } else {
+            spdlog::info("  Queue Delay : unlimited");
+        }
+
+        spdlog::info("Admission:");
+        spdlog::info("  Allow       : {}", admissionConfig->getAllow().empty() ? "(any)" : admissionConfig->getAllow());
+        spdlog::info("  Deny        : {}", admissionConfig->getDeny().empty() ? "(none)" : admissionConfig->getDeny());
+        spdlog::info("  Proxies     : {}",
+                     admissionConfig->getTrustedProxies().empty() ? "(none)" : admissionConfig->getTrustedProxies());
+        auto rateText = [](const RateLimit &limit) {
+            return limit.rate ? fmt::format("{}/s per IP, burst {}", limit.rate, std::max(limit.burst, limit.rate))
+                              : std::string("off");
+        };
+        spdlog::info("  Conn Rate   : {}", rateText(admissionConfig->getConnectionRate()));
+        spdlog::info("  Req Rate    : {}", rateText(admissionConfig->getRequestRate()));
 
         spdlog::info("Site:");
         spdlog::info("  Root Dir    : {}", siteConfig->getRootDirectory());
         spdlog::info("  Default Site: {}", siteConfig->getDefaultSite());
+        spdlog::info("  Stat Cache  : {} ms", siteConfig->getStatCacheTtl().count());
+        spdlog::info("  Pre-warm    : {}", siteConfig->isPrewarm() ? "on" : "off");
+        spdlog::info("  Bundle      : {}", siteConfig->getBundle().empty() ? "(none)" : siteConfig->getBundle());
 
         spdlog::info("Upload:");
         spdlog::info("  Request Path: {}", uploadConfig->getRequestPath());
@@ -256,12 +678,42 @@ public:
 
         spdlog::info("Session:");
         spdlog::info("  Timeout     : {} minutes", sessionConfig->getTimeoutMinutes());
+        if (sessionConfig->getMode() == "file") {
+            spdlog::info("  Mode        : file ({})", sessionConfig->getFile());
+        } else if (sessionConfig->getMode() == "redis") {
+            spdlog::info("  Mode        : redis ({}:{}, cache {} ms)", sessionConfig->getRedisHost(),
+                         sessionConfig->getRedisPort(), sessionConfig->getCacheTtl().count());
+        } else {
+            spdlog::info("  Mode        : {}{}", sessionConfig->getMode(),
+                         sessionConfig->isSigned() && sessionConfig->isEncrypted() ? " (encrypted)" : "");
+        }
+        spdlog::info("  Max sessions: {}", sessionConfig->getMaxSessions());
 
         spdlog::info("Proxy:");
         for (const auto &kv : proxyConfig->getProxyMap()) {
             spdlog::info("  PathPrefix: {} -> ProxyHandler", kv.first);
         }
 
+        spdlog::info("Log:");
+        if (logConfig->getAccessLog().empty()) {
+            spdlog::info("  Access Log  : off");
+        } else {
+            spdlog::info("  Access Log  : {} ({} MB x {})", logConfig->getAccessLog(), logConfig->getMaxSize() / 1024 / 1024,
+                         logConfig->getMaxFiles());
+        }
+        if (captureConfig->isEnabled()) {
+            spdlog::info("  Capture     : {} (1/{} sampled, {} path prefix(es))", captureConfig->getFile(),
+                         captureConfig->getSampleEvery(), captureConfig->getPrefixes().size());
+        } else {
+            spdlog::info("  Capture     : off");
+        }
+        if (metricsConfig->isEnabled()) {
+            spdlog::info("  Metrics     : {} ({} allowed client(s))", metricsConfig->getPath(),
+                         metricsConfig->getAllowedIps().size());
+        } else {
+            spdlog::info("  Metrics     : off");
+        }
+
         spdlog::info("=========================================");
     }
 
@@ -271,6 +723,10 @@ public:
     std::shared_ptr<UploadConfig> getUploadConfig() const { return m_uploadConfig; }
     std::shared_ptr<CookieConfig> getCookieConfig() const { return m_cookieConfig; }
     std::shared_ptr<SessionConfig> getSessionConfig() const { return m_sessionConfig; }
+    std::shared_ptr<LogConfig> getLogConfig() const { return m_logConfig; }
+    std::shared_ptr<CaptureConfig> getCaptureConfig() const { return m_captureConfig; }
+    std::shared_ptr<MetricsConfig> getMetricsConfig() const { return m_metricsConfig; }
+    std::shared_ptr<AdmissionConfig> getAdmissionConfig() const { return m_admissionConfig; }
 
 
 private:
@@ -286,4 +742,8 @@ private:
     std::shared_ptr<UploadConfig> m_uploadConfig;
     std::shared_ptr<CookieConfig> m_cookieConfig;
     std::shared_ptr<SessionConfig> m_sessionConfig;
+    std::shared_ptr<LogConfig> m_logConfig;
+    std::shared_ptr<CaptureConfig> m_captureConfig;
+    std::shared_ptr<MetricsConfig> m_metricsConfig;
+    std::shared_ptr<AdmissionConfig> m_admissionConfig;
 };
@@ -0,0 +1,109 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// 连接相关的超时与上限，0 表示不限制
+struct ConnectionLimits {
+    std::chrono::seconds keepAliveTimeout{15}; // 两个请求之间的空闲时间
+    std::chrono::seconds headerTimeout{10};    // 从首字节（含 TLS 握手）到头部接收完成
+    std::chrono::seconds bodyTimeout{30};      // 从头部完成到请求体接收完成
+    size_t maxRequestsPerConnection = 1000;
+    size_t maxConnections = 10000;
+    size_t maxConnectionsPerIp = 100;
+    // 新连接等待工作线程的排队时延目标与观察窗口，持续超过目标时快速返回 503；0 表示不限制
+    std::chrono::milliseconds queueTarget{100};
+    std::chrono::milliseconds queueInterval{1000};
+};
+
+// 全局与单 IP 的并发连接计数，在 accept 之后立即检查；ip 为空（UNIX 域套接字）时只计入全局
+class ConnectionLimiter {
+public:
+    // RAII：析构时归还名额
+    class Ticket {
+    public:
+        Ticket() = default;
+        Ticket(ConnectionLimiter *limiter, std::string ip) : m_limiter(limiter), m_ip(std::move(ip)) {}
+        Ticket(Ticket &&other) noexcept : m_limiter(other.m_limiter), m_ip(std::move(other.m_ip)) {
+            other.m_limiter = nullptr;
+        }
+        Ticket(const Ticket &) = delete;
+        Ticket &operator=(const Ticket &) = delete;
+        ~Ticket() {
+            if (m_limiter) {
+                m_limiter->release(m_ip);
+            }
+        }
+
+        explicit operator bool() const { return m_limiter != nullptr; }
+
+    private:
+        friend class ConnectionLimiter;
+        ConnectionLimiter *m_limiter = nullptr;
+        std::string m_ip;
+    };
+
+    void setLimits(size_t maxConnections, size_t maxPerIp) {
+        m_maxConnections = maxConnections;
+        m_maxPerIp = maxPerIp;
+    }
+
+    Ticket tryAcquire(const std::string &ip) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_maxConnections && m_active >= m_maxConnections) {
+            return Ticket();
+        }
+        if (ip.empty()) {
+            ++m_active;
+            return Ticket(this, ip);
+        }
+        size_t &count = m_perIp[ip];
+        if (m_maxPerIp && count >= m_maxPerIp) {
+            if (count == 0) {
+                m_perIp.erase(ip);
+            }
+            return Ticket();
+        }
+        ++count;
+        ++m_active;
+        return Ticket(this, ip);
+    }
+
+    // 来源要稍后才知道的连接（PROXY 协议）先以空 ip 占全局名额，得知来源后再补记单 IP 计数；超限时返回 false
+    bool tryAttach(Ticket &ticket, const std::string &ip) {
+        if (!ticket || ip.empty()) {
+            return static_cast<bool>(ticket);
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        size_t &count = m_perIp[ip];
+        if (m_maxPerIp && count >= m_maxPerIp) {
+            if (count == 0) {
+                m_perIp.erase(ip);
+            }
+            return false;
+        }
+        ++count;
+        ticket.m_ip = ip;
+        return true;
+    }
+
+    size_t active() const { return m_active; }
+
+private:
+    std::mutex m_mutex;
+    std::unordered_map<std::string, size_t> m_perIp;
+    std::atomic<size_t> m_active{0};
+    size_t m_maxConnections = 0;
+    size_t m_maxPerIp = 0;
+
+    void release(const std::string &ip) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = ip.empty() ? m_perIp.end() : m_perIp.find(ip);
+        if (it != m_perIp.end() && --it->second == 0) {
+            m_perIp.erase(it);
+        }
+        --m_active;
+    }
+};
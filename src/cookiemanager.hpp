@@ -1,10 +1,21 @@
 #pragma once
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
 #include <map>
-#include <string>
+#include <memory>
+#include <mutex>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
 #include <optional>
+#include <string>
+#include <thread>
 
 #include "configparser.hpp"
 #include "server.hpp"
+#include "sessionstore.hpp"
 
 class CookieManager {
 public:
@@ -48,54 +59,303 @@ private:
 };
 
 
+// 无状态会话：会话内容（过期时间、用户）直接放在 sid cookie 中，
+// 格式为 base64url(body).base64url(HMAC-SHA256(body))，开启加密时 body 为 IV + AES-256-CTR 密文。
+// 校验只依赖密钥，不访问共享状态，多实例共用同一 secret 即可互通
+class SessionCodec {
+public:
+    struct Payload {
+        int64_t expiry = 0; // Unix 时间戳（秒）
+        std::string user;
+    };
+
+    // secret 为空时使用进程内随机密钥，重启后已签发的会话失效
+    SessionCodec(const std::string &secret, bool encrypt) : m_encrypt(encrypt) {
+        std::string master = secret;
+        if (master.empty()) {
+            master.resize(32);
+            if (RAND_bytes(reinterpret_cast<unsigned char *>(master.data()), static_cast<int>(master.size())) != 1) {
+                throw std::runtime_error("RAND_bytes failed");
+            }
+        }
+        // 加密与签名使用由 secret 派生的不同密钥
+        m_macKey = hmac(master, "sid-mac");
+        m_encKey = hmac(master, "sid-enc");
+    }
+
+    std::string encode(const Payload &payload) const {
+        unsigned char nonce[8];
+        if (RAND_bytes(nonce, sizeof(nonce)) != 1) {
+            throw std::runtime_error("RAND_bytes failed");
+        }
+        std::string body = std::to_string(payload.expiry) + "|" +
+                           base64UrlEncode(std::string(reinterpret_cast<char *>(nonce), sizeof(nonce))) + "|" + payload.user;
+        if (m_encrypt) {
+            body = encrypt(body);
+        }
+        std::string encoded = base64UrlEncode(body);
+        return encoded + "." + base64UrlEncode(hmac(m_macKey, encoded));
+    }
+
+    std::optional<Payload> decode(const std::string &token) const {
+        size_t dot = token.find('.');
+        if (dot == std::string::npos) {
+            return std::nullopt;
+        }
+        std::string encoded = token.substr(0, dot);
+        std::string expected = hmac(m_macKey, encoded);
+        auto mac = base64UrlDecode(token.substr(dot + 1));
+        if (!mac || mac->size() != expected.size() || CRYPTO_memcmp(mac->data(), expected.data(), expected.size()) != 0) {
+            return std::nullopt;
+        }
+        auto body = base64UrlDecode(encoded);
+        if (!body) {
+            return std::nullopt;
+        }
+        std::string plain = m_encrypt ? decrypt(*body) : *body;
+
+        size_t first = plain.find('|');
+        size_t second = first == std::string::npos ? std::string::npos : plain.find('|', first + 1);
+        if (second == std::string::npos) {
+            return std::nullopt;
+        }
+        Payload payload;
+        try {
+            payload.expiry = std::stoll(plain.substr(0, first));
+        } catch (...) {
+            return std::nullopt;
+        }
+        payload.user = plain.substr(second + 1);
+        return payload;
+    }
+
+private:
+    static constexpr size_t kIvSize = 16;
+
+    bool m_encrypt;
+    std::string m_macKey;
+    std::string m_encKey;
+
+    static std::string hmac(const std::string &key, const std::string &data) {
+        unsigned char out[EVP_MAX_MD_SIZE];
+        unsigned int length = 0;
+        HMAC(EVP_sha256(), key.data(), static_cast<int>(key.size()), reinterpret_cast<const unsigned char *>(data.data()),
+             data.size(), out, &length);
+        return std::string(reinterpret_cast<char *>(out), length);
+    }
+
+    // CTR 模式加解密是同一操作
+    std::string aesCtr(const std::string &iv, const std::string &input) const {
+        std::string output(input.size(), '\0');
+        EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+        int length = 0;
+        bool ok = ctx &&
+                  EVP_EncryptInit_ex(ctx, EVP_aes_256_ctr(), nullptr, reinterpret_cast<const unsigned char *>(m_encKey.data()),
+                                     reinterpret_cast<const unsigned char *>(iv.data())) == 1 &&
+                  EVP_EncryptUpdate(ctx, reinterpret_cast<unsigned char *>(output.data()), &length,
+                                    reinterpret_cast<const unsigned char *>(input.data()), static_cast<int>(input.size())) == 1;
+        EVP_CIPHER_CTX_free(ctx);
+        if (!ok) {
+            throw std::runtime_error("AES-256-CTR failed");
+        }
+        return output;
+    }
+
+    std::string encrypt(const std::string &plain) const {
+        std::string iv(kIvSize, '\0');
+        if (RAND_bytes(reinterpret_cast<unsigned char *>(iv.data()), static_cast<int>(iv.size())) != 1) {
+            throw std::runtime_error("RAND_bytes failed");
+        }
+        return iv + aesCtr(iv, plain);
+    }
+
+    std::string decrypt(const std::string &body) const {
+        if (body.size() < kIvSize) {
+            return "";
+        }
+        return aesCtr(body.substr(0, kIvSize), body.substr(kIvSize));
+    }
+
+    static std::string base64UrlEncode(const std::string &data) {
+        std::string out(4 * ((data.size() + 2) / 3) + 1, '\0');
+        int length = EVP_EncodeBlock(reinterpret_cast<unsigned char *>(out.data()),
+                                     reinterpret_cast<const unsigned char *>(data.data()), static_cast<int>(data.size()));
+        out.resize(length);
+        while (!out.empty() && out.back() == '=') {
+            out.pop_back();
+        }
+        std::replace(out.begin(), out.end(), '+', '-');
+        std::replace(out.begin(), out.end(), '/', '_');
+        return out;
+    }
+
+    static std::optional<std::string> base64UrlDecode(std::string data) {
+        if (data.find_first_not_of("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_") != std::string::npos ||
+            data.size() % 4 == 1) {
+            return std::nullopt;
+        }
+        std::replace(data.begin(), data.end(), '-', '+');
+        std::replace(data.begin(), data.end(), '_', '/');
+        size_t padding = (4 - data.size() % 4) % 4;
+        data.append(padding, '=');
+        std::string out(data.size() / 4 * 3, '\0');
+        int length = EVP_DecodeBlock(reinterpret_cast<unsigned char *>(out.data()),
+                                     reinterpret_cast<const unsigned char *>(data.data()), static_cast<int>(data.size()));
+        if (length < 0) {
+            return std::nullopt;
+        }
+        // EVP_DecodeBlock 不处理填充，需要去掉补齐产生的字节
+        out.resize(length - padding);
+        return out;
+    }
+};
+
+// memory/file/redis 模式：会话保存在对应的 SessionStore 中，由后台线程定期清理过期会话。
+// signed 模式：会话内容由 SessionCodec 编码进 sid 本身，不维护服务端状态
 class SessionManager {
 public:
     SessionManager()
-        : m_sessionTimeout(std::chrono::minutes(
-              ConfigCenter::instance().getSessionConfig()->getTimeoutMinutes())) {}
+        : m_sessionTimeout(std::chrono::minutes(ConfigCenter::instance().getSessionConfig()->getTimeoutMinutes())) {
+        auto config = ConfigCenter::instance().getSessionConfig();
+        const std::string &mode = config->getMode();
+        if (mode == "signed") {
+            if (config->getSecret().empty()) {
+                spdlog::warn("[SessionManager] session.secret not set, signed sessions will not survive a restart");
+            }
+            m_codec = std::make_unique<SessionCodec>(config->getSecret(), config->isEncrypted());
+            return;
+        }
+        if (mode == "file") {
+            m_store = std::make_shared<MmapSessionStore>(config->getFile(), config->getMaxSessions());
+        } else if (mode == "redis") {
+            m_store = std::make_shared<RespSessionStore>(config->getRedisHost(), config->getRedisPort(), config->getCacheTtl());
+        } else {
+            m_store = std::make_shared<MemorySessionStore>(config->getMaxSessions());
+        }
+        m_sweeper = std::thread(&SessionManager::sweepLoop, this);
+    }
+
+    // 使用自定义存储后端
+    explicit SessionManager(SessionStore::ptr store, std::chrono::minutes timeout)
+        : m_sessionTimeout(timeout), m_store(std::move(store)) {
+        m_sweeper = std::thread(&SessionManager::sweepLoop, this);
+    }
+
+    ~SessionManager() {
+        {
+            std::lock_guard<std::mutex> lock(m_sweepMutex);
+            m_stopped = true;
+        }
+        m_sweepCond.notify_all();
+        if (m_sweeper.joinable()) {
+            m_sweeper.join();
+        }
+    }
 
     std::string createSession() {
+        if (m_codec) {
+            return m_codec->encode({expiryFromNow(), ""});
+        }
         std::string sessionId = generateSessionId();
-        m_sessions[sessionId].creationTime = std::chrono::system_clock::now();
+        m_store->put(sessionId, {expiryFromNow(), ""});
         return sessionId;
     }
 
     bool validateSession(const std::string &sid) {
-        auto it = m_sessions.find(sid);
-        if (it != m_sessions.end()) {
-            auto now = std::chrono::system_clock::now();
-            auto duration = std::chrono::duration_cast<std::chrono::minutes>(now - it->second.creationTime);
-            if (duration > m_sessionTimeout) {
-                m_sessions.erase(it);
-                return false;
-            }
-            return true;
+        if (m_codec) {
+            auto payload = m_codec->decode(sid);
+            return payload && payload->expiry > unixNow();
+        }
+        auto record = m_store->get(sid);
+        if (!record) {
+            return false;
         }
-        return false;
+        if (record->expiry <= unixNow()) {
+            m_store->remove(sid);
+            return false;
+        }
+        return true;
     }
 
-    void setUser(const std::string &sid, const std::string &user) {
-        m_sessions[sid].user = user;
+    // 返回设置后的 sid：signed 模式下会话内容变化需要重新签发 cookie
+    std::string setUser(const std::string &sid, const std::string &user) {
+        if (m_codec) {
+            auto payload = m_codec->decode(sid);
+            return m_codec->encode({payload ? payload->expiry : expiryFromNow(), user});
+        }
+        auto record = m_store->get(sid);
+        if (record) {
+            record->user = user;
+            m_store->put(sid, *record);
+        }
+        return sid;
     }
 
     std::optional<std::string> getUser(const std::string &sid) {
-        auto it = m_sessions.find(sid);
-        if (it != m_sessions.end()) {
-            return it->second.user;
+        if (m_codec) {
+            auto payload = m_codec->decode(sid);
+            if (payload) {
+                return payload->user;
+            }
+            return std::nullopt;
+        }
+        auto record = m_store->get(sid);
+        if (record) {
+            return record->user;
         }
         return std::nullopt;
     }
 
 private:
-    struct Session {
-        std::chrono::system_clock::time_point creationTime;
-        std::string user;
-    };
+    static constexpr auto kSweepInterval = std::chrono::seconds(30);
 
-    std::map<std::string, Session> m_sessions;
     std::chrono::minutes m_sessionTimeout;
+    SessionStore::ptr m_store;
+    std::unique_ptr<SessionCodec> m_codec;
+
+    std::thread m_sweeper;
+    std::mutex m_sweepMutex;
+    std::condition_variable m_sweepCond;
+    bool m_stopped = false;
+
+    static int64_t unixNow() {
+        return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
 
-    std::string generateSessionId() {
-        return std::to_string(std::rand()); // 改进空间：使用 UUID
+    int64_t expiryFromNow() const {
+        return unixNow() + std::chrono::duration_cast<std::chrono::seconds>(m_sessionTimeout).count();
+    }
+
+    // 128 位随机数，来自 OpenSSL 的 CSPRNG
+    static std::string generateSessionId() {
+        unsigned char bytes[16];
+        if (RAND_bytes(bytes, sizeof(bytes)) != 1) {
+            throw std::runtime_error("RAND_bytes failed");
+        }
+        static const char *hex = "0123456789abcdef";
+        std::string id;
+        id.reserve(sizeof(bytes) * 2);
+        for (unsigned char byte: bytes) {
+            id.push_back(hex[byte >> 4]);
+            id.push_back(hex[byte & 0x0f]);
+        }
+        return id;
+    }
+
+    // 后台定期清理过期会话，避免只靠访问时惰性删除导致表无限增长
+    void sweepLoop() {
+        std::unique_lock<std::mutex> lock(m_sweepMutex);
+        while (!m_stopped) {
+            m_sweepCond.wait_for(lock, kSweepInterval);
+            if (m_stopped) {
+                break;
+            }
+            lock.unlock();
+            size_t removed = m_store->sweep(unixNow());
+            if (removed > 0) {
+                SPDLOG_DEBUG("[SessionManager] Expired {} session(s)", removed);
+            }
+            lock.lock();
+        }
     }
 };
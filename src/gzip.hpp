@@ -1,4 +1,6 @@
+#pragma once
 #include <iostream>
+#include <limits>
 #include <server.hpp>
 #include <spdlog/spdlog.h>
 #include <string>
@@ -9,38 +11,24 @@ using namespace std;
 
 class GzipHandler {
 public:
-    static bool compress(const string &input, string &output) {
-        // 创建Gzip压缩流
-        gzFile gzFile = gzopen("compressed.gz", "wb");
-        if (!gzFile) {
+    // 在内存中压缩为 gzip 格式（windowBits 加 16 生成 gzip 头尾），可被多个线程同时调用
+    static bool compress(std::string_view input, string &output) {
+        if (input.size() > std::numeric_limits<uInt>::max()) {
             return false;
         }
-
-        // 写入数据
-        gzwrite(gzFile, input.data(), input.size());
-
-        // 关闭Gzip流
-        if (gzclose(gzFile) != Z_OK) {
-            return false;
-        }
-
-        // 读取压缩后的数据
-        ifstream ifs("compressed.gz", ios::binary);
-        if (!ifs) {
+        z_stream stream{};
+        if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
             return false;
         }
-
-        ifs.seekg(0, ios::end);
-        size_t size = ifs.tellg();
-        ifs.seekg(0, ios::beg);
-        output.resize(size);
-        ifs.read(&output[0], size);
-        ifs.close();
-
-        // 删除临时文件
-        remove("compressed.gz");
-
-        return true;
+        output.resize(deflateBound(&stream, input.size()));
+        stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+        stream.avail_in = static_cast<uInt>(input.size());
+        stream.next_out = reinterpret_cast<Bytef *>(output.data());
+        stream.avail_out = static_cast<uInt>(output.size());
+        int ret = deflate(&stream, Z_FINISH);
+        output.resize(stream.total_out);
+        deflateEnd(&stream);
+        return ret == Z_STREAM_END;
     }
 
     static bool decompress(const string &input, string &output) {
@@ -0,0 +1,144 @@
+#pragma once
+#include <chrono>
+#include <climits>
+#include <csignal>
+#include <cstdlib>
+#include <fcntl.h>
+#include <poll.h>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+extern char **environ;
+
+// 零停机重载：旧进程把所有监听套接字交给重新 exec 的新进程，
+// 新进程开始 accept 后通过管道通知旧进程，旧进程再优雅退出
+class HotReload {
+public:
+    static constexpr const char *kListenFdEnv = "HTTP_SERVER_LISTEN_FD";
+    static constexpr const char *kReadyFdEnv = "HTTP_SERVER_READY_FD";
+
+    // 从旧进程继承的监听套接字（环境变量中以逗号分隔），没有则返回空
+    static std::vector<int> inheritedListenFds() {
+        std::vector<int> fds;
+        const char *value = std::getenv(kListenFdEnv);
+        if (!value) {
+            return fds;
+        }
+        std::string list = value;
+        unsetenv(kListenFdEnv);
+        for (size_t pos = 0; pos < list.size();) {
+            size_t end = list.find(',', pos);
+            int fd = std::atoi(list.substr(pos, end - pos).c_str());
+            if (fd >= 0 && fcntl(fd, F_GETFD) != -1) {
+                fcntl(fd, F_SETFD, FD_CLOEXEC);
+                fds.push_back(fd);
+            }
+            pos = end == std::string::npos ? list.size() : end + 1;
+        }
+        return fds;
+    }
+
+    // 新进程已开始服务时调用，通知旧进程可以退出
+    static void notifyReady() {
+        const char *value = std::getenv(kReadyFdEnv);
+        if (!value) {
+            return;
+        }
+        int fd = std::atoi(value);
+        unsetenv(kReadyFdEnv);
+        char ready = 1;
+        if (::write(fd, &ready, 1) != 1) {
+            spdlog::warn("[HotReload] Failed to notify previous process");
+        }
+        ::close(fd);
+    }
+
+    // fork 之后调用，只用系统调用；旧内核不支持 CLOSE_RANGE_CLOEXEC 时逐个设置
+    static void markCloseOnExec(rlim_t maxFds) {
+        if (close_range(3, ~0U, CLOSE_RANGE_CLOEXEC) == 0) {
+            return;
+        }
+        for (rlim_t fd = 3; fd < maxFds && fd < INT_MAX; ++fd) {
+            fcntl(static_cast<int>(fd), F_SETFD, FD_CLOEXEC);
+        }
+    }
+
+    // fork + exec 当前可执行文件并交出监听套接字，新进程在 timeout 内就绪才返回 true，
+    // 否则结束新进程，由旧进程继续服务
+    static bool spawnSuccessor(const std::vector<int> &listenFds, char **argv, std::chrono::seconds timeout) {
+        int pipefd[2];
+        if (pipe2(pipefd, O_CLOEXEC) == -1) {
+            return false;
+        }
+
+        // fork 之后子进程只能调用 async-signal-safe 函数，环境变量提前准备好
+        std::vector<std::string> env;
+        for (char **e = environ; *e; ++e) {
+            std::string entry = *e;
+            if (entry.rfind(std::string(kListenFdEnv) + "=", 0) != 0 &&
+                entry.rfind(std::string(kReadyFdEnv) + "=", 0) != 0) {
+                env.push_back(entry);
+            }
+        }
+        std::string fdList;
+        for (int fd: listenFds) {
+            fdList += (fdList.empty() ? "" : ",") + std::to_string(fd);
+        }
+        env.push_back(std::string(kListenFdEnv) + "=" + fdList);
+        env.push_back(std::string(kReadyFdEnv) + "=" + std::to_string(pipefd[1]));
+        std::vector<char *> envp;
+        for (auto &entry: env) {
+            envp.push_back(entry.data());
+        }
+        envp.push_back(nullptr);
+
+        char exe[4096];
+        ssize_t exeLength = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+        if (exeLength <= 0) {
+            ::close(pipefd[0]);
+            ::close(pipefd[1]);
+            return false;
+        }
+        exe[exeLength] = '\0';
+        struct rlimit limit {};
+        getrlimit(RLIMIT_NOFILE, &limit);
+
+        pid_t pid = fork();
+        if (pid == 0) {
+            sigset_t empty;
+            sigemptyset(&empty);
+            sigprocmask(SIG_SETMASK, &empty, nullptr);
+            // 新进程只继承监听套接字与就绪管道：其余描述符（日志文件、inotify、会话存储连接、
+            // 打包文件、其他线程刚打开而尚未设置 CLOEXEC 的描述符等）一律在 exec 时关闭
+            markCloseOnExec(limit.rlim_cur);
+            for (int fd: listenFds) {
+                fcntl(fd, F_SETFD, 0);
+            }
+            fcntl(pipefd[1], F_SETFD, 0);
+            execve(exe, argv, envp.data());
+            _exit(127);
+        }
+        ::close(pipefd[1]);
+        if (pid == -1) {
+            ::close(pipefd[0]);
+            return false;
+        }
+
+        struct pollfd pfd = {pipefd[0], POLLIN, 0};
+        char ready = 0;
+        bool ok = ::poll(&pfd, 1, static_cast<int>(timeout.count() * 1000)) > 0 && ::read(pipefd[0], &ready, 1) == 1;
+        ::close(pipefd[0]);
+        if (!ok) {
+            spdlog::error("[HotReload] Successor {} did not become ready", pid);
+            kill(pid, SIGKILL);
+            waitpid(pid, nullptr, 0);
+            return false;
+        }
+        spdlog::info("[HotReload] Successor {} is accepting connections", pid);
+        return true;
+    }
+};
@@ -0,0 +1,503 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+// HPACK (RFC 7541) 头部压缩：静态表 + 动态表 + Huffman 编解码
+namespace hpack {
+
+    using Header = std::pair<std::string, std::string>;
+    using HeaderList = std::vector<Header>;
+
+    struct HuffmanCode {
+        uint32_t code;
+        uint8_t bits;
+    };
+
+    // RFC 7541 Appendix B，下标 256 为 EOS
+    inline const HuffmanCode *huffmanTable() {
+        static const HuffmanCode table[257] = {
+                {0x1ff8, 13}, {0x7fffd8, 23}, {0xfffffe2, 28}, {0xfffffe3, 28}, {0xfffffe4, 28}, {0xfffffe5, 28},
+                {0xfffffe6, 28}, {0xfffffe7, 28}, {0xfffffe8, 28}, {0xffffea, 24}, {0x3ffffffc, 30}, {0xfffffe9, 28},
+                {0xfffffea, 28}, {0x3ffffffd, 30}, {0xfffffeb, 28}, {0xfffffec, 28}, {0xfffffed, 28}, {0xfffffee, 28},
+                {0xfffffef, 28}, {0xffffff0, 28}, {0xffffff1, 28}, {0xffffff2, 28}, {0x3ffffffe, 30}, {0xffffff3, 28},
+                {0xffffff4, 28}, {0xffffff5, 28}, {0xffffff6, 28}, {0xffffff7, 28}, {0xffffff8, 28}, {0xffffff9, 28},
+                {0xffffffa, 28}, {0xffffffb, 28}, {0x14, 6}, {0x3f8, 10}, {0x3f9, 10}, {0xffa, 12},
+                {0x1ff9, 13}, {0x15, 6}, {0xf8, 8}, {0x7fa, 11}, {0x3fa, 10}, {0x3fb, 10},
+                {0xf9, 8}, {0x7fb, 11}, {0xfa, 8}, {0x16, 6}, {0x17, 6}, {0x18, 6},
+                {0x0, 5}, {0x1, 5}, {0x2, 5}, {0x19, 6}, {0x1a, 6}, {0x1b, 6},
+                {0x1c, 6}, {0x1d, 6}, {0x1e, 6}, {0x1f, 6}, {0x5c, 7}, {0xfb, 8},
+                {0x7ffc, 15}, {0x20, 6}, {0xffb, 12}, {0x3fc, 10}, {0x1ffa, 13}, {0x21, 6},
+                {0x5d, 7}, {0x5e, 7}, {0x5f, 7}, {0x60, 7}, {0x61, 7}, {0x62, 7},
+                {0x63, 7}, {0x64, 7}, {0x65, 7}, {0x66, 7}, {0x67, 7}, {0x68, 7},
+                {0x69, 7}, {0x6a, 7}, {0x6b, 7}, {0x6c, 7}, {0x6d, 7}, {0x6e, 7},
+                {0x6f, 7}, {0x70, 7}, {0x71, 7}, {0x72, 7}, {0xfc, 8}, {0x73, 7},
+                {0xfd, 8}, {0x1ffb, 13}, {0x7fff0, 19}, {0x1ffc, 13}, {0x3ffc, 14}, {0x22, 6},
+                {0x7ffd, 15}, {0x3, 5}, {0x23, 6}, {0x4, 5}, {0x24, 6}, {0x5, 5},
+                {0x25, 6}, {0x26, 6}, {0x27, 6}, {0x6, 5}, {0x74, 7}, {0x75, 7},
+                {0x28, 6}, {0x29, 6}, {0x2a, 6}, {0x7, 5}, {0x2b, 6}, {0x76, 7},
+                {0x2c, 6}, {0x8, 5}, {0x9, 5}, {0x2d, 6}, {0x77, 7}, {0x78, 7},
+                {0x79, 7}, {0x7a, 7}, {0x7b, 7}, {0x7ffe, 15}, {0x7fc, 11}, {0x3ffd, 14},
+                {0x1ffd, 13}, {0xffffffc, 28}, {0xfffe6, 20}, {0x3fffd2, 22}, {0xfffe7, 20}, {0xfffe8, 20},
+                {0x3fffd3, 22}, {0x3fffd4, 22}, {0x3fffd5, 22}, {0x7fffd9, 23}, {0x3fffd6, 22}, {0x7fffda, 23},
+                {0x7fffdb, 23}, {0x7fffdc, 23}, {0x7fffdd, 23}, {0x7fffde, 23}, {0xffffeb, 24}, {0x7fffdf, 23},
+                {0xffffec, 24}, {0xffffed, 24}, {0x3fffd7, 22}, {0x7fffe0, 23}, {0xffffee, 24}, {0x7fffe1, 23},
+                {0x7fffe2, 23}, {0x7fffe3, 23}, {0x7fffe4, 23}, {0x1fffdc, 21}, {0x3fffd8, 22}, {0x7fffe5, 23},
+                {0x3fffd9, 22}, {0x7fffe6, 23}, {0x7fffe7, 23}, {0xffffef, 24}, {0x3fffda, 22}, {0x1fffdd, 21},
+                {0xfffe9, 20}, {0x3fffdb, 22}, {0x3fffdc, 22}, {0x7fffe8, 23}, {0x7fffe9, 23}, {0x1fffde, 21},
+                {0x7fffea, 23}, {0x3fffdd, 22}, {0x3fffde, 22}, {0xfffff0, 24}, {0x1fffdf, 21}, {0x3fffdf, 22},
+                {0x7fffeb, 23}, {0x7fffec, 23}, {0x1fffe0, 21}, {0x1fffe1, 21}, {0x3fffe0, 22}, {0x1fffe2, 21},
+                {0x7fffed, 23}, {0x3fffe1, 22}, {0x7fffee, 23}, {0x7fffef, 23}, {0xfffea, 20}, {0x3fffe2, 22},
+                {0x3fffe3, 22}, {0x3fffe4, 22}, {0x7ffff0, 23}, {0x3fffe5, 22}, {0x3fffe6, 22}, {0x7ffff1, 23},
+                {0x3ffffe0, 26}, {0x3ffffe1, 26}, {0xfffeb, 20}, {0x7fff1, 19}, {0x3fffe7, 22}, {0x7ffff2, 23},
+                {0x3fffe8, 22}, {0x1ffffec, 25}, {0x3ffffe2, 26}, {0x3ffffe3, 26}, {0x3ffffe4, 26}, {0x7ffffde, 27},
+                {0x7ffffdf, 27}, {0x3ffffe5, 26}, {0xfffff1, 24}, {0x1ffffed, 25}, {0x7fff2, 19}, {0x1fffe3, 21},
+                {0x3ffffe6, 26}, {0x7ffffe0, 27}, {0x7ffffe1, 27}, {0x3ffffe7, 26}, {0x7ffffe2, 27}, {0xfffff2, 24},
+                {0x1fffe4, 21}, {0x1fffe5, 21}, {0x3ffffe8, 26}, {0x3ffffe9, 26}, {0xffffffd, 28}, {0x7ffffe3, 27},
+                {0x7ffffe4, 27}, {0x7ffffe5, 27}, {0xfffec, 20}, {0xfffff3, 24}, {0xfffed, 20}, {0x1fffe6, 21},
+                {0x3fffe9, 22}, {0x1fffe7, 21}, {0x1fffe8, 21}, {0x7ffff3, 23}, {0x3fffea, 22}, {0x3fffeb, 22},
+                {0x1ffffee, 25}, {0x1ffffef, 25}, {0xfffff4, 24}, {0xfffff5, 24}, {0x3ffffea, 26}, {0x7ffff4, 23},
+                {0x3ffffeb, 26}, {0x7ffffe6, 27}, {0x3ffffec, 26}, {0x3ffffed, 26}, {0x7ffffe7, 27}, {0x7ffffe8, 27},
+                {0x7ffffe9, 27}, {0x7ffffea, 27}, {0x7ffffeb, 27}, {0xffffffe, 28}, {0x7ffffec, 27}, {0x7ffffed, 27},
+                {0x7ffffee, 27}, {0x7ffffef, 27}, {0x7fffff0, 27}, {0x3ffffee, 26}, {0x3fffffff, 30},
+        };
+        return table;
+    }
+
+    inline const std::vector<Header> &staticTable() {
+        static const std::vector<Header> table = {
+                {":authority", ""},
+                {":method", "GET"},
+                {":method", "POST"},
+                {":path", "/"},
+                {":path", "/index.html"},
+                {":scheme", "http"},
+                {":scheme", "https"},
+                {":status", "200"},
+                {":status", "204"},
+                {":status", "206"},
+                {":status", "304"},
+                {":status", "400"},
+                {":status", "404"},
+                {":status", "500"},
+                {"accept-charset", ""},
+                {"accept-encoding", "gzip, deflate"},
+                {"accept-language", ""},
+                {"accept-ranges", ""},
+                {"accept", ""},
+                {"access-control-allow-origin", ""},
+                {"age", ""},
+                {"allow", ""},
+                {"authorization", ""},
+                {"cache-control", ""},
+                {"content-disposition", ""},
+                {"content-encoding", ""},
+                {"content-language", ""},
+                {"content-length", ""},
+                {"content-location", ""},
+                {"content-range", ""},
+                {"content-type", ""},
+                {"cookie", ""},
+                {"date", ""},
+                {"etag", ""},
+                {"expect", ""},
+                {"expires", ""},
+                {"from", ""},
+                {"host", ""},
+                {"if-match", ""},
+                {"if-modified-since", ""},
+                {"if-none-match", ""},
+                {"if-range", ""},
+                {"if-unmodified-since", ""},
+                {"last-modified", ""},
+                {"link", ""},
+                {"location", ""},
+                {"max-forwards", ""},
+                {"proxy-authenticate", ""},
+                {"proxy-authorization", ""},
+                {"range", ""},
+                {"referer", ""},
+                {"refresh", ""},
+                {"retry-after", ""},
+                {"server", ""},
+                {"set-cookie", ""},
+                {"strict-transport-security", ""},
+                {"transfer-encoding", ""},
+                {"user-agent", ""},
+                {"vary", ""},
+                {"via", ""},
+                {"www-authenticate", ""},
+        };
+        return table;
+    }
+
+    // Huffman 解码树，按码表一次性构建
+    class HuffmanTree {
+    public:
+        static const HuffmanTree &instance() {
+            static const HuffmanTree tree;
+            return tree;
+        }
+
+        bool decode(const uint8_t *data, size_t len, std::string &out) const {
+            int node = 0;
+            int depth = 0;
+            bool allOnes = true;
+            for (size_t i = 0; i < len; ++i) {
+                for (int b = 7; b >= 0; --b) {
+                    int bit = (data[i] >> b) & 1;
+                    node = m_nodes[node].next[bit];
+                    if (node < 0) {
+                        return false;
+                    }
+                    ++depth;
+                    allOnes = allOnes && bit;
+                    if (m_nodes[node].symbol >= 0) {
+                        if (m_nodes[node].symbol == 256) {
+                            return false; // 字符串中出现 EOS 视为错误
+                        }
+                        out.push_back(static_cast<char>(m_nodes[node].symbol));
+                        node = 0;
+                        depth = 0;
+                        allOnes = true;
+                    }
+                }
+            }
+            // 填充位必须是 EOS 的前缀（全 1）且不超过 7 位
+            return depth < 8 && allOnes;
+        }
+
+    private:
+        struct Node {
+            int next[2] = {-1, -1};
+            int symbol = -1;
+        };
+
+        std::vector<Node> m_nodes;
+
+        HuffmanTree() {
+            m_nodes.emplace_back();
+            const HuffmanCode *table = huffmanTable();
+            for (int sym = 0; sym < 257; ++sym) {
+                int node = 0;
+                for (int b = table[sym].bits - 1; b >= 0; --b) {
+                    int bit = (table[sym].code >> b) & 1;
+                    if (m_nodes[node].next[bit] < 0) {
+                        m_nodes[node].next[bit] = static_cast<int>(m_nodes.size());
+                        m_nodes.emplace_back();
+                    }
+                    node = m_nodes[node].next[bit];
+                }
+                m_nodes[node].symbol = sym;
+            }
+        }
+    };
+
+    inline size_t huffmanEncodedLength(const std::string &str) {
+        const HuffmanCode *table = huffmanTable();
+        size_t bits = 0;
+        for (unsigned char c: str) {
+            bits += table[c].bits;
+        }
+        return (bits + 7) / 8;
+    }
+
+    inline void huffmanEncode(const std::string &str, std::string &out) {
+        const HuffmanCode *table = huffmanTable();
+        uint64_t acc = 0;
+        int accBits = 0;
+        for (unsigned char c: str) {
+            acc = (acc << table[c].bits) | table[c].code;
+            accBits += table[c].bits;
+            while (accBits >= 8) {
+                accBits -= 8;
+                out.push_back(static_cast<char>((acc >> accBits) & 0xff));
+            }
+        }
+        if (accBits > 0) {
+            // 用 EOS 的高位（全 1）补齐最后一个字节
+            out.push_back(static_cast<char>(((acc << (8 - accBits)) | (0xff >> accBits)) & 0xff));
+        }
+    }
+
+    inline void encodeInteger(uint64_t value, int prefixBits, uint8_t firstByteFlags, std::string &out) {
+        uint64_t maxPrefix = (1u << prefixBits) - 1;
+        if (value < maxPrefix) {
+            out.push_back(static_cast<char>(firstByteFlags | value));
+            return;
+        }
+        out.push_back(static_cast<char>(firstByteFlags | maxPrefix));
+        value -= maxPrefix;
+        while (value >= 128) {
+            out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    inline bool decodeInteger(const uint8_t *&p, const uint8_t *end, int prefixBits, uint64_t &value) {
+        if (p >= end) {
+            return false;
+        }
+        uint64_t maxPrefix = (1u << prefixBits) - 1;
+        value = *p++ & maxPrefix;
+        if (value < maxPrefix) {
+            return true;
+        }
+        int shift = 0;
+        while (p < end) {
+            uint8_t b = *p++;
+            value += static_cast<uint64_t>(b & 0x7f) << shift;
+            if (!(b & 0x80)) {
+                return true;
+            }
+            shift += 7;
+            if (shift > 28) {
+                return false; // 超过 2^32 的整数一律拒绝
+            }
+        }
+        return false;
+    }
+
+    inline void encodeString(const std::string &str, std::string &out) {
+        size_t huffLen = huffmanEncodedLength(str);
+        if (huffLen < str.size()) {
+            encodeInteger(huffLen, 7, 0x80, out);
+            huffmanEncode(str, out);
+        } else {
+            encodeInteger(str.size(), 7, 0x00, out);
+            out += str;
+        }
+    }
+
+    inline bool decodeString(const uint8_t *&p, const uint8_t *end, std::string &out) {
+        if (p >= end) {
+            return false;
+        }
+        bool huffman = (*p & 0x80) != 0;
+        uint64_t len = 0;
+        if (!decodeInteger(p, end, 7, len) || len > static_cast<uint64_t>(end - p)) {
+            return false;
+        }
+        out.clear();
+        if (huffman) {
+            if (!HuffmanTree::instance().decode(p, len, out)) {
+                return false;
+            }
+        } else {
+            out.assign(reinterpret_cast<const char *>(p), len);
+        }
+        p += len;
+        return true;
+    }
+
+    class DynamicTable {
+    public:
+        explicit DynamicTable(size_t maxSize = 4096) : m_maxSize(maxSize) {}
+
+        void add(const Header &header) {
+            size_t entrySize = entrySizeOf(header);
+            if (entrySize > m_maxSize) {
+                m_entries.clear();
+                m_size = 0;
+                return;
+            }
+            while (m_size + entrySize > m_maxSize) {
+                evict();
+            }
+            m_entries.push_front(header);
+            m_size += entrySize;
+        }
+
+        void setMaxSize(size_t maxSize) {
+            m_maxSize = maxSize;
+            while (m_size > m_maxSize) {
+                evict();
+            }
+        }
+
+        size_t maxSize() const { return m_maxSize; }
+        size_t count() const { return m_entries.size(); }
+        const Header &at(size_t i) const { return m_entries[i]; }
+
+    private:
+        std::deque<Header> m_entries;
+        size_t m_size = 0;
+        size_t m_maxSize;
+
+        static size_t entrySizeOf(const Header &header) { return header.first.size() + header.second.size() + 32; }
+
+        void evict() {
+            m_size -= entrySizeOf(m_entries.back());
+            m_entries.pop_back();
+        }
+    };
+
+    class Decoder {
+    public:
+        // maxTableSize 即我们在 SETTINGS_HEADER_TABLE_SIZE 中通告的上限
+        explicit Decoder(size_t maxTableSize = 4096) : m_table(maxTableSize), m_settingsMaxSize(maxTableSize) {}
+
+        // maxListSize 为解码后头部列表的上限，按 RFC 7541 的口径每项计名、值长度加 32 字节；
+        // 小的头部块可以反复引用动态表中的大条目，必须按解码结果而不是输入长度限制。超出时返回 false
+        bool decode(const uint8_t *data, size_t len, HeaderList &out, size_t maxListSize = SIZE_MAX) {
+            const uint8_t *p = data;
+            const uint8_t *end = data + len;
+            bool headerSeen = false;
+            size_t listSize = 0;
+            auto fits = [&listSize, maxListSize](const Header &header) {
+                listSize += header.first.size() + header.second.size() + 32;
+                return listSize <= maxListSize;
+            };
+            while (p < end) {
+                uint8_t b = *p;
+                if (b & 0x80) {
+                    uint64_t index = 0;
+                    Header header;
+                    if (!decodeInteger(p, end, 7, index) || !lookup(index, header) || !fits(header)) {
+                        return false;
+                    }
+                    out.push_back(std::move(header));
+                    headerSeen = true;
+                } else if ((b & 0xe0) == 0x20) {
+                    // 动态表大小更新只能出现在头部块开头
+                    uint64_t size = 0;
+                    if (headerSeen || !decodeInteger(p, end, 5, size) || size > m_settingsMaxSize) {
+                        return false;
+                    }
+                    m_table.setMaxSize(size);
+                } else {
+                    bool incremental = (b & 0xc0) == 0x40;
+                    int prefix = incremental ? 6 : 4;
+                    uint64_t index = 0;
+                    Header header;
+                    if (!decodeInteger(p, end, prefix, index)) {
+                        return false;
+                    }
+                    if (index == 0) {
+                        if (!decodeString(p, end, header.first)) {
+                            return false;
+                        }
+                    } else {
+                        Header named;
+                        if (!lookup(index, named)) {
+                            return false;
+                        }
+                        header.first = std::move(named.first);
+                    }
+                    if (!decodeString(p, end, header.second) || !fits(header)) {
+                        return false;
+                    }
+                    if (incremental) {
+                        m_table.add(header);
+                    }
+                    out.push_back(std::move(header));
+                    headerSeen = true;
+                }
+            }
+            return true;
+        }
+
+    private:
+        DynamicTable m_table;
+        size_t m_settingsMaxSize;
+
+        bool lookup(uint64_t index, Header &out) const {
+            const auto &st = staticTable();
+            if (index == 0) {
+                return false;
+            }
+            if (index <= st.size()) {
+                out = st[index - 1];
+                return true;
+            }
+            index -= st.size() + 1;
+            if (index >= m_table.count()) {
+                return false;
+            }
+            out = m_table.at(index);
+            return true;
+        }
+    };
+
+    class Encoder {
+    public:
+        // 对端通过 SETTINGS_HEADER_TABLE_SIZE 调整上限时调用，下一次编码时先发出表大小更新
+        void setMaxTableSize(size_t maxSize) {
+            size_t size = std::min<size_t>(maxSize, 4096);
+            if (size != m_table.maxSize()) {
+                m_table.setMaxSize(size);
+                m_pendingSizeUpdate = true;
+            }
+        }
+
+        void encode(const HeaderList &headers, std::string &out) {
+            if (m_pendingSizeUpdate) {
+                encodeInteger(m_table.maxSize(), 5, 0x20, out);
+                m_pendingSizeUpdate = false;
+            }
+            for (const auto &header: headers) {
+                size_t nameIndex = 0;
+                size_t fullIndex = find(header, nameIndex);
+                if (fullIndex) {
+                    encodeInteger(fullIndex, 7, 0x80, out);
+                    continue;
+                }
+                bool index = shouldIndex(header.first);
+                if (index) {
+                    encodeInteger(nameIndex, 6, 0x40, out);
+                } else {
+                    encodeInteger(nameIndex, 4, 0x00, out);
+                }
+                if (!nameIndex) {
+                    encodeString(header.first, out);
+                }
+                encodeString(header.second, out);
+                if (index) {
+                    m_table.add(header);
+                }
+            }
+        }
+
+    private:
+        DynamicTable m_table;
+        bool m_pendingSizeUpdate = false;
+
+        // 每次响应都不同的值不进入动态表，避免把常用条目挤出去
+        static bool shouldIndex(const std::string &name) {
+            return name != "content-length" && name != "set-cookie" && name != "date" && name != "etag" &&
+                   name != "last-modified" && name != ":path";
+        }
+
+        size_t find(const Header &header, size_t &nameIndex) const {
+            const auto &st = staticTable();
+            nameIndex = 0;
+            for (size_t i = 0; i < st.size(); ++i) {
+                if (st[i].first == header.first) {
+                    if (st[i].second == header.second) {
+                        return i + 1;
+                    }
+                    if (!nameIndex) {
+                        nameIndex = i + 1;
+                    }
+                }
+            }
+            for (size_t i = 0; i < m_table.count(); ++i) {
+                const Header &entry = m_table.at(i);
+                if (entry.first == header.first) {
+                    if (entry.second == header.second) {
+                        return st.size() + 1 + i;
+                    }
+                    if (!nameIndex) {
+                        nameIndex = st.size() + 1 + i;
+                    }
+                }
+            }
+            return 0;
+        }
+    };
+
+} // namespace hpack
@@ -0,0 +1,997 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <spdlog/spdlog.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "accesslog.hpp"
+#include "arena.hpp"
+#include "hpack.hpp"
+#include "metrics.hpp"
+#include "server.hpp"
+
+// HTTP/2 (RFC 7540) 连接：由 ALPN 协商出 h2 后接管 TLS 连接，
+// 在一条连接上多路复用多个流，请求仍交给 HttpCallback 分发
+class Http2Connection {
+public:
+    // 把任务交给其他线程执行，无法接受时返回 false，由调用方就地执行
+    using Executor = std::function<bool(std::function<void()>)>;
+
+    Http2Connection(Socket::ptr sock, HttpCallback handle) : m_sock(sock), m_handle(handle) {}
+
+    ~Http2Connection() {
+        if (m_wakeFd >= 0) {
+            ::close(m_wakeFd);
+        }
+    }
+
+    Http2Connection(const Http2Connection &) = delete;
+    Http2Connection &operator=(const Http2Connection &) = delete;
+
+    // 设置后处理器在执行器上运行，帧循环继续收发其他流；未设置时在帧循环中同步执行
+    void setExecutor(Executor executor) {
+        m_wakeFd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (m_wakeFd < 0) {
+            spdlog::warn("[Http2] eventfd failed, handlers run inline: {}", strerror(errno));
+            return;
+        }
+        m_executor = std::move(executor);
+    }
+
+    // 阻塞等待对端帧前 waiting 为 true、收到帧后为 false，供上层设置空闲超时；
+    // quiescent 表示当前没有未完成的流，此时断开连接不会丢失请求
+    void setIdleCallback(std::function<void(bool waiting, bool quiescent)> cb) { m_onIdle = cb; }
+
+    void serve() {
+        if (!readPreface()) {
+            spdlog::warn("[Http2] Invalid connection preface");
+            return;
+        }
+        sendSettings();
+
+        while (m_running) {
+            collectResponses();
+            flushStreams();
+            // 本轮的控制帧、HEADERS 与 DATA 合并为一次写出，不让 Nagle 与延迟确认拖住后面的帧
+            if (!flushOutput()) {
+                break;
+            }
+            // 处理器运行期间不算空闲，慢处理器不会被空闲超时断开
+            bool handling = !m_activeJobs.empty() || !m_queuedJobs.empty();
+            if (m_onIdle) {
+                m_onIdle(!handling, !handling && m_streams.empty() && !m_continuationStream && m_in.empty());
+            }
+            Event event = m_in.empty() ? waitEvent() : Event::Input;
+            bool ok = event != Event::Closed;
+            Frame frame;
+            if (event == Event::Input) {
+                ok = readFrame(frame);
+            }
+            if (m_onIdle) {
+                m_onIdle(false, false);
+            }
+            if (!ok) {
+                break;
+            }
+            if (event == Event::Input) {
+                processFrame(frame);
+            }
+        }
+        // 协议错误时的 GOAWAY 也要送出
+        flushOutput();
+        // 工作线程上的处理器仍引用本连接，等它们结束；尚未开始的直接丢弃
+        abandonJobs();
+        SPDLOG_DEBUG("[Http2] Connection closed, {} streams served", m_requestCount);
+    }
+
+    // 过载时拒绝整条连接：发出 SETTINGS 后立即 GOAWAY，没有处理任何流，客户端可以换连接安全重试
+    void refuse() {
+        sendSettings();
+        std::string payload;
+        appendUint32(payload, 0);
+        appendUint32(payload, NO_ERROR);
+        writeFrame(GOAWAY, 0, 0, payload);
+        flushOutput();
+    }
+
+private:
+    enum FrameType : uint8_t {
+        DATA = 0x0,
+        HEADERS = 0x1,
+        PRIORITY = 0x2,
+        RST_STREAM = 0x3,
+        SETTINGS = 0x4,
+        PUSH_PROMISE = 0x5,
+        PING = 0x6,
+        GOAWAY = 0x7,
+        WINDOW_UPDATE = 0x8,
+        CONTINUATION = 0x9,
+    };
+
+    enum Flag : uint8_t {
+        FLAG_END_STREAM = 0x1,
+        FLAG_ACK = 0x1,
+        FLAG_END_HEADERS = 0x4,
+        FLAG_PADDED = 0x8,
+        FLAG_PRIORITY = 0x20,
+    };
+
+    enum ErrorCode : uint32_t {
+        NO_ERROR = 0x0,
+        PROTOCOL_ERROR = 0x1,
+        INTERNAL_ERROR = 0x2,
+        FLOW_CONTROL_ERROR = 0x3,
+        STREAM_CLOSED = 0x5,
+        FRAME_SIZE_ERROR = 0x6,
+        REFUSED_STREAM = 0x7,
+        CANCEL = 0x8,
+        COMPRESSION_ERROR = 0x9,
+        ENHANCE_YOUR_CALM = 0xb,
+    };
+
+    enum Setting : uint16_t {
+        SETTINGS_HEADER_TABLE_SIZE = 0x1,
+        SETTINGS_ENABLE_PUSH = 0x2,
+        SETTINGS_MAX_CONCURRENT_STREAMS = 0x3,
+        SETTINGS_INITIAL_WINDOW_SIZE = 0x4,
+        SETTINGS_MAX_FRAME_SIZE = 0x5,
+        SETTINGS_MAX_HEADER_LIST_SIZE = 0x6,
+    };
+
+    static constexpr uint32_t kMaxConcurrentStreams = 100;
+    static constexpr int64_t kDefaultWindow = 65535;
+    static constexpr int64_t kMaxWindow = 0x7fffffff;
+    // 通告给对端的流接收窗口，上传大文件时减少 WINDOW_UPDATE 往返
+    static constexpr uint32_t kLocalWindow = 1 << 20;
+    // 单个流的请求体上限，超出时重置该流
+    static constexpr size_t kMaxRequestBody = 16 * 1024 * 1024;
+    // 连接接收窗口：已缓冲、尚未交给处理器的请求体总量以此为限，只在请求体被取走或丢弃后才补足。
+    // 比单流上限多一个流窗口，单个超限的流先被重置，而不是卡在连接窗口上
+    static constexpr uint32_t kConnectionWindow = kMaxRequestBody + kLocalWindow;
+    static constexpr uint32_t kDefaultFrameSize = 16384;
+    static constexpr uint32_t kMaxFrameSize = 16777215;
+    // 头部列表上限，与 HTTP/1.1 的头部上限一致；尚未解码的头部块（HEADERS + CONTINUATION）同样以此为限
+    static constexpr uint32_t kMaxHeaderListSize = 64 * 1024;
+    // 发送缓冲区取池中最大的一档，一轮产生的帧攒满或轮到等待对端时才写出
+    static constexpr size_t kOutputBufferSize = 64 * 1024;
+    // 单条连接同时交给执行器的处理器数，其余排队，避免一条连接占满线程池
+    static constexpr size_t kMaxParallelHandlers = 8;
+    // 交给执行器的处理器超过这么久仍未开始（线程池已满），由帧循环自己执行
+    static constexpr int kInlineDelayMs = 5;
+
+    enum class Event { Input, Completion, Closed };
+
+    struct Frame {
+        uint32_t length = 0;
+        uint8_t type = 0;
+        uint8_t flags = 0;
+        uint32_t streamId = 0;
+        // 与接收缓冲区共享内存，不复制
+        IoSlice payload;
+    };
+
+    struct Stream {
+        uint32_t id = 0;
+        hpack::HeaderList headers;
+        std::string body;
+        // 请求体占用、尚未归还给对端的连接窗口（含填充）
+        size_t buffered = 0;
+        bool remoteClosed = false;
+        bool responded = false;
+        int64_t sendWindow = kDefaultWindow;
+        // 优先级：依赖的父流与权重（1~256）
+        uint32_t dependency = 0;
+        int weight = 16;
+        uint64_t vtime = 0;
+        std::string pending;
+        size_t pendingOffset = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    };
+
+    // 一次处理器调用：请求、响应及其分配区，由执行该调用的线程独占
+    struct Job {
+        explicit Job(const Socket::ptr &sock) : request(arena.resource()), response(sock, arena.resource()) {}
+
+        uint32_t streamId = 0;
+        std::chrono::steady_clock::time_point start;
+        RequestArena arena;
+        HttpRequest request;
+        HttpResponse response;
+        // 工作线程与帧循环竞争执行权，先置位者执行
+        std::atomic<bool> claimed{false};
+        // 已执行完或被放弃，受 m_jobMutex 保护
+        bool finished = false;
+    };
+
+    Socket::ptr m_sock;
+    HttpCallback m_handle;
+    Executor m_executor;
+    std::function<void(bool, bool)> m_onIdle;
+    bool m_running = true;
+    size_t m_requestCount = 0;
+
+    RecvBuffer m_in;
+    // 待写出的帧，写出后缓冲区归还池中，空闲连接不持有
+    IoBuffer m_out;
+    size_t m_outSize = 0;
+
+    hpack::Decoder m_decoder;
+    hpack::Encoder m_encoder;
+
+    // 已交给执行器、尚未取回结果的处理器，以及等待空位的处理器；只在帧循环线程访问
+    std::vector<std::shared_ptr<Job>> m_activeJobs;
+    std::deque<std::shared_ptr<Job>> m_queuedJobs;
+    // 执行完的处理器，工作线程放入后通过 eventfd 唤醒帧循环
+    std::mutex m_jobMutex;
+    std::condition_variable m_jobDone;
+    std::vector<std::shared_ptr<Job>> m_completedJobs;
+    int m_wakeFd = -1;
+
+    std::map<uint32_t, Stream> m_streams;
+    uint32_t m_lastStreamId = 0;
+
+    // 正在接收的头部块（HEADERS + CONTINUATION）
+    uint32_t m_continuationStream = 0;
+    uint8_t m_continuationFlags = 0;
+    std::string m_headerBlock;
+
+    // 流量控制：发送窗口由对端决定，接收窗口按消费量立即补足
+    int64_t m_connSendWindow = kDefaultWindow;
+    // 我们的连接接收窗口，不遵守流量控制的对端按连接错误处理，缓冲量才真正有上限
+    int64_t m_connRecvWindow = kDefaultWindow;
+    int64_t m_peerInitialWindow = kDefaultWindow;
+    uint32_t m_peerMaxFrameSize = kDefaultFrameSize;
+    uint64_t m_vtime = 0;
+
+    // 同时等待对端数据与处理器完成；执行器迟迟不开始的处理器改由本线程执行
+    Event waitEvent() {
+        if (m_wakeFd < 0) {
+            return m_sock->waitReadable(-1) ? Event::Input : Event::Closed;
+        }
+        bool unclaimed = std::any_of(m_activeJobs.begin(), m_activeJobs.end(),
+                                     [](const auto &job) { return !job->claimed.load(); });
+        bool woken = false;
+        if (!m_sock->waitReadable(unclaimed ? kInlineDelayMs : -1, m_wakeFd, woken)) {
+            if (!unclaimed) {
+                return Event::Closed;
+            }
+            for (const auto &job: m_activeJobs) {
+                if (!job->claimed.exchange(true)) {
+                    runJob(job);
+                }
+            }
+            return Event::Completion;
+        }
+        if (woken) {
+            uint64_t count;
+            [[maybe_unused]] ssize_t n = ::read(m_wakeFd, &count, sizeof(count));
+            return Event::Completion;
+        }
+        return Event::Input;
+    }
+
+    bool fill(size_t need) {
+        while (m_in.size() < need) {
+            // 空闲时先等到数据到达再从池中借用接收缓冲区
+            if (m_in.empty() && !m_sock->waitReadable(-1)) {
+                return false;
+            }
+            m_in.reserve(need);
+            size_t received = 0;
+            if (!m_sock->recv(m_in, &received) || received == 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool readPreface() {
+        static const std::string preface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+        if (!fill(preface.size()) || m_in.view().substr(0, preface.size()) != preface) {
+            return false;
+        }
+        m_in.consume(preface.size());
+        return true;
+    }
+
+    bool readFrame(Frame &frame) {
+        if (!fill(9)) {
+            return false;
+        }
+        const auto *h = reinterpret_cast<const uint8_t *>(m_in.view().data());
+        frame.length = (h[0] << 16) | (h[1] << 8) | h[2];
+        frame.type = h[3];
+        frame.flags = h[4];
+        frame.streamId = readUint32(h + 5) & 0x7fffffff;
+        if (frame.length > kDefaultFrameSize) {
+            // 我们未通告更大的 SETTINGS_MAX_FRAME_SIZE
+            goAway(FRAME_SIZE_ERROR);
+            return false;
+        }
+        if (!fill(9 + frame.length)) {
+            return false;
+        }
+        frame.payload = m_in.slice(9, frame.length);
+        m_in.consume(9 + frame.length);
+        return true;
+    }
+
+    static uint32_t readUint32(const uint8_t *p) {
+        return (static_cast<uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+    }
+
+    static void appendUint32(std::string &out, uint32_t v) {
+        out.push_back(static_cast<char>(v >> 24));
+        out.push_back(static_cast<char>(v >> 16));
+        out.push_back(static_cast<char>(v >> 8));
+        out.push_back(static_cast<char>(v));
+    }
+
+    // 帧头与负载追加到发送缓冲区，放不下时先写出已有内容；超过缓冲区大小的帧单独占一块
+    bool writeFrame(uint8_t type, uint8_t flags, uint32_t streamId, const char *payload, size_t length) {
+        size_t size = 9 + length;
+        if (m_outSize + size > m_out.capacity() && !flushOutput()) {
+            return false;
+        }
+        if (!m_out) {
+            m_out = IoBuffer(std::max(size, kOutputBufferSize));
+        }
+        char *frame = m_out.data() + m_outSize;
+        auto *h = reinterpret_cast<uint8_t *>(frame);
+        h[0] = static_cast<uint8_t>(length >> 16);
+        h[1] = static_cast<uint8_t>(length >> 8);
+        h[2] = static_cast<uint8_t>(length);
+        h[3] = type;
+        h[4] = flags;
+        for (int i = 0; i < 4; ++i) {
+            h[5 + i] = static_cast<uint8_t>((streamId & 0x7fffffff) >> (24 - 8 * i));
+        }
+        if (length > 0) {
+            std::memcpy(frame + 9, payload, length);
+        }
+        m_outSize += size;
+        return true;
+    }
+
+    bool flushOutput() {
+        if (m_outSize == 0) {
+            return true;
+        }
+        bool ok = m_sock->send(m_out.data(), m_outSize);
+        m_outSize = 0;
+        m_out.reset();
+        if (!ok) {
+            m_running = false;
+        }
+        return ok;
+    }
+
+    bool writeFrame(uint8_t type, uint8_t flags, uint32_t streamId, std::string_view payload) {
+        return writeFrame(type, flags, streamId, payload.data(), payload.size());
+    }
+
+    void sendSettings() {
+        std::string payload;
+        auto add = [&payload](uint16_t id, uint32_t value) {
+            payload.push_back(static_cast<char>(id >> 8));
+            payload.push_back(static_cast<char>(id));
+            appendUint32(payload, value);
+        };
+        add(SETTINGS_MAX_CONCURRENT_STREAMS, kMaxConcurrentStreams);
+        add(SETTINGS_INITIAL_WINDOW_SIZE, kLocalWindow);
+        add(SETTINGS_MAX_HEADER_LIST_SIZE, kMaxHeaderListSize);
+        writeFrame(SETTINGS, 0, 0, payload);
+        sendWindowUpdate(0, kConnectionWindow - kDefaultWindow);
+    }
+
+    void goAway(ErrorCode error) {
+        std::string payload;
+        appendUint32(payload, m_lastStreamId);
+        appendUint32(payload, error);
+        writeFrame(GOAWAY, 0, 0, payload);
+        m_running = false;
+        if (error != NO_ERROR) {
+            spdlog::warn("[Http2] GOAWAY sent, error code {}", static_cast<uint32_t>(error));
+        }
+    }
+
+    void resetStream(uint32_t streamId, ErrorCode error) {
+        std::string payload;
+        appendUint32(payload, error);
+        writeFrame(RST_STREAM, 0, streamId, payload);
+        eraseStream(streamId);
+    }
+
+    // 请求体不再占用内存后，把它占用的连接窗口还给对端
+    void releaseBody(Stream &stream) {
+        if (stream.buffered > 0) {
+            sendWindowUpdate(0, static_cast<uint32_t>(stream.buffered));
+            stream.buffered = 0;
+        }
+        std::string().swap(stream.body);
+    }
+
+    void eraseStream(uint32_t streamId) {
+        auto it = m_streams.find(streamId);
+        if (it != m_streams.end()) {
+            releaseBody(it->second);
+            m_streams.erase(it);
+        }
+    }
+
+    void sendWindowUpdate(uint32_t streamId, uint32_t increment) {
+        std::string payload;
+        appendUint32(payload, increment);
+        writeFrame(WINDOW_UPDATE, 0, streamId, payload);
+        if (streamId == 0) {
+            m_connRecvWindow += increment;
+        }
+    }
+
+    // 去掉 PADDED 填充，失败时返回 false
+    bool stripPadding(Frame &frame, size_t prefix = 0) {
+        if (!(frame.flags & FLAG_PADDED)) {
+            return true;
+        }
+        if (frame.payload.empty()) {
+            return false;
+        }
+        size_t padLength = static_cast<uint8_t>(frame.payload[0]);
+        if (padLength + 1 + prefix > frame.payload.size()) {
+            return false;
+        }
+        frame.payload = frame.payload.substr(1, frame.payload.size() - 1 - padLength);
+        return true;
+    }
+
+    void processFrame(Frame &frame) {
+        if (m_continuationStream && (frame.type != CONTINUATION || frame.streamId != m_continuationStream)) {
+            goAway(PROTOCOL_ERROR);
+            return;
+        }
+
+        switch (frame.type) {
+            case DATA:
+                onData(frame);
+                break;
+            case HEADERS:
+                onHeaders(frame);
+                break;
+            case PRIORITY:
+                if (frame.streamId == 0 || frame.payload.size() != 5) {
+                    goAway(PROTOCOL_ERROR);
+                    return;
+                }
+                applyPriority(frame.streamId, reinterpret_cast<const uint8_t *>(frame.payload.data()));
+                break;
+            case RST_STREAM:
+                if (frame.streamId == 0 || frame.payload.size() != 4) {
+                    goAway(PROTOCOL_ERROR);
+                    return;
+                }
+                eraseStream(frame.streamId);
+                break;
+            case SETTINGS:
+                onSettings(frame);
+                break;
+            case PUSH_PROMISE:
+                // 客户端不允许发送 PUSH_PROMISE
+                goAway(PROTOCOL_ERROR);
+                break;
+            case PING:
+                if (frame.streamId != 0 || frame.payload.size() != 8) {
+                    goAway(PROTOCOL_ERROR);
+                    return;
+                }
+                if (!(frame.flags & FLAG_ACK)) {
+                    writeFrame(PING, FLAG_ACK, 0, frame.payload);
+                }
+                break;
+            case GOAWAY:
+                m_running = false;
+                break;
+            case WINDOW_UPDATE:
+                onWindowUpdate(frame);
+                break;
+            case CONTINUATION:
+                if (!m_continuationStream) {
+                    goAway(PROTOCOL_ERROR);
+                    return;
+                }
+                // 无休止的 CONTINUATION 不能让头部块无限增长
+                if (m_headerBlock.size() + frame.payload.size() > kMaxHeaderListSize) {
+                    goAway(ENHANCE_YOUR_CALM);
+                    return;
+                }
+                m_headerBlock += frame.payload;
+                if (frame.flags & FLAG_END_HEADERS) {
+                    uint32_t streamId = m_continuationStream;
+                    m_continuationStream = 0;
+                    onHeaderBlock(streamId, m_continuationFlags);
+                }
+                break;
+            default:
+                // 未知帧类型直接忽略
+                break;
+        }
+    }
+
+    void onSettings(const Frame &frame) {
+        if (frame.streamId != 0) {
+            goAway(PROTOCOL_ERROR);
+            return;
+        }
+        if (frame.flags & FLAG_ACK) {
+            return;
+        }
+        if (frame.payload.size() % 6 != 0) {
+            goAway(FRAME_SIZE_ERROR);
+            return;
+        }
+        const auto *p = reinterpret_cast<const uint8_t *>(frame.payload.data());
+        for (size_t i = 0; i < frame.payload.size(); i += 6) {
+            uint16_t id = (p[i] << 8) | p[i + 1];
+            uint32_t value = readUint32(p + i + 2);
+            switch (id) {
+                case SETTINGS_HEADER_TABLE_SIZE:
+                    m_encoder.setMaxTableSize(value);
+                    break;
+                case SETTINGS_INITIAL_WINDOW_SIZE: {
+                    if (value > kMaxWindow) {
+                        goAway(FLOW_CONTROL_ERROR);
+                        return;
+                    }
+                    // 新初始窗口对所有已打开的流生效
+                    int64_t delta = static_cast<int64_t>(value) - m_peerInitialWindow;
+                    m_peerInitialWindow = value;
+                    for (auto &entry: m_streams) {
+                        entry.second.sendWindow += delta;
+                    }
+                    break;
+                }
+                case SETTINGS_MAX_FRAME_SIZE:
+                    if (value < kDefaultFrameSize || value > kMaxFrameSize) {
+                        goAway(PROTOCOL_ERROR);
+                        return;
+                    }
+                    m_peerMaxFrameSize = value;
+                    break;
+                default:
+                    break;
+            }
+        }
+        writeFrame(SETTINGS, FLAG_ACK, 0, "", 0);
+    }
+
+    void onWindowUpdate(const Frame &frame) {
+        if (frame.payload.size() != 4) {
+            goAway(FRAME_SIZE_ERROR);
+            return;
+        }
+        uint32_t increment = readUint32(reinterpret_cast<const uint8_t *>(frame.payload.data())) & 0x7fffffff;
+        if (frame.streamId == 0) {
+            if (increment == 0 || m_connSendWindow + increment > kMaxWindow) {
+                goAway(increment == 0 ? PROTOCOL_ERROR : FLOW_CONTROL_ERROR);
+                return;
+            }
+            m_connSendWindow += increment;
+            return;
+        }
+        auto it = m_streams.find(frame.streamId);
+        if (it == m_streams.end()) {
+            return;
+        }
+        if (increment == 0) {
+            resetStream(frame.streamId, PROTOCOL_ERROR);
+        } else if (it->second.sendWindow + increment > kMaxWindow) {
+            resetStream(frame.streamId, FLOW_CONTROL_ERROR);
+        } else {
+            it->second.sendWindow += increment;
+        }
+    }
+
+    void applyPriority(uint32_t streamId, const uint8_t *p) {
+        uint32_t dependency = readUint32(p) & 0x7fffffff;
+        int weight = p[4] + 1;
+        if (dependency == streamId) {
+            resetStream(streamId, PROTOCOL_ERROR);
+            return;
+        }
+        auto it = m_streams.find(streamId);
+        if (it != m_streams.end()) {
+            it->second.dependency = dependency;
+            it->second.weight = weight;
+        }
+    }
+
+    void onHeaders(Frame &frame) {
+        uint32_t id = frame.streamId;
+        if (id == 0 || !(id & 1)) {
+            goAway(PROTOCOL_ERROR);
+            return;
+        }
+        size_t priorityLength = (frame.flags & FLAG_PRIORITY) ? 5 : 0;
+        if (!stripPadding(frame, priorityLength) || frame.payload.size() < priorityLength) {
+            goAway(PROTOCOL_ERROR);
+            return;
+        }
+
+        auto it = m_streams.find(id);
+        if (it == m_streams.end()) {
+            if (id <= m_lastStreamId) {
+                goAway(PROTOCOL_ERROR);
+                return;
+            }
+            m_lastStreamId = id;
+            Stream stream;
+            stream.id = id;
+            stream.sendWindow = m_peerInitialWindow;
+            stream.vtime = m_vtime;
+            m_streams[id] = std::move(stream);
+        } else if (it->second.remoteClosed) {
+            resetStream(id, STREAM_CLOSED);
+            return;
+        }
+
+        if (priorityLength) {
+            applyPriority(id, reinterpret_cast<const uint8_t *>(frame.payload.data()));
+        }
+
+        m_headerBlock = frame.payload.substr(priorityLength);
+        if (frame.flags & FLAG_END_HEADERS) {
+            onHeaderBlock(id, frame.flags);
+        } else {
+            m_continuationStream = id;
+            m_continuationFlags = frame.flags;
+        }
+    }
+
+    void onHeaderBlock(uint32_t streamId, uint8_t flags) {
+        hpack::HeaderList headers;
+        // 即使流已被重置，头部块也必须解码以保持 HPACK 状态一致；解码到一半放弃会破坏该状态，
+        // 所以超出头部列表上限同样是连接错误
+        if (!m_decoder.decode(reinterpret_cast<const uint8_t *>(m_headerBlock.data()), m_headerBlock.size(), headers,
+                              kMaxHeaderListSize)) {
+            goAway(COMPRESSION_ERROR);
+            return;
+        }
+        m_headerBlock.clear();
+
+        auto it = m_streams.find(streamId);
+        if (it == m_streams.end()) {
+            return;
+        }
+        if (m_streams.size() > kMaxConcurrentStreams) {
+            resetStream(streamId, REFUSED_STREAM);
+            return;
+        }
+
+        Stream &stream = it->second;
+        if (stream.headers.empty()) {
+            stream.headers = std::move(headers);
+        }
+        // 其余情况为 trailers，直接忽略内容
+        if (flags & FLAG_END_STREAM) {
+            stream.remoteClosed = true;
+            dispatch(stream);
+        }
+    }
+
+    void onData(Frame &frame) {
+        if (frame.streamId == 0) {
+            goAway(PROTOCOL_ERROR);
+            return;
+        }
+        // 整个帧（含填充）都计入流量控制。丢弃的数据立即归还连接窗口；缓冲进请求体的数据
+        // 要等请求体交给处理器或流被重置后才归还，所以缓冲总量不会超过连接窗口
+        uint32_t flowLength = frame.length;
+        if (flowLength > m_connRecvWindow) {
+            goAway(FLOW_CONTROL_ERROR);
+            return;
+        }
+        m_connRecvWindow -= flowLength;
+        if (!stripPadding(frame)) {
+            goAway(PROTOCOL_ERROR);
+            return;
+        }
+
+        auto it = m_streams.find(frame.streamId);
+        if (it == m_streams.end() || it->second.remoteClosed ||
+            it->second.body.size() + frame.payload.size() > kMaxRequestBody) {
+            if (flowLength > 0) {
+                sendWindowUpdate(0, flowLength);
+            }
+            if (it == m_streams.end()) {
+                if (frame.streamId > m_lastStreamId) {
+                    goAway(PROTOCOL_ERROR);
+                }
+            } else {
+                resetStream(frame.streamId, it->second.remoteClosed ? STREAM_CLOSED : CANCEL);
+            }
+            return;
+        }
+        Stream &stream = it->second;
+        stream.body += frame.payload;
+        stream.buffered += flowLength;
+        if (frame.flags & FLAG_END_STREAM) {
+            stream.remoteClosed = true;
+            dispatch(stream);
+        } else if (flowLength > 0) {
+            // 流窗口随缓冲补足，单个流的总量由请求体上限约束
+            sendWindowUpdate(frame.streamId, flowLength);
+        }
+    }
+
+    // 将 h2 的小写头部名转换为 HTTP/1.1 处理器使用的形式，如 accept-encoding -> Accept-Encoding
+    static std::string canonicalHeaderName(const std::string &name) {
+        std::string result = name;
+        bool upper = true;
+        for (char &c: result) {
+            if (upper) {
+                c = static_cast<char>(::toupper(static_cast<unsigned char>(c)));
+            }
+            upper = (c == '-');
+        }
+        return result;
+    }
+
+    bool buildRequest(const Stream &stream, HttpRequest &request) {
+        std::string method, path, cookie;
+        for (const auto &header: stream.headers) {
+            const std::string &name = header.first;
+            if (name == ":method") {
+                method = header.second;
+            } else if (name == ":path") {
+                path = header.second;
+            } else if (name == ":authority") {
+                request.setHeader("Host", header.second);
+            } else if (name == "cookie") {
+                // h2 允许把 Cookie 拆成多个字段，需要重新拼接
+                cookie += cookie.empty() ? header.second : "; " + header.second;
+            } else if (!name.empty() && name[0] != ':') {
+                request.setHeader(canonicalHeaderName(name), header.second);
+            }
+        }
+        if (method.empty() || path.empty()) {
+            return false;
+        }
+        if (!request.setPath(path)) {
+            return false;
+        }
+        if (!cookie.empty()) {
+            request.setHeader("Cookie", cookie);
+        }
+        request.setMethod(method);
+        request.setVersion("HTTP/2");
+        request.setHeader("Content-Length", std::to_string(stream.body.size()));
+        request.setBody(stream.body);
+        return true;
+    }
+
+    void dispatch(Stream &stream) {
+        auto job = std::make_shared<Job>(m_sock);
+        job->streamId = stream.id;
+        job->start = stream.start;
+        if (!buildRequest(stream, job->request)) {
+            resetStream(stream.id, PROTOCOL_ERROR);
+            return;
+        }
+        // 请求体已复制进请求，归还它占用的连接窗口
+        releaseBody(stream);
+
+        ++m_requestCount;
+        SPDLOG_DEBUG("[Http2] Stream {} request: {} {}", stream.id, job->request.getMethod(), job->request.getPath());
+        if (!m_executor) {
+            job->claimed = true;
+            runJob(job);
+            return;
+        }
+        m_queuedJobs.push_back(std::move(job));
+        startJobs();
+    }
+
+    void startJobs() {
+        while (!m_queuedJobs.empty() && m_activeJobs.size() < kMaxParallelHandlers) {
+            auto job = std::move(m_queuedJobs.front());
+            m_queuedJobs.pop_front();
+            m_activeJobs.push_back(job);
+            bool queued = m_executor([this, job] {
+                if (!job->claimed.exchange(true)) {
+                    runJob(job);
+                }
+            });
+            if (!queued && !job->claimed.exchange(true)) {
+                runJob(job);
+            }
+        }
+    }
+
+    // 可在工作线程上运行：只接触任务自己的请求与响应，完成后交回帧循环发送
+    void runJob(const std::shared_ptr<Job> &job) {
+        if (m_handle) {
+            m_handle(job->request, job->response);
+        } else {
+            job->response.setStatus(404, "Not Found");
+        }
+        if (job->request.getHeader("Accept-Encoding").find("gzip") != std::string::npos) {
+            job->response.setHeader("Content-Encoding", "gzip");
+        }
+        job->response.encodeBody();
+
+        std::lock_guard<std::mutex> lock(m_jobMutex);
+        job->finished = true;
+        m_completedJobs.push_back(job);
+        m_jobDone.notify_all();
+        if (m_wakeFd >= 0) {
+            uint64_t one = 1;
+            [[maybe_unused]] ssize_t n = ::write(m_wakeFd, &one, sizeof(one));
+        }
+    }
+
+    void collectResponses() {
+        std::vector<std::shared_ptr<Job>> completed;
+        {
+            std::lock_guard<std::mutex> lock(m_jobMutex);
+            completed.swap(m_completedJobs);
+        }
+        for (const auto &job: completed) {
+            std::erase(m_activeJobs, job);
+            respond(*job);
+        }
+        if (!completed.empty() && m_executor) {
+            startJobs();
+        }
+    }
+
+    // 连接结束时：未开始的处理器不再执行，已在运行的等它结束
+    void abandonJobs() {
+        m_queuedJobs.clear();
+        std::unique_lock<std::mutex> lock(m_jobMutex);
+        for (const auto &job: m_activeJobs) {
+            if (!job->claimed.exchange(true)) {
+                job->finished = true;
+            }
+        }
+        m_jobDone.wait(lock, [this] {
+            return std::all_of(m_activeJobs.begin(), m_activeJobs.end(), [](const auto &job) { return job->finished; });
+        });
+        m_activeJobs.clear();
+        m_completedJobs.clear();
+    }
+
+    void respond(Job &job) {
+        HttpResponse &response = job.response;
+        hpack::HeaderList headers;
+        headers.emplace_back(":status", std::to_string(response.getStatus()));
+        char date[HttpDate::kLength];
+        HttpDate::instance().copy(date);
+        headers.emplace_back("date", std::string(date, sizeof(date)));
+        for (const auto &header: response.getHeaders()) {
+            std::string name(header.first);
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+            // 连接级头部在 h2 中是非法的
+            if (header.second.empty() || name == "connection" || name == "transfer-encoding" || name == "keep-alive" ||
+                name == "upgrade" || name == "proxy-connection" || name == "content-length") {
+                continue;
+            }
+            headers.emplace_back(name, header.second);
+        }
+        headers.emplace_back("content-length", std::to_string(response.getBody().size()));
+        // h2 的响应体随流控分批写出，延迟记录到响应头发出为止
+        metrics::Registry::instance().observeRequest(
+                response.getRoute(), response.getStatus(),
+                std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - job.start));
+        AccessLog::instance().log(m_sock->getRemoteAddress()->toString(), job.request, response, job.start);
+
+        // 处理期间流已被对端重置
+        auto it = m_streams.find(job.streamId);
+        if (it == m_streams.end()) {
+            return;
+        }
+        Stream &stream = it->second;
+        std::string block;
+        m_encoder.encode(headers, block);
+        bool endStream = response.getBody().empty();
+        if (!sendHeaderBlock(stream.id, block, endStream)) {
+            return;
+        }
+
+        stream.responded = true;
+        if (endStream) {
+            eraseStream(stream.id);
+            return;
+        }
+        stream.pending.assign(response.getBody());
+        stream.pendingOffset = 0;
+    }
+
+    bool sendHeaderBlock(uint32_t streamId, const std::string &block, bool endStream) {
+        size_t offset = 0;
+        bool first = true;
+        do {
+            size_t length = std::min<size_t>(block.size() - offset, m_peerMaxFrameSize);
+            bool last = offset + length == block.size();
+            uint8_t flags = last ? FLAG_END_HEADERS : 0;
+            if (first && endStream) {
+                flags |= FLAG_END_STREAM;
+            }
+            if (!writeFrame(first ? HEADERS : CONTINUATION, flags, streamId, block.data() + offset, length)) {
+                return false;
+            }
+            offset += length;
+            first = false;
+        } while (offset < block.size());
+        return true;
+    }
+
+    // 依赖的父流仍有数据待发时，子流让出带宽
+    bool ancestorPending(const Stream &stream) const {
+        uint32_t parent = stream.dependency;
+        for (size_t depth = 0; parent && depth < m_streams.size(); ++depth) {
+            auto it = m_streams.find(parent);
+            if (it == m_streams.end()) {
+                return false;
+            }
+            if (it->second.pendingOffset < it->second.pending.size()) {
+                return true;
+            }
+            parent = it->second.dependency;
+        }
+        return false;
+    }
+
+    Stream *nextSendable() {
+        Stream *best = nullptr;
+        for (auto &entry: m_streams) {
+            Stream &stream = entry.second;
+            if (!stream.responded || stream.pendingOffset >= stream.pending.size() || stream.sendWindow <= 0) {
+                continue;
+            }
+            if (ancestorPending(stream)) {
+                continue;
+            }
+            if (!best || stream.vtime < best->vtime) {
+                best = &stream;
+            }
+        }
+        return best;
+    }
+
+    // 在流量控制窗口内按优先级加权轮转发送 DATA 帧，对端有新帧到达时让出以便及时处理
+    void flushStreams() {
+        while (m_running && m_connSendWindow > 0) {
+            Stream *stream = nextSendable();
+            if (!stream) {
+                return;
+            }
+            size_t remaining = stream->pending.size() - stream->pendingOffset;
+            size_t length = std::min<size_t>({remaining, m_peerMaxFrameSize, static_cast<size_t>(stream->sendWindow),
+                                              static_cast<size_t>(m_connSendWindow)});
+            bool last = length == remaining;
+            if (!writeFrame(DATA, last ? FLAG_END_STREAM : 0, stream->id, stream->pending.data() + stream->pendingOffset,
+                            length)) {
+                return;
+            }
+            stream->pendingOffset += length;
+            stream->sendWindow -= length;
+            m_connSendWindow -= length;
+            m_vtime = stream->vtime;
+            stream->vtime += length * 256 / stream->weight;
+            if (last) {
+                eraseStream(stream->id);
+            }
+            if (m_sock->waitReadable(0)) {
+                return;
+            }
+        }
+    }
+};
@@ -4,18 +4,36 @@
 #include <fstream>
 #include <sstream>
 #include <filesystem>
+#include <shared_mutex>
+#include <sys/stat.h>
 #include <unordered_map>
 #include <spdlog/spdlog.h>
+#include "metrics.hpp"
+#include "sitebundle.hpp"
+#include "sitesnapshot.hpp"
+#include "statcache.hpp"
 
 
+// 缓存的静态文件：内容与预先序列化好的 200 响应头（状态行、Content-Type、Content-Length、ETag、
+// Cache-Control），命中时整块写出，只追加逐请求的头部
+struct CachedFile {
+    std::string content;
+    std::string_view mimeType;
+    std::string etag;
+    std::string head;
+};
+
+// 以规范化后的请求路径为键。多个工作线程并发读写，读多写少，用读写锁保护
 class FileCacheManager {
 public:
-    std::optional<std::string> get(const std::string &path);
-    void put(const std::string &path, const std::string &content);
+    std::shared_ptr<const CachedFile> get(const std::string &path);
+    std::shared_ptr<const CachedFile> put(const std::string &path, std::shared_ptr<const CachedFile> file);
+    void erase(const std::string &path);
     void clear();
 
 private:
-    std::unordered_map<std::string, std::string> m_cache;
+    std::shared_mutex m_mutex;
+    std::unordered_map<std::string, std::shared_ptr<const CachedFile>> m_cache;
 };
 
 class HttpHandler {
@@ -26,7 +44,9 @@ public:
 
 class StaticFileHandler : public HttpHandler {
 public:
-    StaticFileHandler(const std::string &root, const std::string &defaultSite);
+    StaticFileHandler(const std::string &root, const std::string &defaultSite,
+                      std::chrono::milliseconds statCacheTtl = std::chrono::milliseconds(2000), bool prewarm = false,
+                      const std::string &bundle = {});
 
     std::vector<std::string> splitMultipartBody(const std::string &body, const std::string &boundary);
 
@@ -36,15 +56,27 @@ public:
 
     void handle(const HttpRequest &req, HttpResponse &res) override;
 
+    static std::string_view getMimeType(std::string_view path) { return ::getMimeType(path); }
+
 private:
+    static constexpr std::string_view kCacheControl = kStaticCacheControl;
+    // 缓存项预先序列化的头部
+    static constexpr std::string_view kPreparedHeaders[] = {"Content-Type", "ETag", "Cache-Control"};
+
+    static std::shared_ptr<CachedFile> loadFile(const std::string &fullPath, std::string content, int64_t mtime);
+
     std::string m_rootPath;
     std::string m_defaultSite;
     std::shared_ptr<FileCacheManager> m_cache;
-    std::string getMimeType(const std::string &path);
+    std::shared_ptr<SiteSnapshotStore> m_snapshots;
+    // 打包文件只读且不随站点目录变化，部署新版本后重启或平滑重载生效
+    std::shared_ptr<const SiteBundle> m_bundle;
+    std::unique_ptr<StatCache> m_stat;
 };
 
 
-StaticFileHandler::StaticFileHandler(const std::string &root, const std::string &defaultSite) :
+StaticFileHandler::StaticFileHandler(const std::string &root, const std::string &defaultSite,
+                                     std::chrono::milliseconds statCacheTtl, bool prewarm, const std::string &bundle) :
     m_rootPath(root), m_cache(std::make_shared<FileCacheManager>()) {
     if (defaultSite.empty() || defaultSite == "/") {
         m_defaultSite = "/index.html";
@@ -58,28 +90,79 @@ StaticFileHandler::StaticFileHandler(const std::string &root, const std::string
     if (!m_rootPath.empty() && m_rootPath.back() == '/') {
         m_rootPath.pop_back();
     }
+    if (!bundle.empty()) {
+        m_bundle = SiteBundle::open(bundle);
+        if (m_bundle) {
+            spdlog::info("[StaticFileHandler] Serving {} file(s) from bundle {}", m_bundle->fileCount(), bundle);
+        } else {
+            spdlog::warn("[StaticFileHandler] Bundle {} unusable, serving from {}", bundle, m_rootPath);
+        }
+    }
+    if (m_bundle && prewarm) {
+        spdlog::warn("[StaticFileHandler] Bundle in use, ignoring site.prewarm");
+    } else if (prewarm) {
+        m_snapshots = std::make_shared<SiteSnapshotStore>(m_rootPath, std::string(kCacheControl));
+    }
+    // 文件变化时内容缓存随元数据一起失效，快照立即丢弃并在后台重建
+    m_stat = std::make_unique<StatCache>(m_rootPath, statCacheTtl,
+                                         [cache = m_cache, snapshots = m_snapshots](const std::string &path) {
+                                             if (path.empty()) {
+                                                 cache->clear();
+                                             } else {
+                                                 cache->erase(path);
+                                             }
+                                             if (snapshots) {
+                                                 snapshots->invalidate();
+                                             }
+                                         });
 }
 
 void StaticFileHandler::handle(const HttpRequest &req, HttpResponse &res) {
-    spdlog::info("[StaticFileHandler] Handling request: {} {}", req.getMethod(), req.getPath());
+    SPDLOG_DEBUG("[StaticFileHandler] Handling request: {} {}", req.getMethod(), req.getPath());
 
     if (req.getMethod() != "GET" && req.getMethod() != "HEAD") {
-        spdlog::info("[StaticFileHandler] Method not allowed: {}", req.getMethod());
+        SPDLOG_DEBUG("[StaticFileHandler] Method not allowed: {}", req.getMethod());
         res.setStatus(405, "Method Not Allowed");
         res.setHeader("Content-Type", "text/plain");
         res.setBody("Method Not Allowed");
         return;
     }
 
-    // 计算请求的文件路径
-    std::string relPath = req.getPath() == "/" ? m_defaultSite : req.getPath();
+    // 计算请求的文件路径。请求路径在解析时已规范化，不会越过根目录，等价的写法得到同一个缓存键
+    std::string_view path = req.getPath().substr(0, req.getPath().find('?'));
+    std::string relPath = path == "/" ? m_defaultSite : std::string(path);
     std::string fullPath = m_rootPath + relPath;
 
-    spdlog::info("[StaticFileHandler] Requested file path: {}", fullPath);
+    SPDLOG_DEBUG("[StaticFileHandler] Requested file path: {}", fullPath);
 
-    // 检查文件是否存在
-    if (!std::filesystem::exists(fullPath) || std::filesystem::is_directory(fullPath)) {
-        spdlog::warn("[StaticFileHandler] File not found or it's a directory: {}", fullPath);
+    // 打包文件或预热快照命中时响应体与头部都直接引用索引，不访问文件系统也不复制；
+    // 快照过期或未收录该路径时走下面的逐文件缓存
+    std::shared_ptr<const SiteIndex> index = m_bundle;
+    if (!index && m_snapshots) {
+        index = m_snapshots->current();
+    }
+    if (index) {
+        if (auto file = index->find(relPath)) {
+            res.m_path = fullPath;
+            res.setStatus(200, "OK");
+            res.setHeader("Content-Type", file->mimeType);
+            res.setHeader("ETag", file->etag);
+            res.setHeader("Cache-Control", kCacheControl);
+            if (req.getMethod() != "HEAD") {
+                res.setSharedBody(index, file->content, file->gzip);
+            }
+            res.setPreparedHead(index, file->head, kPreparedHeaders);
+            return;
+        }
+    }
+
+    // 检查文件是否存在，结果来自元数据缓存，命中时不访问文件系统
+    StatCache::Entry meta;
+    if (relPath.starts_with('/')) {
+        meta = m_stat->lookup(relPath);
+    }
+    if (meta.kind != StatCache::Kind::File) {
+        SPDLOG_DEBUG("[StaticFileHandler] File not found or it's a directory: {}", fullPath);
         res.setStatus(404, "Not Found");
         res.setHeader("Content-Type", "text/plain");
         res.setBody("File not found");
@@ -87,15 +170,13 @@ void StaticFileHandler::handle(const HttpRequest &req, HttpResponse &res) {
     }
 
     // 尝试获取缓存
-    std::optional<std::string> cached = m_cache->get(fullPath);
-    std::string content;
+    std::shared_ptr<const CachedFile> file = m_cache->get(relPath);
     res.m_path = fullPath;
 
-    if (cached) {
-        spdlog::info("[StaticFileHandler] File found in cache: {}", fullPath);
-        content = *cached;
+    if (file) {
+        SPDLOG_DEBUG("[StaticFileHandler] File found in cache: {}", fullPath);
     } else {
-        spdlog::info("[StaticFileHandler] File not in cache, reading from disk: {}", fullPath);
+        SPDLOG_DEBUG("[StaticFileHandler] File not in cache, reading from disk: {}", fullPath);
 
         // 读取文件内容
         std::ifstream ifs(fullPath, std::ios::binary);
@@ -108,49 +189,72 @@ void StaticFileHandler::handle(const HttpRequest &req, HttpResponse &res) {
 
         std::ostringstream oss;
         oss << ifs.rdbuf();
-        content = oss.str();
 
         // 缓存文件内容
-        m_cache->put(fullPath, content);
-        spdlog::info("[StaticFileHandler] File read from disk and cached: {}", fullPath);
+        file = m_cache->put(relPath, loadFile(fullPath, std::move(oss).str(), meta.mtime));
+        SPDLOG_DEBUG("[StaticFileHandler] File read from disk and cached: {}", fullPath);
     }
 
     // 设置响应
     res.setStatus(200, "OK");
-    res.setHeader("Content-Type", getMimeType(fullPath));
-    // res.setHeader("Content-Length", std::to_string(content.size()));
+    res.setHeader("Content-Type", file->mimeType);
+    res.setHeader("ETag", file->etag);
+    res.setHeader("Cache-Control", kCacheControl);
 
     if (req.getMethod() != "HEAD") {
-        spdlog::info("[StaticFileHandler] Setting response body.");
-        res.setBody(content);
+        SPDLOG_DEBUG("[StaticFileHandler] Setting response body.");
+        res.setBody(file->content);
     } else {
-        spdlog::info("[StaticFileHandler] HEAD request, no response body set.");
+        SPDLOG_DEBUG("[StaticFileHandler] HEAD request, no response body set.");
     }
+    // 与缓存项共享所有权，不复制头部
+    res.setPreparedHead(file, file->head, kPreparedHeaders);
 }
 
-std::string StaticFileHandler::getMimeType(const std::string &path) {
-    static const std::unordered_map<std::string, std::string> mimeTypes = {
-            {".html", "text/html"}, {".htm", "text/html"}, {".css", "text/css"},
-            {".js", "application/javascript"}, {".png", "image/png"}, {".jpg", "image/jpeg"},
-            {".jpeg", "image/jpeg"}, {".gif", "image/gif"}, {".ico", "image/x-icon"},
-            {".svg", "image/svg+xml"}, {".json", "application/json"}, {".txt", "text/plain"}
-    };
-
-    std::filesystem::path ext = std::filesystem::path(path).extension();
-    auto it = mimeTypes.find(ext.string());
-    return it != mimeTypes.end() ? it->second : "application/octet-stream";
+std::shared_ptr<CachedFile> StaticFileHandler::loadFile(const std::string &fullPath, std::string content, int64_t mtime) {
+    auto file = std::make_shared<CachedFile>();
+    file->content = std::move(content);
+    file->mimeType = getMimeType(fullPath);
+    file->etag = formatFileEtag(mtime, file->content.size());
+    file->head = formatFileHead(file->mimeType, file->content.size(), file->etag, kCacheControl);
+    return file;
 }
 
-std::optional<std::string> FileCacheManager::get(const std::string &path) {
+std::shared_ptr<const CachedFile> FileCacheManager::get(const std::string &path) {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
     auto it = m_cache.find(path);
-    return it != m_cache.end() ? std::optional(it->second) : std::nullopt;
+    if (it == m_cache.end()) {
+        metrics::Registry::instance().fileCacheMisses.inc();
+        return nullptr;
+    }
+    metrics::Registry::instance().fileCacheHits.inc();
+    return it->second;
 }
 
-void FileCacheManager::put(const std::string &path, const std::string &content) {
-    m_cache[path] = content;
+// 返回实际缓存的项：并发未命中时以先写入的为准
+std::shared_ptr<const CachedFile> FileCacheManager::put(const std::string &path, std::shared_ptr<const CachedFile> file) {
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    auto [it, inserted] = m_cache.emplace(path, std::move(file));
+    if (inserted) {
+        metrics::Registry::instance().fileCacheBytes += static_cast<int64_t>(it->second->content.size());
+    }
+    return it->second;
+}
+
+void FileCacheManager::erase(const std::string &path) {
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    auto it = m_cache.find(path);
+    if (it != m_cache.end()) {
+        metrics::Registry::instance().fileCacheBytes -= static_cast<int64_t>(it->second->content.size());
+        m_cache.erase(it);
+    }
 }
 
 void FileCacheManager::clear() {
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    for (const auto &entry: m_cache) {
+        metrics::Registry::instance().fileCacheBytes -= static_cast<int64_t>(entry.second->content.size());
+    }
     m_cache.clear();
 }
 
@@ -163,7 +267,7 @@ public:
 
     void handle(const HttpRequest &req, HttpResponse &res) override {
         // TODO: 实现请求转发，类似 Nginx 的 proxy_pass
-        spdlog::info("Forwarding request to {}", m_targetUrl);
+        SPDLOG_DEBUG("Forwarding request to {}", m_targetUrl);
 
         // TODO: 使用类似 HTTP 客户端的逻辑去向目标地址转发请求并返回响应，这里可以使用 boost::asio 进行请求转发
         res.setStatus(502, "Bad Gateway");
@@ -0,0 +1,69 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+
+// 所有线程共享的 Date 头部值（RFC 9110 IMF-fixdate），每秒只格式化一次。
+// 值按 8 字节分段存放在原子变量中，用序列号判断读取期间是否被改写（seqlock），读取时不加锁
+class HttpDate {
+public:
+    static constexpr size_t kLength = 29; // "Sun, 06 Nov 1994 08:49:37 GMT"
+
+    static HttpDate &instance() {
+        static HttpDate date;
+        return date;
+    }
+
+    // 把当前时间的 Date 值复制到 out，写入 kLength 字节
+    void copy(char *out) {
+        int64_t now = std::time(nullptr);
+        if (m_second.load(std::memory_order_acquire) != now) {
+            refresh(now);
+        }
+
+        std::array<uint64_t, kWords> words;
+        uint32_t seq;
+        do {
+            seq = m_seq.load(std::memory_order_acquire);
+            for (size_t i = 0; i < kWords; ++i) {
+                words[i] = m_words[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while ((seq & 1) || seq != m_seq.load(std::memory_order_relaxed));
+        std::memcpy(out, words.data(), kLength);
+    }
+
+private:
+    static constexpr size_t kWords = (kLength + 7) / 8;
+
+    std::mutex m_mutex;
+    std::atomic<int64_t> m_second{-1};
+    std::atomic<uint32_t> m_seq{0};
+    std::array<std::atomic<uint64_t>, kWords> m_words{};
+
+    void refresh(int64_t now) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_second.load(std::memory_order_relaxed) == now) {
+            return;
+        }
+        char text[kWords * 8 + 1] = {};
+        time_t seconds = static_cast<time_t>(now);
+        struct tm tm;
+        gmtime_r(&seconds, &tm);
+        std::strftime(text, sizeof(text), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+
+        uint32_t seq = m_seq.load(std::memory_order_relaxed);
+        m_seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < kWords; ++i) {
+            uint64_t word;
+            std::memcpy(&word, text + i * 8, sizeof(word));
+            m_words[i].store(word, std::memory_order_relaxed);
+        }
+        m_seq.store(seq + 2, std::memory_order_release);
+        m_second.store(now, std::memory_order_release);
+    }
+};
@@ -0,0 +1,272 @@
+#pragma once
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <string_view>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HTTPSCAN_X86 1
+#endif
+
+// 请求头扫描。核心操作是找出第一个“特殊字节”：控制字符（含 CR、LF、TAB）、DEL，以及可选的冒号，
+// 借此一次定位行尾和名值分隔符，同时拒绝非法字节（picohttpparser 的做法）。
+// x86 上按 CPU 在运行时选择 AVX2（每次 32 字节）或 SSE4.2（每次 16 字节），其余情况逐字节扫描
+// 头部结束标记 "\r\n\r\n" 另用一组内核整段查找，中途不在每个 CRLF 处停下
+// 请求路径同样先整段扫描一遍，没有 %、点段和重复斜杠时不再逐字节处理
+namespace httpscan {
+
+using Kernel = const char *(*)(const char *p, const char *end, bool colon);
+
+inline const char *findSpecialScalar(const char *p, const char *end, bool colon) {
+    for (; p < end; ++p) {
+        unsigned char c = static_cast<unsigned char>(*p);
+        if (c < 0x20 || c == 0x7f || (colon && c == ':')) {
+            break;
+        }
+    }
+    return p;
+}
+
+#ifdef HTTPSCAN_X86
+__attribute__((target("sse4.2"))) inline const char *findSpecialSse42(const char *p, const char *end, bool colon) {
+    // 按区间匹配：[0x00, 0x1f]、[0x7f, 0x7f]、[':', ':']
+    alignas(16) static const char ranges[16] = {'\x00', '\x1f', '\x7f', '\x7f', ':', ':'};
+    const __m128i r = _mm_load_si128(reinterpret_cast<const __m128i *>(ranges));
+    const int rangeLength = colon ? 6 : 4;
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        int index = _mm_cmpestri(r, rangeLength, v, 16, _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_LEAST_SIGNIFICANT);
+        if (index != 16) {
+            return p + index;
+        }
+        p += 16;
+    }
+    return findSpecialScalar(p, end, colon);
+}
+
+__attribute__((target("avx2"))) inline const char *findSpecialAvx2(const char *p, const char *end, bool colon) {
+    const __m256i control = _mm256_set1_epi8(0x1f);
+    const __m256i del = _mm256_set1_epi8(0x7f);
+    const __m256i separator = _mm256_set1_epi8(colon ? ':' : 0x7f);
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        // 无符号比较 v <= 0x1f 等价于 min(v, 0x1f) == v
+        __m256i special = _mm256_cmpeq_epi8(_mm256_min_epu8(v, control), v);
+        special = _mm256_or_si256(special, _mm256_cmpeq_epi8(v, del));
+        special = _mm256_or_si256(special, _mm256_cmpeq_epi8(v, separator));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(special));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+    return findSpecialSse42(p, end, colon);
+}
+#endif
+
+inline Kernel selectKernel() {
+#ifdef HTTPSCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return findSpecialAvx2;
+    }
+    if (__builtin_cpu_supports("sse4.2")) {
+        return findSpecialSse42;
+    }
+#endif
+    return findSpecialScalar;
+}
+
+inline const Kernel g_findSpecial = selectKernel();
+
+// 返回 [p, end) 中第一个特殊字节的位置，没有时返回 end
+inline const char *findSpecial(const char *p, const char *end, bool colon) { return g_findSpecial(p, end, colon); }
+
+inline const char *findHeaderEndScalar(const char *p, const char *end) {
+    for (; end - p >= 4; ++p) {
+        if (p[0] == '\r' && p[1] == '\n' && p[2] == '\r' && p[3] == '\n') {
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+#ifdef HTTPSCAN_X86
+// 四个错开一字节的加载分别与 \r \n \r \n 比较，相与后的第一位即标记起点
+__attribute__((target("avx2"))) inline const char *findHeaderEndAvx2(const char *p, const char *end) {
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    while (end - p >= 32 + 3) {
+        __m256i match = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)), cr);
+        match = _mm256_and_si256(match, _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 1)), lf));
+        match = _mm256_and_si256(match, _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 2)), cr));
+        match = _mm256_and_si256(match, _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 3)), lf));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(match));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+    return findHeaderEndScalar(p, end);
+}
+
+__attribute__((target("sse2"))) inline const char *findHeaderEndSse2(const char *p, const char *end) {
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    while (end - p >= 16 + 3) {
+        __m128i match = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)), cr);
+        match = _mm_and_si128(match, _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 1)), lf));
+        match = _mm_and_si128(match, _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 2)), cr));
+        match = _mm_and_si128(match, _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 3)), lf));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(match));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+    return findHeaderEndScalar(p, end);
+}
+#endif
+
+// 在 [p, end) 中查找，返回命中位置
+using SearchKernel = const char *(*)(const char *p, const char *end);
+
+inline SearchKernel selectHeaderEndKernel() {
+#ifdef HTTPSCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return findHeaderEndAvx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return findHeaderEndSse2;
+    }
+#endif
+    return findHeaderEndScalar;
+}
+
+inline const SearchKernel g_findHeaderEnd = selectHeaderEndKernel();
+
+// 从 from 开始查找头部结束标记 "\r\n\r\n"，返回其起点。
+// 续扫时 from 取上次数据末尾往前 3 字节，跨两次接收的标记也能找到
+inline size_t findHeaderEnd(std::string_view data, size_t from) {
+    const char *p = g_findHeaderEnd(data.data() + from, data.data() + data.size());
+    return p ? static_cast<size_t>(p - data.data()) : std::string_view::npos;
+}
+
+// 路径中需要进一步处理的第一个位置：'%'、紧跟 '/' 或 '.' 的 '/'，或查询串起点 '?'。
+// 返回 end 或 '?' 时路径部分已是规范形式，可以原样使用
+inline const char *findPathSpecialScalar(const char *p, const char *end) {
+    for (; p < end; ++p) {
+        if (*p == '%' || *p == '?' || (*p == '/' && end - p >= 2 && (p[1] == '/' || p[1] == '.'))) {
+            break;
+        }
+    }
+    return p;
+}
+
+#ifdef HTTPSCAN_X86
+__attribute__((target("avx2"))) inline const char *findPathSpecialAvx2(const char *p, const char *end) {
+    const __m256i percent = _mm256_set1_epi8('%');
+    const __m256i question = _mm256_set1_epi8('?');
+    const __m256i slash = _mm256_set1_epi8('/');
+    const __m256i dot = _mm256_set1_epi8('.');
+    while (end - p >= 32 + 1) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        __m256i next = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 1));
+        __m256i special = _mm256_or_si256(_mm256_cmpeq_epi8(v, percent), _mm256_cmpeq_epi8(v, question));
+        __m256i dotSegment = _mm256_or_si256(_mm256_cmpeq_epi8(next, slash), _mm256_cmpeq_epi8(next, dot));
+        special = _mm256_or_si256(special, _mm256_and_si256(_mm256_cmpeq_epi8(v, slash), dotSegment));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(special));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+    return findPathSpecialScalar(p, end);
+}
+
+__attribute__((target("sse2"))) inline const char *findPathSpecialSse2(const char *p, const char *end) {
+    const __m128i percent = _mm_set1_epi8('%');
+    const __m128i question = _mm_set1_epi8('?');
+    const __m128i slash = _mm_set1_epi8('/');
+    const __m128i dot = _mm_set1_epi8('.');
+    while (end - p >= 16 + 1) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 1));
+        __m128i special = _mm_or_si128(_mm_cmpeq_epi8(v, percent), _mm_cmpeq_epi8(v, question));
+        __m128i dotSegment = _mm_or_si128(_mm_cmpeq_epi8(next, slash), _mm_cmpeq_epi8(next, dot));
+        special = _mm_or_si128(special, _mm_and_si128(_mm_cmpeq_epi8(v, slash), dotSegment));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(special));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+    return findPathSpecialScalar(p, end);
+}
+#endif
+
+inline SearchKernel selectPathKernel() {
+#ifdef HTTPSCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return findPathSpecialAvx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return findPathSpecialSse2;
+    }
+#endif
+    return findPathSpecialScalar;
+}
+
+inline const SearchKernel g_findPathSpecial = selectPathKernel();
+
+inline const char *findPathSpecial(const char *p, const char *end) { return g_findPathSpecial(p, end); }
+
+struct HeaderLine {
+    std::string_view name;
+    std::string_view value; // 已去掉首尾空白
+    size_t next;            // 下一行的起点
+};
+
+// 解析从 pos 开始的一行头部。名字中不能有控制字符，值中只允许 TAB 这一个控制字符，行必须以 CRLF 结束
+inline bool parseHeaderLine(std::string_view data, size_t pos, HeaderLine &line) {
+    const char *begin = data.data();
+    const char *end = begin + data.size();
+    const char *start = begin + pos;
+    const char *colon = findSpecial(start, end, true);
+    // 名字与冒号之间不能有空白（RFC 9112 5.1），否则不同实现对 "Content-Length :" 的理解会不一致
+    if (colon == end || *colon != ':' || colon == start || colon[-1] == ' ') {
+        return false;
+    }
+    const char *p = colon + 1;
+    while ((p = findSpecial(p, end, false)) < end && *p == '\t') {
+        ++p;
+    }
+    if (end - p < 2 || p[0] != '\r' || p[1] != '\n') {
+        return false;
+    }
+
+    const char *valueBegin = colon + 1;
+    const char *valueEnd = p;
+    while (valueBegin < valueEnd && (*valueBegin == ' ' || *valueBegin == '\t')) {
+        ++valueBegin;
+    }
+    while (valueEnd > valueBegin && (valueEnd[-1] == ' ' || valueEnd[-1] == '\t')) {
+        --valueEnd;
+    }
+    line.name = std::string_view(start, colon - start);
+    line.value = std::string_view(valueBegin, valueEnd - valueBegin);
+    line.next = p + 2 - begin;
+    return true;
+}
+
+// 头部名字不区分大小写
+inline bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+               return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+           });
+}
+
+} // namespace httpscan
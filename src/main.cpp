@@ -1,11 +1,15 @@
+#include <csignal>
 #include <iostream>
 #include <multiserver.hpp>
 #include <spdlog/sinks/stdout_color_sinks.h> // 鐢ㄤ簬褰╄壊杈撳嚭
 #include <spdlog/spdlog.h>
+#include "accesslog.hpp"
+#include "capture.hpp"
 #include "configparser.hpp"
 #include "http_handler.hpp"
 #include "cgi.hpp"
 #include "cookiemanager.hpp"
+#include "hotreload.hpp"
 
 
 std::shared_ptr<StaticFileHandler> g_staticHandler;
@@ -13,36 +17,39 @@ std::shared_ptr<UploadHandler> g_uploadHandler;
 std::shared_ptr<CGIHandler> g_cgiHandler;
 std::unordered_map<std::string, std::shared_ptr<ProxyHandler>> g_proxyHandlers;
 std::shared_ptr<SessionManager> g_sessionManager;
+std::shared_ptr<SessionConfig> g_sessionConfig;
 
 
 std::string g_uploadPathPrefix;
 
 
 void handleRequest(const HttpRequest &request, HttpResponse &response) {
-    spdlog::info("[handleRequest] Received request: {} {}", request.getMethod(), request.getPath());
+    SPDLOG_DEBUG("[handleRequest] Received request: {} {}", request.getMethod(), request.getPath());
 
-    std::map<std::string, std::string> cookies;
-    if (request.hasHeader("Cookie")) {
-        cookies = CookieManager::parseCookies(request.getHeader("Cookie"));
-    }
-
-    std::string sid;
-    if (cookies.count("sid") > 0 && g_sessionManager->validateSession(cookies["sid"])) {
-        sid = cookies["sid"];
-        spdlog::debug("[handleRequest] Existing valid session id: {}", sid);
-    } else {
-        sid = g_sessionManager->createSession();
-        CookieManager::setCookie(response, "sid", sid);
-        spdlog::debug("[handleRequest] New session created: {}", sid);
-    }
+    std::string_view path = request.getPath();
+    std::string_view method = request.getMethod();
 
+    // 配置为排除的路径（如静态资源）不读写会话
+    if (!g_sessionConfig->isExcluded(path)) {
+        std::map<std::string, std::string> cookies;
+        if (request.hasHeader("Cookie")) {
+            cookies = CookieManager::parseCookies(std::string(request.getHeader("Cookie")));
+        }
 
-    const std::string &path = request.getPath();
-    const std::string &method = request.getMethod();
+        std::string sid;
+        if (cookies.count("sid") > 0 && g_sessionManager->validateSession(cookies["sid"])) {
+            sid = cookies["sid"];
+            SPDLOG_DEBUG("[handleRequest] Existing valid session id: {}", sid);
+        } else {
+            sid = g_sessionManager->createSession();
+            CookieManager::setCookie(response, "sid", sid);
+            SPDLOG_DEBUG("[handleRequest] New session created: {}", sid);
+        }
+    }
 
     // 代理检查
     for (const auto &entry: g_proxyHandlers) {
-        spdlog::debug("[handleRequest] Proxy checking: prefix = {}", entry.first);
+        SPDLOG_DEBUG("[handleRequest] Proxy checking: prefix = {}", entry.first);
         if (path.rfind(entry.first, 0) == 0) {
             if (!entry.second) {
                 spdlog::error("[handleRequest] Proxy handler for '{}' is null!", entry.first);
@@ -50,7 +57,8 @@ void handleRequest(const HttpRequest &request, HttpResponse &response) {
                 response.setBody("Proxy handler not available");
                 return;
             }
-            spdlog::debug("[handleRequest] Matched proxy, handling with ProxyHandler...");
+            SPDLOG_DEBUG("[handleRequest] Matched proxy, handling with ProxyHandler...");
+            response.setRoute(entry.first);
             entry.second->handle(request, response);
             return;
         }
@@ -63,13 +71,15 @@ void handleRequest(const HttpRequest &request, HttpResponse &response) {
     }
 
     if (path.find("/cgi/") == 0) {
+        response.setRoute("/cgi");
         g_cgiHandler->handle(request, response);
         return;
     }
 
     // 上传处理
     if (path.rfind(g_uploadPathPrefix, 0) == 0) {
-        spdlog::info("[handleRequest] Upload path matched, using UploadHandler...");
+        SPDLOG_DEBUG("[handleRequest] Upload path matched, using UploadHandler...");
+        response.setRoute(g_uploadPathPrefix);
         if (!g_uploadHandler) {
             spdlog::error("[handleRequest] Upload handler is null!");
             response.setStatus(500, "Internal Server Error");
@@ -82,7 +92,8 @@ void handleRequest(const HttpRequest &request, HttpResponse &response) {
 
     // 静态资源处理
     if (method == "GET" || method == "POST" || method == "HEAD") {
-        spdlog::info("[handleRequest] Handling with StaticFileHandler...");
+        SPDLOG_DEBUG("[handleRequest] Handling with StaticFileHandler...");
+        response.setRoute("static");
         if (!g_staticHandler) {
             spdlog::error("[handleRequest] Static file handler is null!");
             response.setStatus(500, "Internal Server Error");
@@ -99,42 +110,134 @@ void handleRequest(const HttpRequest &request, HttpResponse &response) {
     response.setBody("Unsupported method");
 }
 
-int main() {
+int main(int argc, char **argv) {
+    (void) argc;
     try {
-        spdlog::set_level(spdlog::level::info);
+        // 在创建任何线程之前屏蔽控制信号，统一由主线程 sigwait 处理
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        sigaddset(&signals, SIGUSR2);
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+        // Debug 构建输出逐请求的调试日志，其余构建中 SPDLOG_DEBUG 在编译期被移除
+        spdlog::set_level(static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL));
         auto console = spdlog::stdout_color_mt("console");
         console->set_pattern("%^[%l] %v%$");
         spdlog::info("Starting the application...");
 
+        // 对端关闭或超时 shutdown 后的写操作返回错误即可，不能让 SIGPIPE 终止进程
+        std::signal(SIGPIPE, SIG_IGN);
+
         ConfigCenter::instance().init("config.ini");
         auto serverConfig = ConfigCenter::instance().getServerConfig();
         auto siteConfig = ConfigCenter::instance().getSiteConfig();
         auto proxyConfig = ConfigCenter::instance().getProxyConfig();
         auto uploadConfig = ConfigCenter::instance().getUploadConfig();
 
-        g_staticHandler = std::make_shared<StaticFileHandler>(siteConfig->getRootDirectory(), siteConfig->getDefaultSite());
+        g_staticHandler = std::make_shared<StaticFileHandler>(siteConfig->getRootDirectory(), siteConfig->getDefaultSite(),
+                                                              siteConfig->getStatCacheTtl(), siteConfig->isPrewarm(),
+                                                              siteConfig->getBundle());
         g_uploadPathPrefix = uploadConfig->getRequestPath(); // 例如 "/upload"
         g_cgiHandler = std::make_shared<CGIHandler>(siteConfig->getRootDirectory());
         std::string uploadStoragePath = uploadConfig->getStoragePath(); // 例如 "./uploads"
         g_uploadHandler = std::make_shared<UploadHandler>(uploadStoragePath);
         g_proxyHandlers = proxyConfig->getProxyMap();
+        g_sessionConfig = ConfigCenter::instance().getSessionConfig();
         g_sessionManager = std::make_shared<SessionManager>();
 
+        auto logConfig = ConfigCenter::instance().getLogConfig();
+        if (!logConfig->getAccessLog().empty()) {
+            AccessLog::instance().open(logConfig->getAccessLog(), logConfig->getMaxSize(), logConfig->getMaxFiles());
+        }
+        auto captureConfig = ConfigCenter::instance().getCaptureConfig();
+        if (captureConfig->isEnabled()) {
+            TrafficCapture::instance().open(captureConfig->getFile(), captureConfig->getSampleEvery(),
+                                            captureConfig->getPrefixes(), captureConfig->getMaxSize(),
+                                            captureConfig->getMaxFiles());
+        }
+
 
-        auto address = Address::createIPv4Address(serverConfig->getPort(), serverConfig->getAllowedIps());
-        auto sock = Socket::CreateSSL(address);
-        sock->bind(address);
-        sock->listen();
+        // 热重载启动时按本地地址接管旧进程的监听套接字，不重新 bind；新配置中删掉的监听直接关闭
+        std::vector<Socket::ptr> listeners;
+        std::vector<int> inheritedFds = HotReload::inheritedListenFds();
+        for (const auto &listener: serverConfig->getListeners()) {
+            Socket::ptr sock;
+            auto inherited = std::find_if(inheritedFds.begin(), inheritedFds.end(), [&listener](int fd) {
+                auto local = Address::getLocalAddress(fd);
+                return local && local->toString() == listener.address->toString();
+            });
+            if (inherited != inheritedFds.end()) {
+                spdlog::info("Inherited listening socket fd {} for {}", *inherited, listener.address->toString());
+                sock = Socket::Adopt(*inherited, listener.tls);
+                inheritedFds.erase(inherited);
+            } else {
+                sock = listener.tls ? Socket::CreateSSL(listener.address) : Socket::CreateTCP(listener.address);
+                if (listener.address->getFamily() == AF_INET6) {
+                    sock->setV6Only(listener.v6only);
+                }
+                if (!sock->bind(listener.address) || !sock->listen()) {
+                    throw std::runtime_error("Failed to listen on " + listener.address->toString() + ": " +
+                                             std::strerror(errno));
+                }
+            }
+            if (listener.tls && serverConfig->isHttp2Enabled()) {
+                sock->enableHttp2();
+            }
+            sock->setProxyProtocol(listener.proxy);
+            listeners.push_back(sock);
+        }
+        for (int fd: inheritedFds) {
+            ::close(fd);
+        }
 
-        MultiThreadedHttpServer server(sock, serverConfig->getThreads()); // 使用 4 个线程
+        MultiThreadedHttpServer server(listeners, serverConfig->getThreads());
         server.setHandle(handleRequest);
+        server.setPipelining(serverConfig->isPipeliningEnabled(), serverConfig->isPipelineParallel());
+        server.setLimits(serverConfig->getLimits());
+        auto admissionConfig = ConfigCenter::instance().getAdmissionConfig();
+        server.setAdmission(admissionConfig->buildFilter(), admissionConfig->getConnectionRate(),
+                            admissionConfig->getRequestRate());
+        server.setTrustedProxies(admissionConfig->buildTrustedProxies());
+        bool proxied = std::any_of(serverConfig->getListeners().begin(), serverConfig->getListeners().end(),
+                                   [](const ListenerConfig &listener) { return listener.proxy; });
+        if (proxied && admissionConfig->getTrustedProxies().empty()) {
+            spdlog::warn("PROXY protocol listeners configured but admission.trusted_proxies is empty, "
+                         "TCP connections on them will be refused");
+        }
+        auto metricsConfig = ConfigCenter::instance().getMetricsConfig();
+        if (metricsConfig->isEnabled()) {
+            server.setMetricsEndpoint(metricsConfig->getPath(), metricsConfig->getAllowedIps());
+        }
         server.start();
 
-        spdlog::info("Server started on port {}", serverConfig->getPort());
+        spdlog::info("Server started on {} listener(s) (pid {})", listeners.size(), getpid());
         ConfigCenter::instance().printConfigInfo();
-
-        std::cin.get();
-        server.stop();
+        HotReload::notifyReady();
+
+        // SIGTERM/SIGINT：优雅停止；SIGUSR2：启动新进程接管监听套接字后再优雅停止
+        while (true) {
+            int sig = 0;
+            sigwait(&signals, &sig);
+            if (sig != SIGUSR2) {
+                spdlog::info("Received signal {}, shutting down", sig);
+                break;
+            }
+            spdlog::info("Received SIGUSR2, re-executing binary");
+            std::vector<int> listenFds;
+            for (const auto &listener: listeners) {
+                listenFds.push_back(listener->getSocket());
+            }
+            if (HotReload::spawnSuccessor(listenFds, argv, std::chrono::seconds(10))) {
+                break;
+            }
+            spdlog::error("Reload failed, continuing to serve");
+        }
+        server.stop(serverConfig->getShutdownTimeout());
+        AccessLog::instance().close();
+        TrafficCapture::instance().close();
+        spdlog::info("Server stopped");
     } catch (const std::exception &e) {
         std::cerr << "Error: " << e.what() << std::endl;
         return 1;
@@ -0,0 +1,336 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// 运行指标，以 Prometheus 文本格式导出。
+// 计数器与直方图按线程分片（每个线程固定写自己的分片，只做 relaxed 原子加），读取时汇总
+namespace metrics {
+
+inline size_t threadSlot() {
+    static std::atomic<size_t> next{0};
+    thread_local size_t slot = next.fetch_add(1, std::memory_order_relaxed);
+    return slot;
+}
+
+class Counter {
+public:
+    void inc(uint64_t value = 1) {
+        m_shards[threadSlot() % kShards].value.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const {
+        uint64_t total = 0;
+        for (const auto &shard: m_shards) {
+            total += shard.value.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+private:
+    static constexpr size_t kShards = 64;
+
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> value{0};
+    };
+
+    std::array<Shard, kShards> m_shards;
+};
+
+// HDR 风格的对数线性直方图：每个 2 的幂区间再等分 8 个桶，相对误差约 6%，
+// 单位为微秒，上限约 2^40 us
+class Histogram {
+    static constexpr int kSubBits = 3;
+    static constexpr size_t kLinear = 1 << (kSubBits + 1); // 16 以下每个值一个桶
+    static constexpr int kMaxExponent = 40;
+    static constexpr size_t kShards = 16;
+
+public:
+    static constexpr size_t kBuckets = kLinear + (kMaxExponent - kSubBits) * (1 << kSubBits);
+
+    void record(std::chrono::microseconds duration) {
+        uint64_t value = duration.count() < 0 ? 0 : static_cast<uint64_t>(duration.count());
+        Shard &shard = m_shards[threadSlot() % kShards];
+        shard.counts[indexOf(value)].fetch_add(1, std::memory_order_relaxed);
+        shard.sum.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    struct Snapshot {
+        std::array<uint64_t, kBuckets> counts{};
+        uint64_t count = 0;
+        uint64_t sum = 0;
+
+        // 返回分位数所在桶的上界（微秒）
+        uint64_t quantile(double q) const {
+            if (count == 0) {
+                return 0;
+            }
+            uint64_t rank = static_cast<uint64_t>(q * (count - 1)) + 1;
+            uint64_t seen = 0;
+            for (size_t i = 0; i < kBuckets; ++i) {
+                seen += counts[i];
+                if (seen >= rank) {
+                    return upperBound(i);
+                }
+            }
+            return upperBound(kBuckets - 1);
+        }
+    };
+
+    Snapshot snapshot() const {
+        Snapshot result;
+        for (const auto &shard: m_shards) {
+            for (size_t i = 0; i < kBuckets; ++i) {
+                uint64_t n = shard.counts[i].load(std::memory_order_relaxed);
+                result.counts[i] += n;
+                result.count += n;
+            }
+            result.sum += shard.sum.load(std::memory_order_relaxed);
+        }
+        return result;
+    }
+
+private:
+    struct alignas(64) Shard {
+        std::array<std::atomic<uint64_t>, kBuckets> counts{};
+        std::atomic<uint64_t> sum{0};
+    };
+
+    std::array<Shard, kShards> m_shards;
+
+    static size_t indexOf(uint64_t value) {
+        if (value < kLinear) {
+            return value;
+        }
+        int msb = std::min(63 - std::countl_zero(value), kMaxExponent);
+        int shift = msb - kSubBits;
+        size_t sub = std::min<uint64_t>(value >> shift, (2 << kSubBits) - 1) - (1 << kSubBits);
+        return kLinear + (msb - kSubBits - 1) * (1 << kSubBits) + sub;
+    }
+
+    static uint64_t upperBound(size_t index) {
+        if (index < kLinear) {
+            return index;
+        }
+        size_t offset = index - kLinear;
+        int msb = static_cast<int>(offset >> kSubBits) + kSubBits + 1;
+        uint64_t sub = (offset & ((1 << kSubBits) - 1)) + (1 << kSubBits);
+        int shift = msb - kSubBits;
+        return ((sub + 1) << shift) - 1;
+    }
+};
+
+// 指标注册表与导出
+class Registry {
+public:
+    static Registry &instance() {
+        static Registry registry;
+        return registry;
+    }
+
+    Counter acceptedConnections;
+    Counter rejectedConnections;
+    Counter deniedConnections;
+    Counter rateLimitedConnections;
+    Counter rateLimitedRequests;
+    Counter shedConnections;
+    Counter reclaimedConnections;
+    Counter proxyProtocolErrors;
+    Counter fileCacheHits;
+    Counter fileCacheMisses;
+    Counter statCacheHits;
+    Counter statCacheMisses;
+    Histogram gzipTime;
+    Histogram cgiSpawnTime;
+    Histogram cgiTime;
+    Histogram queueDelay;
+    std::atomic<int64_t> fileCacheBytes{0};
+
+    // 由拥有者提供当前值的指标（连接数、队列深度等）
+    void addGauge(const std::string &name, const std::string &help, std::function<double()> read) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_gauges[name] = {help, std::move(read)};
+    }
+
+    void removeGauge(const std::string &name) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_gauges.erase(name);
+    }
+
+    // 按路由记录请求耗时与状态码。路由由匹配到的处理器给出，取值来自代码与配置，不随客户端请求增长；
+    // 没有处理器认领的请求和 404 一律归入 unmatched，扫描器探测任意路径不会挤占标签。数量上限只是兜底，超出的归入 other
+    void observeRequest(std::string_view routeName, int status, std::chrono::microseconds latency) {
+        Route &route = routeFor(status == 404 || routeName.empty() ? kUnmatchedRoute : routeName);
+        route.latency.record(latency);
+        int statusClass = status / 100;
+        if (statusClass >= 1 && statusClass <= 5) {
+            route.responses[statusClass - 1].inc();
+        }
+    }
+
+    std::string render() {
+        std::string out;
+        counter(out, "http_accepted_connections_total", "Accepted connections", acceptedConnections.value());
+        counter(out, "http_rejected_connections_total", "Connections rejected by connection limits",
+                rejectedConnections.value());
+        counter(out, "http_denied_connections_total",
+                "Connections refused by the client address filter or from untrusted PROXY protocol peers",
+                deniedConnections.value());
+        counter(out, "http_rate_limited_connections_total", "Connections refused by the per-IP connection rate limit",
+                rateLimitedConnections.value());
+        counter(out, "http_rate_limited_requests_total", "Requests answered 429 by the per-IP request rate limit",
+                rateLimitedRequests.value());
+        counter(out, "http_shed_connections_total", "Connections refused with 503 because of queueing delay",
+                shedConnections.value());
+        counter(out, "http_reclaimed_connections_total", "Idle keep-alive connections closed to free workers while overloaded",
+                reclaimedConnections.value());
+        counter(out, "http_proxy_protocol_errors_total", "Connections closed because of a missing or invalid PROXY header",
+                proxyProtocolErrors.value());
+        counter(out, "file_cache_hits_total", "Static file cache hits", fileCacheHits.value());
+        counter(out, "file_cache_misses_total", "Static file cache misses", fileCacheMisses.value());
+        counter(out, "stat_cache_hits_total", "Static file metadata lookups served without stat", statCacheHits.value());
+        counter(out, "stat_cache_misses_total", "Static file metadata lookups that called stat", statCacheMisses.value());
+        gauge(out, "file_cache_bytes", "Bytes held by the static file cache",
+              static_cast<double>(fileCacheBytes.load(std::memory_order_relaxed)));
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (const auto &entry: m_gauges) {
+                gauge(out, entry.first, entry.second.help, entry.second.read());
+            }
+        }
+        summary(out, "gzip_compress_seconds", "Time spent gzip-compressing response bodies", "", gzipTime.snapshot(),
+                true);
+        summary(out, "cgi_spawn_seconds", "Time to fork a CGI process", "", cgiSpawnTime.snapshot(), true);
+        summary(out, "cgi_duration_seconds", "CGI run time until the script exits", "", cgiTime.snapshot(), true);
+        summary(out, "threadpool_queue_delay_seconds", "Time accepted connections wait for a worker thread", "",
+                queueDelay.snapshot(), true);
+
+        std::vector<std::pair<std::string, Route *>> routes;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (auto &entry: m_routes) {
+                routes.emplace_back(entry.first, entry.second.get());
+            }
+        }
+        bool first = true;
+        for (const auto &route: routes) {
+            summary(out, "http_request_duration_seconds", "Request latency by route",
+                    "route=\"" + route.first + "\"", route.second->latency.snapshot(), first);
+            first = false;
+        }
+        if (!routes.empty()) {
+            out += "# HELP http_responses_total Responses by route and status class\n";
+            out += "# TYPE http_responses_total counter\n";
+            for (const auto &route: routes) {
+                for (int i = 0; i < 5; ++i) {
+                    out += "http_responses_total{route=\"" + route.first + "\",code=\"" + std::to_string(i + 1) +
+                           "xx\"} " + std::to_string(route.second->responses[i].value()) + "\n";
+                }
+            }
+        }
+        return out;
+    }
+
+private:
+    static constexpr size_t kMaxRoutes = 64;
+    static constexpr std::string_view kUnmatchedRoute = "unmatched";
+
+    struct Gauge {
+        std::string help;
+        std::function<double()> read;
+    };
+
+    struct Route {
+        Histogram latency;
+        std::array<Counter, 5> responses;
+    };
+
+    std::mutex m_mutex;
+    std::map<std::string, Gauge> m_gauges;
+    std::map<std::string, std::unique_ptr<Route>> m_routes;
+
+    // 路由表只增不减，每个线程缓存已见过的路由，只有首次遇到时才加锁
+    Route &routeFor(std::string_view name) {
+        thread_local std::unordered_map<std::string, Route *, StringHash, std::equal_to<>> cache;
+        auto cached = cache.find(name);
+        if (cached != cache.end()) {
+            return *cached->second;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::string label = escape(name);
+        auto it = m_routes.find(label);
+        if (it == m_routes.end() && m_routes.size() >= kMaxRoutes) {
+            it = m_routes.find("other");
+            label = "other";
+        }
+        if (it == m_routes.end()) {
+            it = m_routes.emplace(label, std::make_unique<Route>()).first;
+        }
+        if (cache.size() < kMaxRoutes * 2) {
+            cache.emplace(name, it->second.get());
+        }
+        return *it->second;
+    }
+
+    // 支持以 string_view 查找，命中缓存时不构造临时字符串
+    struct StringHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view value) const { return std::hash<std::string_view>{}(value); }
+    };
+
+    static std::string escape(std::string_view value) {
+        std::string out;
+        for (char c: value) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+            }
+            out += c == '\n' ? ' ' : c;
+        }
+        return out;
+    }
+
+    static void counter(std::string &out, const std::string &name, const std::string &help, uint64_t value) {
+        out += "# HELP " + name + " " + help + "\n# TYPE " + name + " counter\n";
+        out += name + " " + std::to_string(value) + "\n";
+    }
+
+    static void gauge(std::string &out, const std::string &name, const std::string &help, double value) {
+        out += "# HELP " + name + " " + help + "\n# TYPE " + name + " gauge\n";
+        out += name + " " + formatDouble(value) + "\n";
+    }
+
+    static void summary(std::string &out, const std::string &name, const std::string &help, const std::string &labels,
+                        const Histogram::Snapshot &snapshot, bool header) {
+        if (header) {
+            out += "# HELP " + name + " " + help + "\n# TYPE " + name + " summary\n";
+        }
+        std::string prefix = labels.empty() ? "" : labels + ",";
+        for (double q: {0.5, 0.9, 0.99}) {
+            out += name + "{" + prefix + "quantile=\"" + formatDouble(q) + "\"} " +
+                   formatDouble(snapshot.quantile(q) / 1e6) + "\n";
+        }
+        std::string suffix = labels.empty() ? "" : "{" + labels + "}";
+        out += name + "_sum" + suffix + " " + formatDouble(snapshot.sum / 1e6) + "\n";
+        out += name + "_count" + suffix + " " + std::to_string(snapshot.count) + "\n";
+    }
+
+    static std::string formatDouble(double value) {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.6g", value);
+        return buffer;
+    }
+};
+
+} // namespace metrics
@@ -1,99 +1,717 @@
 #pragma once
+#include <atomic>
 #include <cmath>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
 #include <spdlog/spdlog.h>
+#include <strings.h>
 
+#include "accesslog.hpp"
+#include "admission.hpp"
+#include "arena.hpp"
+#include "capture.hpp"
+#include "connectionlimiter.hpp"
+#include "http2.hpp"
+#include "metrics.hpp"
 #include "server.hpp"
 #include "threadpool.hpp"
+#include "timerwheel.hpp"
 
 class MultiThreadedHttpServer {
 public:
+    // 每个监听套接字各有一个 accept 线程，接受的连接进入同一个工作线程池
+    MultiThreadedHttpServer(std::vector<Socket::ptr> listeners, size_t num_threads, bool keep_alive = true) :
+        m_listeners(std::move(listeners)), m_isRunning(false), m_keepAlive(keep_alive), m_threadPool(num_threads) {}
+
     MultiThreadedHttpServer(Socket::ptr sock, size_t num_threads, bool keep_alive = true) :
-        m_sock(sock), m_isRunning(false), m_keepAlive(keep_alive), m_threadPool(num_threads) {}
+        MultiThreadedHttpServer(std::vector<Socket::ptr>{sock}, num_threads, keep_alive) {}
+
+    ~MultiThreadedHttpServer() { stop(); }
 
     bool start() {
+        // 非阻塞监听：与热重载后的新进程共享监听套接字时，accept 失败不会卡住
+        for (auto &listener: m_listeners) {
+            listener->setNonBlocking(true);
+        }
+        metrics::Registry::instance().addGauge("http_active_connections", "Open client connections",
+                                               [this]() { return static_cast<double>(m_limiter.active()); });
+        metrics::Registry::instance().addGauge("threadpool_queue_depth", "Connections waiting for a worker thread",
+                                               [this]() { return static_cast<double>(m_threadPool.queueDepth()); });
+        metrics::Registry::instance().addGauge("buffer_pool_bytes", "Slab memory reserved by the I/O buffer pool", [] {
+            return static_cast<double>(BufferPool::instance().slabBytes());
+        });
         m_isRunning = true;
-        m_acceptThread = std::thread(&MultiThreadedHttpServer::acceptLoop, this);
+        m_timerWheel.start();
+        for (auto &listener: m_listeners) {
+            m_acceptThreads.emplace_back(&MultiThreadedHttpServer::acceptLoop, this, listener);
+        }
         return true;
     }
 
-    void stop() {
-        m_isRunning = false;
-        if (m_acceptThread.joinable()) {
-            m_acceptThread.join();
+    // 优雅停止：不再 accept，立即关闭空闲的 keep-alive 连接，等待进行中的请求完成，
+    // 超过 drainTimeout 后强制断开剩余连接
+    void stop(std::chrono::seconds drainTimeout = std::chrono::seconds(0)) {
+        if (!m_isRunning.exchange(false)) {
+            return;
+        }
+        for (auto &thread: m_acceptThreads) {
+            thread.join();
         }
-        m_threadPool.~ThreadPool();
+        m_acceptThreads.clear();
+
+        {
+            std::unique_lock<std::mutex> lock(m_connMutex);
+            m_draining = true;
+            spdlog::info("[MultiThreadHttpServer] Draining {} connection(s)", m_connections.size());
+            for (auto &entry: m_connections) {
+                if (entry.second.idle) {
+                    shutdownConnection(entry.second);
+                }
+            }
+            if (!m_connCond.wait_for(lock, drainTimeout, [this]() { return m_connections.empty(); })) {
+                spdlog::warn("[MultiThreadHttpServer] {} connection(s) still active after {}s, closing",
+                             m_connections.size(), drainTimeout.count());
+                for (auto &entry: m_connections) {
+                    shutdownConnection(entry.second);
+                }
+            }
+        }
+
+        m_threadPool.shutdown();
+        m_timerWheel.stop();
+        metrics::Registry::instance().removeGauge("http_active_connections");
+        metrics::Registry::instance().removeGauge("threadpool_queue_depth");
+        metrics::Registry::instance().removeGauge("buffer_pool_bytes");
     }
 
     void setHandle(HttpCallback cb) { m_handle = cb; }
 
+    // parallel 为 true 时同一批流水线请求并发处理，响应仍按原顺序写出
+    void setPipelining(bool enabled, bool parallel = false) {
+        m_pipelining = enabled;
+        m_pipelineParallel = parallel;
+    }
+
+    // 在 path 上提供 Prometheus 指标，只允许 allowedIps 中的客户端访问（为空则不限制）
+    void setMetricsEndpoint(const std::string &path, std::vector<std::string> allowedIps) {
+        m_metricsPath = path;
+        m_metricsAllowedIps = std::move(allowedIps);
+    }
+
+    void setLimits(const ConnectionLimits &limits) {
+        m_limits = limits;
+        m_limiter.setLimits(limits.maxConnections, limits.maxConnectionsPerIp);
+        m_queueControl = std::make_unique<CoDel>(limits.queueTarget, limits.queueInterval);
+    }
+
+    // 来源地址过滤与按 IP 的连接、请求速率限制，需在 start() 之前设置
+    void setAdmission(IpFilter filter, RateLimit connections, RateLimit requests) {
+        m_ipFilter = std::move(filter);
+        m_connectionRate = connections.rate ? std::make_unique<RateLimiter>(connections) : nullptr;
+        m_requestRate = requests.rate ? std::make_unique<RateLimiter>(requests) : nullptr;
+    }
+
+    // 允许在 PROXY 协议监听上发送协议头的负载均衡器地址，为空时不信任任何 TCP 对端
+    void setTrustedProxies(IpFilter proxies) { m_trustedProxies = std::move(proxies); }
+
 private:
-    void acceptLoop() {
+    void acceptLoop(Socket::ptr listener) {
         while (m_isRunning) {
-            Socket::ptr client = m_sock->accept();
-            if (client) {
-                m_threadPool.enqueue([this, client]() { handleRequest(client); });
+            reclaimIdle(std::chrono::steady_clock::now());
+            if (!listener->waitReadable(kAcceptPollMs)) {
+                continue;
+            }
+            Socket::ptr client = listener->accept();
+            if (!client || !client->getRemoteAddress()) {
+                continue;
+            }
+            // PROXY 协议监听上的对端是负载均衡器：这里只确认它受信任并占用全局名额，
+            // 真实来源要在工作线程读到协议头之后才知道，到那时再做按来源的检查
+            std::shared_ptr<ConnectionLimiter::Ticket> ticket;
+            if (client->expectsProxyHeader()) {
+                if (!trustedProxy(client)) {
+                    metrics::Registry::instance().deniedConnections.inc();
+                    SPDLOG_DEBUG("[MultiThreadHttpServer] Untrusted proxy, rejecting {}",
+                                 client->getRemoteAddress()->toString());
+                    continue;
+                }
+                ticket = acquireTicket(client, "");
+            } else if (admitSource(client)) {
+                ticket = acquireTicket(client, client->getRemoteAddress()->getIP());
             }
+            if (!ticket) {
+                continue;
+            }
+            metrics::Registry::instance().acceptedConnections.inc();
+            trackConnection(client);
+            // 排队时延在出队时计算。只有新连接经过这个队列，已建立的 keep-alive 连接独占工作线程；
+            // 过载时拒绝新来的客户端，并关闭空闲的 keep-alive 连接腾出工作线程，正在处理请求的连接不受影响
+            m_threadPool.enqueue([this, client, ticket, queued = std::chrono::steady_clock::now()]() {
+                auto now = std::chrono::steady_clock::now();
+                metrics::Registry::instance().queueDelay.record(
+                        std::chrono::duration_cast<std::chrono::microseconds>(now - queued));
+                startConnection(client);
+                if (m_queueControl && m_queueControl->shouldShed(now - queued, now)) {
+                    metrics::Registry::instance().shedConnections.inc();
+                    sendServiceUnavailable(client);
+                } else {
+                    handleRequest(client, ticket);
+                }
+                untrackConnection(client);
+            });
         }
     }
 
-    void handleRequest(Socket::ptr client) {
-        while (m_isRunning) {
-            HttpRequest request;
-            HttpResponse response(client);
-            spdlog::info("[MultiThreadHttpServer] Constructing request...");
+    // UNIX 域套接字只有本机进程能连上，视为受信任；TCP 对端须在 trusted_proxies 中，协议头里的地址可以任意填写
+    bool trustedProxy(const Socket::ptr &client) const {
+        if (client->getRemoteAddress()->getFamily() == AF_UNIX) {
+            return true;
+        }
+        return !m_trustedProxies.empty() && m_trustedProxies.allowed(IpKey::of(client->getRemoteAddress()->getAddress()));
+    }
+
+    // 按来源的准入检查：被过滤或超速的来源在 TLS 握手之前直接关闭。
+    // 洪泛时逐条打印日志本身就是负担，只计数。UNIX 域套接字的对端是本机前置代理，不做来源限制
+    bool admitSource(const Socket::ptr &client) {
+        bool local = client->getRemoteAddress()->getFamily() == AF_UNIX;
+        IpKey key = IpKey::of(client->getRemoteAddress()->getAddress());
+        if (!local && !m_ipFilter.allowed(key)) {
+            metrics::Registry::instance().deniedConnections.inc();
+            SPDLOG_DEBUG("[MultiThreadHttpServer] Address not allowed, rejecting {}", client->getRemoteAddress()->toString());
+            return false;
+        }
+        if (!local && m_connectionRate && !m_connectionRate->tryAcquire(key)) {
+            metrics::Registry::instance().rateLimitedConnections.inc();
+            SPDLOG_DEBUG("[MultiThreadHttpServer] Connection rate exceeded, rejecting {}",
+                         client->getRemoteAddress()->toString());
+            return false;
+        }
+        return true;
+    }
+
+    // 占用并发连接名额，ip 为空时只计入全局。超出上限时直接关闭，尚未进行 TLS 握手，代价很小
+    std::shared_ptr<ConnectionLimiter::Ticket> acquireTicket(const Socket::ptr &client, const std::string &ip) {
+        auto ticket = std::make_shared<ConnectionLimiter::Ticket>(m_limiter.tryAcquire(ip));
+        if (!*ticket) {
+            logRejection(client);
+            return nullptr;
+        }
+        return ticket;
+    }
 
-            if (!request.parse(client)) {
-                response.setStatus(400, "Bad Request");
-                response.send();
+    // 达到连接上限时拒绝往往成批出现，逐条打印日志本身就是负担：计入指标，
+    // 日志每秒最多一条，带上期间被拒绝的数量与最近一个来源
+    void logRejection(const Socket::ptr &client) {
+        metrics::Registry::instance().rejectedConnections.inc();
+        m_rejectedSinceLog.fetch_add(1, std::memory_order_relaxed);
+        int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
+        int64_t next = m_nextRejectionLog.load(std::memory_order_relaxed);
+        if (now < next || !m_nextRejectionLog.compare_exchange_strong(
+                                  next, now + std::chrono::steady_clock::duration(kRejectionLogInterval).count())) {
+            return;
+        }
+        spdlog::warn("[MultiThreadHttpServer] Connection limit reached, rejected {} connection(s), latest from {}",
+                     m_rejectedSinceLog.exchange(0, std::memory_order_relaxed), client->getRemoteAddress()->toString());
+    }
+
+    void handleRequest(Socket::ptr client, std::shared_ptr<ConnectionLimiter::Ticket> ticket) {
+        ConnectionTimer timer(m_timerWheel, client);
+        if (client->expectsProxyHeader() && (!readProxyHeader(client, timer) || !admitProxied(client, *ticket))) {
+            return;
+        }
+        timer.arm(m_limits.headerTimeout, "handshake");
+        if (!client->handshake()) {
+            return;
+        }
+
+        if (client->getAlpnProtocol() == "h2") {
+            SPDLOG_DEBUG("[MultiThreadHttpServer] HTTP/2 connection from {}", client->getRemoteAddress()->toString());
+            Http2Connection connection(client, [this, client](const HttpRequest &request, HttpResponse &response) {
+                dispatch(client, request, response);
+            });
+            // 各流的处理器在线程池上并行，慢处理器（如 CGI）不阻塞同一连接上的其他流；线程池停止后就地执行
+            connection.setExecutor([this](std::function<void()> task) {
+                try {
+                    m_threadPool.enqueue(std::move(task));
+                    return true;
+                } catch (const std::runtime_error &) {
+                    return false;
+                }
+            });
+            connection.setIdleCallback([this, &timer, client](bool waiting, bool quiescent) {
+                if (waiting) {
+                    timer.arm(m_limits.keepAliveTimeout, "idle");
+                } else {
+                    timer.cancel();
+                }
+                setIdle(client, waiting && quiescent);
+            });
+            connection.serve();
+            return;
+        }
+
+        RecvBuffer buffer;
+        RequestArena arena;
+        const std::string address = client->getRemoteAddress()->toString();
+        size_t served = 0;
+        // 停止过程中已被接受的连接至少处理一个请求
+        while (served == 0 || m_isRunning) {
+            // 上一批的请求与响应已经销毁，分配区整体回收
+            arena.reset();
+            // 等待期间不在分配区上分配，空闲连接不持有分配区和接收缓冲区
+            HttpRequest first(arena.resource());
+            SPDLOG_DEBUG("[MultiThreadHttpServer] Constructing request...");
+            // 请求耗时从收到首字节算起，流水线中已缓冲的请求从开始解析算起
+            auto start = std::chrono::steady_clock::now();
+
+            // 空闲等待、头部、请求体三个阶段分别计时，且都是绝对期限，慢速发送无法续期
+            if (buffer.empty()) {
+                timer.arm(m_limits.keepAliveTimeout, "idle");
+                setIdle(client, served > 0);
+            } else {
+                timer.arm(m_limits.headerTimeout, "header");
+            }
+            auto onProgress = [this, &timer, &start, client](bool headerComplete) {
+                if (headerComplete) {
+                    timer.arm(m_limits.bodyTimeout, "body");
+                } else {
+                    start = std::chrono::steady_clock::now();
+                    setIdle(client, false);
+                    timer.arm(m_limits.headerTimeout, "header");
+                }
+            };
+            HttpRequest::ParseResult result = first.parse(client, buffer, onProgress);
+            timer.cancel();
+            setIdle(client, false);
+            if (result != HttpRequest::ParseResult::Complete) {
+                if (result == HttpRequest::ParseResult::Invalid) {
+                    sendBadRequest(client);
+                }
                 break;
             }
+            std::pmr::vector<HttpRequest> requests(arena.resource());
+            requests.reserve(m_pipelining ? kMaxPipelineDepth : 1);
+            requests.push_back(std::move(first));
+
+            // 流水线：一次性取出缓冲区中所有已完整到达的请求
+            bool badRequest = false;
+            size_t remaining = m_limits.maxRequestsPerConnection ? m_limits.maxRequestsPerConnection - served : SIZE_MAX;
+            while (m_pipelining && requests.size() < std::min(kMaxPipelineDepth, remaining) &&
+                   wantsKeepAlive(requests.back())) {
+                HttpRequest next(arena.resource());
+                result = next.parseBuffered(buffer);
+                if (result == HttpRequest::ParseResult::Incomplete) {
+                    break;
+                }
+                if (result == HttpRequest::ParseResult::Invalid) {
+                    badRequest = true;
+                    break;
+                }
+                requests.push_back(std::move(next));
+            }
+
+            SPDLOG_DEBUG("[socket] Request Addr is {}, {} request(s) buffered", client->getRemoteAddress()->toString(),
+                         requests.size());
 
-            spdlog::info("[socket] Request Addr is {}", client->getRemoteAddress()->toString());
+            // 达到单连接请求数上限时，本批最后一个响应携带 Connection: close
+            served += requests.size();
+            bool lastBatch = m_limits.maxRequestsPerConnection && served >= m_limits.maxRequestsPerConnection;
 
-            bool keepAlive = true;
-            std::string connHeader = request.getHeader("Connection");
-            std::transform(connHeader.begin(), connHeader.end(), connHeader.begin(), ::tolower);
-            if (connHeader == "close") {
-                keepAlive = false;
-            } else if (connHeader.empty()) {
-                // HTTP/1.1 默认 keep-alive，但 HTTP/1.0 默认是 close
-                keepAlive = (request.getVersion() == "HTTP/1.1");
+            // 并行处理时多个线程同时构造响应，单调分配区不是线程安全的，此时响应改用全局堆
+            bool parallel = m_pipelineParallel && requests.size() > 1;
+            std::pmr::memory_resource *responseResource = parallel ? std::pmr::new_delete_resource() : arena.resource();
+            std::pmr::vector<HttpResponse> responses(arena.resource());
+            responses.reserve(requests.size());
+            for (size_t i = 0; i < requests.size(); ++i) {
+                responses.emplace_back(client, responseResource);
+            }
+            std::pmr::vector<char> keepAlive(requests.size(), 1, arena.resource());
+            if (parallel) {
+                auto batch = std::make_shared<ParallelBatch>();
+                batch->count = requests.size();
+                batch->work = [&](size_t i) {
+                    bool allowKeepAlive = !(lastBatch && i + 1 == requests.size());
+                    keepAlive[i] = processRequest(client, requests[i], responses[i], allowKeepAlive);
+                };
+                for (size_t i = 1; i < requests.size(); ++i) {
+                    try {
+                        m_threadPool.enqueue([batch]() { batch->drain(); });
+                    } catch (const std::runtime_error &) {
+                        // 线程池已停止，剩下的由本线程处理
+                        break;
+                    }
+                }
+                batch->drain();
+                batch->wait();
+            } else {
+                for (size_t i = 0; i < requests.size(); ++i) {
+                    bool allowKeepAlive = !(lastBatch && i + 1 == requests.size());
+                    keepAlive[i] = processRequest(client, requests[i], responses[i], allowKeepAlive);
+                    if (!keepAlive[i]) {
+                        break;
+                    }
+                }
             }
 
-            if (keepAlive){
-                if (!client->enableKeepAlive()) {
-                    spdlog::error("Failed to enable Keep-Alive");
+            // 按请求顺序写出响应，遇到需要关闭的连接即停止
+            bool close = false;
+            size_t sent = 1;
+            // 被抓包的响应需要完整报文，与流水线批量写出走同一路径
+            std::pmr::vector<char> capture(requests.size(), 0, arena.resource());
+            bool anyCapture = false;
+            for (size_t i = 0; i < requests.size(); ++i) {
+                capture[i] = TrafficCapture::instance().shouldCapture(requests[i].getPath());
+                anyCapture = anyCapture || capture[i];
+            }
+            if (requests.size() == 1 && !anyCapture) {
+                responses[0].send();
+                close = !keepAlive[0];
+            } else {
+                std::pmr::string batch(arena.resource());
+                for (sent = 0; sent < responses.size();) {
+                    size_t offset = batch.size();
+                    responses[sent].serialize(batch);
+                    if (capture[sent]) {
+                        TrafficCapture::instance().record(address, requests[sent], std::string_view(batch).substr(offset));
+                    }
+                    if (!keepAlive[sent++]) {
+                        close = true;
+                        break;
+                    }
+                }
+                client->send(batch.data(), batch.size());
+            }
+            auto latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+            for (size_t i = 0; i < sent; ++i) {
+                metrics::Registry::instance().observeRequest(responses[i].getRoute(), responses[i].getStatus(), latency);
+            }
+            if (AccessLog::instance().enabled()) {
+                for (size_t i = 0; i < sent; ++i) {
+                    AccessLog::instance().log(address, requests[i], responses[i], start);
                 }
             }
 
-            if (m_handle) {
-                m_handle(request, response);
-                if(response.getStatus() == 404){
-                    keepAlive = false;
+            if (badRequest && !close) {
+                sendBadRequest(client);
+                break;
+            }
+            if (close) {
+                break;
+            }
+        }
+    }
+
+    // 处理单个请求并返回连接是否保持
+    static bool wantsKeepAlive(const HttpRequest &request) {
+        std::string_view connHeader = request.getHeader("Connection");
+        if (connHeader.size() == 5 && strncasecmp(connHeader.data(), "close", 5) == 0) {
+            return false;
+        } else if (connHeader.empty()) {
+            // HTTP/1.1 默认 keep-alive，但 HTTP/1.0 默认是 close
+            return request.getVersion() == "HTTP/1.1";
+        }
+        return true;
+    }
+
+    bool processRequest(Socket::ptr client, const HttpRequest &request, HttpResponse &response, bool allowKeepAlive) {
+        bool keepAlive = m_keepAlive && m_isRunning && allowKeepAlive && wantsKeepAlive(request);
+
+        if (keepAlive) {
+            if (!client->enableKeepAlive()) {
+                spdlog::error("Failed to enable Keep-Alive");
+            }
+        }
+
+        dispatch(client, request, response);
+        if (response.getStatus() == 404 || response.getStatus() == 429) {
+            keepAlive = false;
+        }
+
+        response.setHeader("Connection", keepAlive ? "keep-alive" : "close");
+        if (keepAlive && m_limits.keepAliveTimeout.count() > 0) {
+            response.setHeader("Keep-Alive", "timeout=" + std::to_string(m_limits.keepAliveTimeout.count()));
+        }
+        std::string_view encoding = request.getHeader("Accept-Encoding");
+        if (encoding.find("gzip") != std::string::npos) {
+            response.setHeader("Content-Encoding", "gzip");
+        }
+        return keepAlive;
+    }
+
+    // 超速的请求不进入任何处理逻辑；内部路由（指标）优先，其余交给业务回调
+    void dispatch(const Socket::ptr &client, const HttpRequest &request, HttpResponse &response) {
+        const sockaddr *peer = client->getRemoteAddress()->getAddress();
+        if (m_requestRate && peer->sa_family != AF_UNIX && !m_requestRate->tryAcquire(IpKey::of(peer))) {
+            metrics::Registry::instance().rateLimitedRequests.inc();
+            response.setStatus(429, "Too Many Requests");
+            response.setHeader("Retry-After", "1");
+            response.setBody("Too Many Requests");
+            return;
+        }
+        if (!m_metricsPath.empty() && request.getPath() == m_metricsPath) {
+            response.setRoute(m_metricsPath);
+            std::string ip = client->getRemoteAddress()->getIP();
+            if (!m_metricsAllowedIps.empty() &&
+                std::find(m_metricsAllowedIps.begin(), m_metricsAllowedIps.end(), ip) == m_metricsAllowedIps.end()) {
+                response.setStatus(403, "Forbidden");
+                response.setBody("Forbidden");
+                return;
+            }
+            response.setHeader("Content-Type", "text/plain; version=0.0.4");
+            response.setBody(metrics::Registry::instance().render());
+            return;
+        }
+        if (m_handle) {
+            m_handle(request, response);
+        } else {
+            response.setStatus(404, "Not Found");
+        }
+    }
+
+    // 过载拒绝：握手后读完请求头再回 503，避免未读数据导致关闭时发送 RST 丢掉响应；
+    // HTTP/2 连接直接 GOAWAY
+    void sendServiceUnavailable(Socket::ptr client) {
+        // 拒绝本身不能占住工作线程：协议头、握手与请求头共用一个短期限，慢客户端直接断开
+        ConnectionTimer timer(m_timerWheel, client);
+        timer.arm(kShedTimeout, "shed");
+        if (client->expectsProxyHeader() && !client->readProxyHeader()) {
+            metrics::Registry::instance().proxyProtocolErrors.inc();
+            return;
+        }
+        if (!client->handshake()) {
+            return;
+        }
+        if (client->getAlpnProtocol() == "h2") {
+            Http2Connection(client, nullptr).refuse();
+            return;
+        }
+        RecvBuffer buffer;
+        RequestArena arena;
+        HttpRequest request(arena.resource());
+        if (request.parse(client, buffer) == HttpRequest::ParseResult::Incomplete) {
+            return;
+        }
+        HttpResponse response(client);
+        response.setStatus(503, "Service Unavailable");
+        response.setHeader("Retry-After", "1");
+        response.setHeader("Connection", "close");
+        response.setBody("Service Unavailable");
+        response.send();
+    }
+
+    void sendBadRequest(Socket::ptr client) {
+        HttpResponse response(client);
+        response.setStatus(400, "Bad Request");
+        response.setHeader("Connection", "close");
+        response.send();
+    }
+
+    static constexpr size_t kMaxPipelineDepth = 16;
+    static constexpr int kAcceptPollMs = 200;
+    // 过载时回 503 的全部期限（含 PROXY 头与 TLS 握手）
+    static constexpr std::chrono::milliseconds kShedTimeout{1000};
+    static constexpr std::chrono::milliseconds kReclaimInterval{100};
+    static constexpr std::chrono::seconds kRejectionLogInterval{1};
+
+    struct ConnectionState {
+        Socket::weak_ptr sock;
+        bool idle = false;
+        // 已被工作线程取走；此前在线程池队列中等待，queued 为入队时刻
+        bool started = false;
+        std::chrono::steady_clock::time_point queued;
+    };
+
+    static void shutdownConnection(const ConnectionState &state) {
+        if (auto sock = state.sock.lock()) {
+            sock->shutdown();
+        }
+    }
+
+    void trackConnection(const Socket::ptr &client) {
+        std::lock_guard<std::mutex> lock(m_connMutex);
+        auto &state = m_connections[client.get()];
+        state.sock = client;
+        state.queued = std::chrono::steady_clock::now();
+    }
+
+    void untrackConnection(const Socket::ptr &client) {
+        std::lock_guard<std::mutex> lock(m_connMutex);
+        m_connections.erase(client.get());
+        m_connCond.notify_all();
+    }
+
+    // 过载时关闭在请求之间空闲等待的 keep-alive 连接，把它们独占的工作线程让给排队的新连接；
+    // 客户端会在新连接上重试空闲连接上的下一个请求。工作线程全被占住时没有出队样本，
+    // CoDel 的状态不再更新，所以同时检查是否有新连接已排队超过目标时延。由 accept 线程按间隔调用
+    void reclaimIdle(std::chrono::steady_clock::time_point now) {
+        if (!m_queueControl || !m_queueControl->enabled()) {
+            return;
+        }
+        size_t closed = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_connMutex);
+            if (now < m_nextReclaim) {
+                return;
+            }
+            m_nextReclaim = now + kReclaimInterval;
+            bool overloaded = m_queueControl->overloaded() && m_threadPool.queueDepth() > 0;
+            for (auto it = m_connections.begin(); !overloaded && it != m_connections.end(); ++it) {
+                overloaded = !it->second.started && now - it->second.queued > m_queueControl->target();
+            }
+            if (!overloaded) {
+                return;
+            }
+            for (auto &entry: m_connections) {
+                if (entry.second.idle) {
+                    entry.second.idle = false;
+                    shutdownConnection(entry.second);
+                    ++closed;
                 }
-            } else {
-                response.setStatus(404, "Not Found");
-                keepAlive = false;
             }
+        }
+        if (closed > 0) {
+            metrics::Registry::instance().reclaimedConnections.inc(closed);
+            spdlog::info("[MultiThreadHttpServer] Overloaded, closed {} idle connection(s)", closed);
+        }
+    }
+
+    void startConnection(const Socket::ptr &client) {
+        std::lock_guard<std::mutex> lock(m_connMutex);
+        auto it = m_connections.find(client.get());
+        if (it != m_connections.end()) {
+            it->second.started = true;
+        }
+    }
 
-            response.setHeader("Connection", m_keepAlive ? "keep-alive" : "close");
-            std::string encoding = request.getHeader("Accept-Encoding");
-            if (encoding.find("gzip") != std::string::npos){
-                response.setHeader("Content-Encoding" , "gzip");
+    // 标记连接是否处于请求之间的空闲等待；停止过程中进入空闲的连接直接关闭
+    void setIdle(const Socket::ptr &client, bool idle) {
+        std::lock_guard<std::mutex> lock(m_connMutex);
+        auto it = m_connections.find(client.get());
+        if (it == m_connections.end()) {
+            return;
+        }
+        it->second.idle = idle;
+        if (idle && m_draining) {
+            client->shutdown();
+        }
+    }
+
+    // 并行处理一批流水线请求：其余请求作为任务投入同一个线程池，本线程也按顺序认领尚未开始的请求，
+    // 只等待已被其他线程取走的那些。线程池全忙时本线程独自处理完整批，不会因互相等待而死锁，也不额外创建线程。
+    // 任务可能在整批结束后才被调度，所以状态放在共享的控制块中，认领失败的任务不会访问调用方栈上的数据
+    struct ParallelBatch {
+        std::function<void(size_t)> work;
+        size_t count = 0;
+        std::atomic<size_t> next{0};
+        size_t completed = 0;
+        std::mutex mutex;
+        std::condition_variable done;
+
+        void drain() {
+            size_t i;
+            while ((i = next.fetch_add(1, std::memory_order_relaxed)) < count) {
+                work(i);
+                std::lock_guard<std::mutex> lock(mutex);
+                if (++completed == count) {
+                    done.notify_all();
+                }
             }
+        }
 
-            response.send();
+        void wait() {
+            std::unique_lock<std::mutex> lock(mutex);
+            done.wait(lock, [this] { return completed == count; });
+        }
+    };
 
-            if (!keepAlive) {
-                break;
+    // 每个连接同一时刻只挂一个超时定时器，到期时 shutdown 套接字以唤醒阻塞的工作线程
+    class ConnectionTimer {
+    public:
+        ConnectionTimer(TimerWheel &wheel, Socket::ptr sock) : m_wheel(wheel), m_sock(sock) {}
+
+        ~ConnectionTimer() { cancel(); }
+
+        // address 非空时日志使用它，而不在定时器线程上读取套接字的远端地址
+        void arm(std::chrono::milliseconds timeout, const char *phase, std::string address = {}) {
+            cancel();
+            if (timeout.count() <= 0) {
+                return;
             }
+            Socket::weak_ptr weak = m_sock;
+            m_id = m_wheel.add(timeout, [weak, phase, address = std::move(address)]() {
+                if (auto sock = weak.lock()) {
+                    spdlog::info("[MultiThreadHttpServer] {} timeout, closing {}", phase,
+                                 address.empty() ? sock->getRemoteAddress()->toString() : address);
+                    sock->shutdown();
+                }
+            });
+        }
+
+        void cancel() {
+            if (m_id) {
+                m_wheel.cancel(m_id);
+                m_id = 0;
+            }
+        }
+
+    private:
+        TimerWheel &m_wheel;
+        Socket::weak_ptr m_sock;
+        TimerWheel::TimerId m_id = 0;
+    };
+
+    // 读取 PROXY 协议头，此后远端地址即为真实客户端；头部缺失或格式错误时关闭连接。
+    // 读取期间远端地址会被替换，超时回调在定时器线程上运行，只能使用事先取好的均衡器地址
+    bool readProxyHeader(const Socket::ptr &client, ConnectionTimer &timer) {
+        std::string balancer = client->getRemoteAddress()->toString();
+        timer.arm(m_limits.headerTimeout, "proxy header", balancer);
+        if (!client->readProxyHeader()) {
+            metrics::Registry::instance().proxyProtocolErrors.inc();
+            SPDLOG_DEBUG("[MultiThreadHttpServer] Missing or invalid PROXY header from {}", balancer);
+            return false;
         }
+        SPDLOG_DEBUG("[MultiThreadHttpServer] {} proxied for {}", balancer, client->getRemoteAddress()->toString());
+        return true;
     }
 
-    Socket::ptr m_sock;
-    bool m_isRunning;
+    // 协议头给出真实来源后补做按来源的检查，并补记单 IP 连接数
+    bool admitProxied(const Socket::ptr &client, ConnectionLimiter::Ticket &ticket) {
+        if (!admitSource(client)) {
+            return false;
+        }
+        if (!m_limiter.tryAttach(ticket, client->getRemoteAddress()->getIP())) {
+            logRejection(client);
+            return false;
+        }
+        return true;
+    }
+
+    std::vector<Socket::ptr> m_listeners;
+    std::atomic<bool> m_isRunning;
     bool m_keepAlive;
-    std::thread m_acceptThread;
+    bool m_pipelining = true;
+    bool m_pipelineParallel = false;
+    std::vector<std::thread> m_acceptThreads;
     ThreadPool m_threadPool;
     HttpCallback m_handle;
+    std::string m_metricsPath;
+    std::vector<std::string> m_metricsAllowedIps;
+    ConnectionLimits m_limits;
+    ConnectionLimiter m_limiter;
+    std::unique_ptr<CoDel> m_queueControl;
+    IpFilter m_ipFilter;
+    IpFilter m_trustedProxies;
+    std::unique_ptr<RateLimiter> m_connectionRate;
+    std::unique_ptr<RateLimiter> m_requestRate;
+    TimerWheel m_timerWheel;
+
+    std::mutex m_connMutex;
+    std::condition_variable m_connCond;
+    std::unordered_map<Socket *, ConnectionState> m_connections;
+    std::chrono::steady_clock::time_point m_nextReclaim;
+    std::atomic<uint64_t> m_rejectedSinceLog{0};
+    std::atomic<int64_t> m_nextRejectionLog{0};
+    bool m_draining = false;
 };
@@ -1,210 +1,349 @@
 #pragma once
 
-#include <boost/url.hpp>
+#include <algorithm>
+#include <bufferpool.hpp>
+#include <cctype>
+#include <charconv>
 #include <condition_variable>
 #include <fstream>
 #include <functional>
 #include <gzip.hpp>
+#include <httpdate.hpp>
+#include <httpscan.hpp>
+#include <metrics.hpp>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <memory_resource>
 #include <mutex>
 #include <queue>
 #include <socket.hpp>
+#include <span>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <thread>
-// #include <boost/url/src.hpp>
+#include <urlpath.hpp>
 
 class HttpRequest {
 public:
-    bool parse(Socket::ptr sock) {
-        char buffer[100000000]; // 使用较大的缓冲区
-        size_t total_received = 0;
-        std::string data;
+    enum class ParseResult { Complete, Incomplete, Invalid, Closed };
+    using HeaderMap = std::pmr::map<std::pmr::string, std::pmr::string, std::less<>>;
+
+    // 字符串与头部都从 resource 分配，通常是连接的 RequestArena
+    explicit HttpRequest(std::pmr::memory_resource *resource = std::pmr::get_default_resource()) :
+        m_method(resource), m_path(resource), m_version(resource), m_headers(resource), m_body(resource) {}
+
+    // 从连接缓冲区中解析一个完整请求，不足时继续接收；
+    // 多出的字节（流水线中的后续请求）保留在 buffer 中供下一次解析
+    // 解析进度回调：收到首字节时以 false、头部接收完成时以 true 各调用一次，用于切换超时阶段
+    using ProgressCallback = std::function<void(bool headerComplete)>;
+
+    ParseResult parse(Socket::ptr sock, RecvBuffer &buffer, const ProgressCallback &onProgress = nullptr) {
+        bool started = false;
+        bool headerComplete = false;
 
         // 循环接收数据，直到接收到完整的请求
         while (true) {
-            spdlog::info("[HttpRequest] parsing loop ...");
-            size_t received = 0;
-            if (!sock->recv(buffer, sizeof(buffer), &received)) {
-                spdlog::info("[HttpRequest] parsing failed");
-                return false;
+            ParseResult result = parseBuffered(buffer);
+            if (result != ParseResult::Incomplete) {
+                return result;
+            }
+            if (onProgress && !buffer.empty()) {
+                if (!started) {
+                    started = true;
+                    onProgress(false);
+                }
+                if (!headerComplete && m_headerSeen) {
+                    headerComplete = true;
+                    onProgress(true);
+                }
             }
-            total_received += received;
-            data.append(buffer, received);
 
-            // 检查是否接收到完整的请求
-            if (isRequestComplete(data)) {
-                break;
+            SPDLOG_DEBUG("[HttpRequest] parsing loop ...");
+            // 空闲连接先等到数据到达再从池中借用接收缓冲区
+            if (buffer.empty() && !sock->waitReadable(-1)) {
+                return ParseResult::Closed;
+            }
+            size_t received = 0;
+            if (!sock->recv(buffer, &received)) {
+                SPDLOG_DEBUG("[HttpRequest] parsing failed");
+                return ParseResult::Closed;
+            }
+            if (received == 0) {
+                return ParseResult::Closed;
             }
         }
+    }
 
-        std::istringstream iss(data);
+    // 只解析已缓冲的数据，成功时从 buffer 中移除该请求
+    ParseResult parseBuffered(RecvBuffer &buffer) {
+        size_t consumed = 0;
+        ParseResult result = parseBuffered(buffer.view(), consumed);
+        if (result == ParseResult::Complete) {
+            buffer.consume(consumed);
+        }
+        return result;
+    }
 
-        // 解析请求行
-        std::string method, path, version;
-        iss >> method >> path >> version;
+    // 先在原数据上定位各字段，请求完整后才复制到成员中，consumed 为该请求占用的字节数
+    // 同一个请求多次调用时 data 须从同一位置开始（后面可以追加了新数据）
+    ParseResult parseBuffered(std::string_view data, size_t &consumed) {
+        // 从上次扫描停下的位置继续找头部结束标记，不必每次接收后都从头扫描
+        size_t headerEnd = httpscan::findHeaderEnd(data, m_scanned);
+        if (headerEnd == std::string_view::npos) {
+            m_scanned = data.size() > 3 ? data.size() - 3 : 0;
+            return data.size() > kMaxHeaderSize ? ParseResult::Invalid : ParseResult::Incomplete;
+        }
+        m_scanned = headerEnd;
+        m_headerSeen = true;
 
-        try
-        {
-            auto decoded = boost::urls::pct_string_view(path);
-            path = decoded.decode();
+        // 解析请求行，其中不能有控制字符
+        size_t lineEnd = httpscan::findSpecial(data.data(), data.data() + headerEnd + 2, false) - data.data();
+        if (data.substr(lineEnd, 2) != "\r\n") {
+            return ParseResult::Invalid;
         }
-        catch (const std::exception &e)
-        {
-            // 解码失败，返回错误
-            return false;
+        std::string_view requestLine = data.substr(0, lineEnd);
+        std::string_view method = nextToken(requestLine);
+        std::string_view path = nextToken(requestLine);
+        std::string_view version = nextToken(requestLine);
+        if (method.empty() || path.empty() || version.empty()) {
+            return ParseResult::Invalid;
         }
 
-        m_method = method;
-        m_path = path;
-        m_version = version;
+        // 校验头部并找出决定请求体边界的字段。名字不区分大小写；两个字段同时出现、Content-Length 重复且不一致
+        // 或不支持的 Transfer-Encoding 一律拒绝，否则与前置代理对请求边界的理解可能不同，造成请求走私
+        std::string_view transferEncoding;
+        std::string_view contentLengthValue;
+        bool hasTransferEncoding = false;
+        bool hasContentLength = false;
+        std::string_view headerBlock = data.substr(0, headerEnd + 2);
+        httpscan::HeaderLine line;
+        for (size_t pos = lineEnd + 2; pos < headerEnd; pos = line.next) {
+            if (!httpscan::parseHeaderLine(headerBlock, pos, line)) {
+                return ParseResult::Invalid;
+            }
+            if (httpscan::equalsIgnoreCase(line.name, "Transfer-Encoding")) {
+                if (hasTransferEncoding) {
+                    return ParseResult::Invalid;
+                }
+                transferEncoding = line.value;
+                hasTransferEncoding = true;
+            } else if (httpscan::equalsIgnoreCase(line.name, "Content-Length")) {
+                if (hasContentLength && line.value != contentLengthValue) {
+                    return ParseResult::Invalid;
+                }
+                contentLengthValue = line.value;
+                hasContentLength = true;
+            }
+        }
+        if (hasTransferEncoding &&
+            (hasContentLength || !httpscan::equalsIgnoreCase(transferEncoding, "chunked"))) {
+            return ParseResult::Invalid;
+        }
 
-        // 解析主体
-        m_body = std::string(std::istreambuf_iterator<char>(iss), std::istreambuf_iterator<char>());
+        // 确定请求体边界，流水线依赖它找到下一个请求的起点
+        size_t bodyStart = headerEnd + 4;
+        if (hasTransferEncoding) {
+            m_body.clear();
+            ParseResult result = decodeChunkedBody(data, bodyStart, m_body, consumed);
+            if (result != ParseResult::Complete) {
+                return result;
+            }
+        } else {
+            size_t contentLength = 0;
+            if (hasContentLength) {
+                auto [end, ec] = std::from_chars(contentLengthValue.data(),
+                                                 contentLengthValue.data() + contentLengthValue.size(), contentLength);
+                if (ec != std::errc() || end != contentLengthValue.data() + contentLengthValue.size()) {
+                    return ParseResult::Invalid;
+                }
+            }
+            if (data.size() - bodyStart < contentLength) {
+                SPDLOG_DEBUG("[HttpRequest] Request not finish...");
+                return ParseResult::Incomplete;
+            }
+            m_body.assign(data.substr(bodyStart, contentLength));
+            consumed = bodyStart + contentLength;
+        }
 
+        if (!setPath(path)) {
+            return ParseResult::Invalid;
+        }
 
-        spdlog::info("[HttpRequest] parsing successful");
-        return true;
+        m_method.assign(method);
+        m_version.assign(version);
+        m_headers.clear();
+        for (size_t pos = lineEnd + 2; pos < headerEnd; pos = line.next) {
+            httpscan::parseHeaderLine(headerBlock, pos, line);
+            setHeader(line.name, line.value);
+        }
+        m_scanned = 0;
+        m_headerSeen = false;
+
+        SPDLOG_DEBUG("[HttpRequest] parsing successful");
+        return ParseResult::Complete;
     }
 
-    const std::string getMethod() const { return m_method; }
+    std::string_view getMethod() const { return m_method; }
 
-    const std::string getPath() const { return m_path; }
+    std::string_view getPath() const { return m_path; }
 
-    const std::string getVersion() const { return m_version; }
+    std::string_view getVersion() const { return m_version; }
 
-    const std::map<std::string, std::string> getHeaders() const { return m_headers; }
+    const HeaderMap &getHeaders() const { return m_headers; }
 
-    const std::string &getHeader(const std::string &key) const {
+    std::string_view getHeader(std::string_view key) const {
         auto it = m_headers.find(key);
         if (it != m_headers.end()) {
             return it->second;
         }
-        return empty_string;
+        return {};
     }
 
-    bool hasHeader(const std::string &key) const {
-        auto it = m_headers.find(key);
-        if (it != m_headers.end()) {
-            return true;
-        }
-        return false;
+    bool hasHeader(std::string_view key) const {
+        return m_headers.find(key) != m_headers.end();
     }
 
-    const std::string &getBody() const { return m_body; }
+    std::string_view getBody() const { return m_body; }
 
-private:
-    std::string m_method;
-    std::string m_path;
-    std::string m_version;
-    std::map<std::string, std::string> m_headers;
-    std::string m_body;
-    static const std::string empty_string;
-
-    bool isRequestComplete(const std::string &data) {
-        // 检查是否包含两个连续的 CRLF，表示头部结束
-        spdlog::info("[HttpRequest] Checking Request header...");
-        size_t crlfPos = data.find("\r\n\r\n");
-        if (crlfPos == std::string::npos) {
+    // 供非 HTTP/1.1 文本协议（如 HTTP/2）直接构造请求
+    void setMethod(std::string_view method) { m_method.assign(method); }
+
+    // 解码并规范化请求目标，非法或越过根目录时返回 false
+    bool setPath(std::string_view path) {
+        m_path.assign(path);
+        size_t size = urlpath::normalize(m_path.data(), m_path.size());
+        if (size == std::string_view::npos) {
             return false;
         }
-        spdlog::info("[HttpRequest] Request header accepted, waiting for body ...");
-
-        // 提取头部部分
-        std::string headers = data.substr(0, crlfPos);
-
-        // 解析 Content-Length
-        size_t contentLength = 0;
-        std::istringstream iss(headers);
-        std::string line;
-        while (std::getline(iss, line) && line != "\r") {
-            size_t pos = line.find(':');
-            if (pos != std::string::npos) {
-                std::string key = line.substr(0, pos);
-                std::string value = line.substr(pos + 1);
-                m_headers[key] = value;
-                if (key == "Content-Length") {
-                    contentLength = std::stoull(value);
-                }
-            }
-        }
+        m_path.resize(size);
+        return true;
+    }
 
+    void setVersion(std::string_view version) { m_version.assign(version); }
 
-        spdlog::info("[HttpRequest] Body acquired");
-        // 检查请求体长度是否符合 Content-Length
-        size_t bodyLength = data.size() - crlfPos - 4; // 减去 "\r\n\r\n" 的长度
-        if (bodyLength >= contentLength) {
-            spdlog::info("[HttpRequest] Request finished");
-            return true;
+    void setHeader(std::string_view key, std::string_view value) {
+        auto it = m_headers.find(key);
+        if (it != m_headers.end()) {
+            it->second.assign(value);
+        } else {
+            m_headers.emplace(key, value);
         }
-        spdlog::info("[HttpRequest] Request not finish...");
-
-        return false;
     }
-};
 
-bool saveStringToFile(const std::string &content, const std::string &filename) {
-    std::ofstream file(filename, std::ios::binary);
-    if (!file) {
-        std::cerr << "Failed to open file: " << filename << std::endl;
-        return false;
-    }
+    void setBody(std::string_view body) { m_body.assign(body); }
 
-    file.write(content.data(), content.size());
-    if (!file) {
-        std::cerr << "Failed to write to file: " << filename << std::endl;
-        return false;
+private:
+    static constexpr size_t kMaxHeaderSize = 64 * 1024;
+
+    std::pmr::string m_method;
+    std::pmr::string m_path;
+    std::pmr::string m_version;
+    HeaderMap m_headers;
+    std::pmr::string m_body;
+    // 头部结束标记的扫描进度，请求不完整时下次从这里继续
+    size_t m_scanned = 0;
+    bool m_headerSeen = false;
+
+    // 取出下一个以空白分隔的字段
+    static std::string_view nextToken(std::string_view &line) {
+        size_t begin = line.find_first_not_of(" \t");
+        if (begin == std::string_view::npos) {
+            line = {};
+            return {};
+        }
+        size_t end = line.find_first_of(" \t", begin);
+        std::string_view token = line.substr(begin, end == std::string_view::npos ? end : end - begin);
+        line.remove_prefix(end == std::string_view::npos ? line.size() : end);
+        return token;
     }
 
-    file.close();
-    return true;
-}
+    static ParseResult decodeChunkedBody(std::string_view data, size_t pos, std::pmr::string &body, size_t &consumed) {
+        while (true) {
+            size_t lineEnd = data.find("\r\n", pos);
+            if (lineEnd == std::string_view::npos) {
+                return ParseResult::Incomplete;
+            }
+            size_t chunkSize = 0;
+            // 块大小后可以跟扩展（;name=value），只取开头的十六进制数
+            auto [sizeEnd, ec] = std::from_chars(data.data() + pos, data.data() + lineEnd, chunkSize, 16);
+            if (ec != std::errc() || (sizeEnd != data.data() + lineEnd && *sizeEnd != ';' && *sizeEnd != ' ' &&
+                                      *sizeEnd != '\t')) {
+                return ParseResult::Invalid;
+            }
+            pos = lineEnd + 2;
+            if (chunkSize == 0) {
+                // 跳过 trailers，直到空行
+                while (true) {
+                    size_t end = data.find("\r\n", pos);
+                    if (end == std::string_view::npos) {
+                        return ParseResult::Incomplete;
+                    }
+                    bool emptyLine = (end == pos);
+                    pos = end + 2;
+                    if (emptyLine) {
+                        break;
+                    }
+                }
+                consumed = pos;
+                return ParseResult::Complete;
+            }
+            if (data.size() - pos < chunkSize || data.size() - pos - chunkSize < 2) {
+                return ParseResult::Incomplete;
+            }
+            // 块数据后必须紧跟 CRLF，否则块大小与实际数据不符
+            if (data.substr(pos + chunkSize, 2) != "\r\n") {
+                return ParseResult::Invalid;
+            }
+            body.append(data.substr(pos, chunkSize));
+            pos += chunkSize + 2;
+        }
+    }
+};
 
-const std::string HttpRequest::empty_string;
-
-std::string getMimeType(const std::string &path) {
-    // MIME 类型映射表
-    std::map<std::string, std::string> mimeTypes = {{".html", "text/html"},
-                                                    {".htm", "text/html"},
-                                                    {".css", "text/css"},
-                                                    {".js", "application/javascript"},
-                                                    {".json", "application/json"},
-                                                    {".png", "image/png"},
-                                                    {".jpg", "image/jpeg"},
-                                                    {".jpeg", "image/jpeg"},
-                                                    {".gif", "image/gif"},
-                                                    {".svg", "image/svg+xml"},
-                                                    {".ico", "image/x-icon"},
-                                                    {".pdf", "application/pdf"},
-                                                    {".txt", "text/plain"},
-                                                    {".xml", "application/xml"},
-                                                    {".mp3", "audio/mpeg"},
-                                                    {".wav", "audio/wav"},
-                                                    {".mp4", "video/mp4"},
-                                                    {".avi", "video/x-msvideo"},
-                                                    {".ogg", "application/ogg"},
-                                                    {".webm", "video/webm"},
-                                                    {".woff", "font/woff"},
-                                                    {".woff2", "font/woff2"},
-                                                    {".ttf", "application/x-font-ttf"},
-                                                    {".otf", "application/x-font-opentype"},
-                                                    {".eot", "application/vnd.ms-fontobject"}};
-
-    // 提取文件扩展名
-    size_t dotPos = path.find_last_of('.');
-    if (dotPos == std::string::npos) {
+// 按扩展名（不区分大小写）查找 MIME 类型，表是静态的，查找过程不分配内存
+std::string_view getMimeType(std::string_view path) {
+    static constexpr std::pair<std::string_view, std::string_view> mimeTypes[] = {
+            {".html", "text/html"},
+            {".htm", "text/html"},
+            {".css", "text/css"},
+            {".js", "application/javascript"},
+            {".json", "application/json"},
+            {".png", "image/png"},
+            {".jpg", "image/jpeg"},
+            {".jpeg", "image/jpeg"},
+            {".gif", "image/gif"},
+            {".svg", "image/svg+xml"},
+            {".ico", "image/x-icon"},
+            {".pdf", "application/pdf"},
+            {".txt", "text/plain"},
+            {".xml", "application/xml"},
+            {".mp3", "audio/mpeg"},
+            {".wav", "audio/wav"},
+            {".mp4", "video/mp4"},
+            {".avi", "video/x-msvideo"},
+            {".ogg", "application/ogg"},
+            {".webm", "video/webm"},
+            {".woff", "font/woff"},
+            {".woff2", "font/woff2"},
+            {".ttf", "application/x-font-ttf"},
+            {".otf", "application/x-font-opentype"},
+            {".eot", "application/vnd.ms-fontobject"}};
+
+    // 提取文件扩展名，只看最后一段路径
+    size_t dotPos = path.find_last_of("./");
+    if (dotPos == std::string_view::npos || path[dotPos] != '.') {
         return "application/octet-stream"; // 默认 MIME 类型
     }
+    std::string_view extension = path.substr(dotPos);
 
-    std::string extension = path.substr(dotPos);
-    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
-
-    // 查找 MIME 类型
-    auto it = mimeTypes.find(extension);
-    if (it != mimeTypes.end()) {
-        return it->second;
+    for (const auto &entry: mimeTypes) {
+        if (entry.first.size() == extension.size() &&
+            std::equal(extension.begin(), extension.end(), entry.first.begin(),
+                       [](char a, char b) { return std::tolower(static_cast<unsigned char>(a)) == b; })) {
+            return entry.second;
+        }
     }
 
     return "application/octet-stream"; // 默认 MIME 类型
@@ -213,103 +352,305 @@ std::string getMimeType(const std::string &path) {
 
 class HttpResponse {
 public:
-    std::string m_path;
+    std::pmr::string m_path;
 
-    HttpResponse(Socket::ptr sock) : m_sock(sock) {}
+    // 头部、响应体和待发送的报文都从 resource 分配，通常是连接的 RequestArena
+    HttpResponse(Socket::ptr sock, std::pmr::memory_resource *resource = std::pmr::get_default_resource()) :
+        m_path(resource), m_sock(std::move(sock)), m_reason("OK", resource), m_headers(resource), m_body(resource) {}
 
-    void setStatus(int status, const std::string &reason) {
+    void setStatus(int status, std::string_view reason) {
         m_status = status;
-        m_reason = reason;
+        m_reason.assign(reason);
+        m_preparedHead = {};
     }
 
-    int getStatus(){
+    int getStatus() const {
         return m_status;
     }
 
-    void setHeader(const std::string &key, const std::string &value) { m_headers[key] = value; }
+    void setHeader(std::string_view key, std::string_view value) {
+        auto it = m_headers.find(key);
+        if (it != m_headers.end()) {
+            it->second.assign(value);
+        } else {
+            m_headers.emplace(key, value);
+        }
+    }
+
+    void setBody(std::string_view body) {
+        m_body.assign(body);
+        m_bodyOwner.reset();
+        m_preparedHead = {};
+    }
+
+    // 响应体直接引用外部的只读内存（如站点快照中的文件），不复制；owner 保证内存在响应发出前有效。
+    // gzipBody 为预先压缩好的版本，需要 gzip 编码时直接换用；为空表示不值得压缩，按原样发送
+    void setSharedBody(std::shared_ptr<const void> owner, std::string_view body, std::string_view gzipBody = {}) {
+        m_body.clear();
+        m_bodyOwner = std::move(owner);
+        m_sharedBody = body;
+        m_sharedGzipBody = gzipBody;
+        m_preparedHead = {};
+    }
+
+    // 预先序列化好的状态行与固定头部（如静态文件缓存项中的 Content-Type、Content-Length、ETag），
+    // 写出时整块复制，只追加其余的逐请求头部。须在设置状态与响应体之后调用，之后再改动状态、
+    // 响应体或压缩响应体都会使其失效，回到逐项生成
+    // owner 保证 head 指向的内存在响应发出前有效；covered 列出其中已包含的头部名，须指向静态存储
+    void setPreparedHead(std::shared_ptr<const void> owner, std::string_view head,
+                         std::span<const std::string_view> covered) {
+        m_preparedOwner = std::move(owner);
+        m_preparedHead = head;
+        m_preparedCovered = covered;
+    }
+
+    std::string_view getReason() const { return m_reason; }
+
+    const HttpRequest::HeaderMap &getHeaders() const { return m_headers; }
+
+    std::string_view getBody() const { return m_bodyOwner ? m_sharedBody : std::string_view(m_body); }
 
-    void setBody(const std::string &body) { m_body = body; }
+    // 上游（代理、CGI）处理耗时，记录到访问日志；负值表示没有经过上游
+    void setUpstreamTime(std::chrono::microseconds time) { m_upstreamTime = time; }
+
+    std::chrono::microseconds getUpstreamTime() const { return m_upstreamTime; }
+
+    // 处理该请求的路由（处理器名或配置的路径前缀），作为指标标签；须指向静态存储或随进程存在的配置
+    void setRoute(std::string_view route) { m_route = route; }
+
+    std::string_view getRoute() const { return m_route; }
+
+    // 按 Content-Encoding 压缩响应体，压缩失败时保留原始内容
+    void encodeBody() {
+        auto encoding = m_headers.find("Content-Encoding");
+        if (encoding != m_headers.end() && encoding->second == "gzip") {
+            bool compressed;
+            if (m_bodyOwner) {
+                compressed = !m_sharedGzipBody.empty();
+                if (compressed) {
+                    m_sharedBody = std::exchange(m_sharedGzipBody, {});
+                } else {
+                    m_headers.erase(encoding);
+                }
+            } else {
+                string compressedBody;
+                auto start = std::chrono::steady_clock::now();
+                compressed = GzipHandler::compress(m_body, compressedBody);
+                metrics::Registry::instance().gzipTime.record(
+                        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start));
+                if (compressed) {
+                    m_body.assign(compressedBody);
+                }
+            }
+            if (compressed) {
+                m_preparedHead = {};
+                // 压缩后的表示与原文不再逐字节相同，强 ETag 改为弱 ETag
+                auto etag = m_headers.find("ETag");
+                if (etag != m_headers.end() && !etag->second.starts_with("W/")) {
+                    etag->second.insert(0, "W/");
+                }
+            }
+        }
+    }
 
     void send() {
-        if (m_headers.find("Transfer-Encoding") != m_headers.end() && m_headers["Transfer-Encoding"] == "chunked") {
-            spdlog::info("[Response] Chunked Transfer");
+        if (isChunked()) {
+            SPDLOG_DEBUG("[Response] Chunked Transfer");
             sendChunkedResponse();
             return;
         }
 
-        if (m_headers.find("Content-Encoding") != m_headers.end() && m_headers["Content-Encoding"] == "gzip") {
-            string compressedBody;
-            if (!GzipHandler::compress(m_body, compressedBody)) {
-                sendResponse();
-                return;
+        encodeBody();
+        sendResponse();
+    }
+
+    // 生成完整响应报文追加到 out 而不发送，流水线模式下多个响应合并为一次写出
+    void serialize(std::pmr::string &out) {
+        if (isChunked()) {
+            appendChunkedHead(out);
+            for (size_t pos = 0; pos < getBody().size(); pos += kChunkSize) {
+                appendChunk(out, pos);
             }
-            m_body = compressedBody;
+            out += "0\r\n\r\n";
+            return;
         }
 
-        sendResponse();
+        encodeBody();
+        appendResponse(out);
     }
 
 private:
+    static constexpr size_t kChunkSize = 1024; // 每块大小为 1KB
+    static constexpr size_t kSendBufferSize = 16 * 1024;
+    // 明文连接上不小于该大小的响应体与头部聚集写出，不复制
+    static constexpr size_t kGatherThreshold = 4 * 1024;
+
     Socket::ptr m_sock;
     int m_status = 200;
-    std::string m_reason = "OK";
-    std::map<std::string, std::string> m_headers;
-    std::string m_body;
+    std::pmr::string m_reason;
+    HttpRequest::HeaderMap m_headers;
+    std::pmr::string m_body;
+    std::shared_ptr<const void> m_bodyOwner;
+    std::string_view m_sharedBody;
+    std::string_view m_sharedGzipBody;
+    std::chrono::microseconds m_upstreamTime{-1};
+    std::string_view m_route;
+    std::shared_ptr<const void> m_preparedOwner;
+    std::string_view m_preparedHead;
+    std::span<const std::string_view> m_preparedCovered;
+
+    bool isChunked() const {
+        auto it = m_headers.find("Transfer-Encoding");
+        return it != m_headers.end() && it->second == "chunked";
+    }
 
-    void sendResponse() {
+    static void appendNumber(std::pmr::string &out, size_t value, int base = 10) {
+        char digits[24];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value, base);
+        out.append(digits, result.ptr);
+    }
 
-        ostringstream oss;
-        oss << "HTTP/1.1 " << m_status << " " << m_reason << "\r\n";
+    void appendStatusLine(std::pmr::string &out) const {
+        out += "HTTP/1.1 ";
+        appendNumber(out, m_status);
+        out += ' ';
+        out += m_reason;
+        out += "\r\n";
+    }
 
+    static void appendDate(std::pmr::string &out) {
+        char date[HttpDate::kLength];
+        HttpDate::instance().copy(date);
+        out += "Date: ";
+        out.append(date, sizeof(date));
+        out += "\r\n";
+    }
+
+    // 状态行与全部头部（含结尾空行），不含响应体
+    void appendHead(std::pmr::string &out, size_t reserveBody = 0) const {
+        std::string_view body = getBody();
+        size_t size = 96 + m_reason.size() + reserveBody + m_preparedHead.size();
         for (const auto &header: m_headers) {
-            oss << header.first << ": " << header.second << "\r\n";
+            size += header.first.size() + header.second.size() + 4;
         }
+        out.reserve(out.size() + size);
 
-        oss << "Content-Length: " << m_body.size() << "\r\n";
-        oss << "\r\n";
-        oss << m_body;
+        if (!m_preparedHead.empty()) {
+            out += m_preparedHead;
+        } else {
+            appendStatusLine(out);
+        }
+        for (const auto &header: m_headers) {
+            if (!m_preparedHead.empty() &&
+                std::find(m_preparedCovered.begin(), m_preparedCovered.end(), header.first) != m_preparedCovered.end()) {
+                continue;
+            }
+            // 这里总是以 Content-Length 定界，处理逻辑留下的 Transfer-Encoding（包括空值）不能写出，
+            // 否则 HTTP/1.1 客户端会一直读到连接关闭
+            if (header.first == "Transfer-Encoding") {
+                continue;
+            }
+            out += header.first;
+            out += ": ";
+            out += header.second;
+            out += "\r\n";
+        }
+        appendDate(out);
+        if (m_preparedHead.empty()) {
+            out += "Content-Length: ";
+            appendNumber(out, body.size());
+            out += "\r\n";
+        }
+        out += "\r\n";
+    }
 
-        string response = oss.str();
-        saveStringToFile(response, "output.txt");
-        m_sock->send(response.c_str(), response.size());
+    void appendResponse(std::pmr::string &out) const {
+        std::string_view body = getBody();
+        appendHead(out, body.size());
+        out += body;
     }
-    void sendChunkedResponse() {
-        // 设置响应头
-        ostringstream oss;
-        oss << "HTTP/1.1 " << m_status << " " << m_reason << "\r\n";
-        oss << "Transfer-Encoding: chunked\r\n";
-        oss << "Content-Type: " << getMimeType(m_path) << "\r\n";
-        oss << "\r\n";
-
-        // 发送响应头
-        std::string responseHead = oss.str();
-        if (!m_sock->send(responseHead.c_str(), responseHead.size())) {
-            spdlog::warn("[Response] Chunked Send error");
-            return; // 发送失败，返回
+
+    void appendChunkedHead(std::pmr::string &out) const {
+        appendStatusLine(out);
+        appendDate(out);
+        out += "Transfer-Encoding: chunked\r\n";
+        out += "Content-Type: ";
+        out += getMimeType(m_path);
+        out += "\r\n";
+        auto conn = m_headers.find("Connection");
+        if (conn != m_headers.end()) {
+            out += "Connection: ";
+            out += conn->second;
+            out += "\r\n";
+        }
+        out += "\r\n";
+    }
+
+    void appendChunk(std::pmr::string &out, size_t pos) const {
+        std::string_view body = getBody();
+        size_t end = std::min(pos + kChunkSize, body.size());
+        appendNumber(out, end - pos, 16);
+        out += "\r\n";
+        out += body.substr(pos, end - pos);
+        out += "\r\n";
+    }
+
+    void sendResponse() {
+        std::pmr::string response(m_body.get_allocator());
+        std::string_view body = getBody();
+        if (!m_sock->isTls() && body.size() >= kGatherThreshold) {
+            appendHead(response);
+            struct iovec iov[2] = {{response.data(), response.size()}, {const_cast<char *>(body.data()), body.size()}};
+            m_sock->sendv(iov, 2);
+            return;
         }
+        appendResponse(response);
+        m_sock->send(response.data(), response.size());
+    }
 
-        size_t chunkSize = 1024; // 每块大小为 1KB
-        size_t pos = 0;
-
-        while (pos < m_body.size()) {
-            size_t end = std::min(pos + chunkSize, m_body.size());
-            std::string chunk = m_body.substr(pos, end - pos);
-    
-            std::stringstream hexStream;
-            hexStream << std::hex << chunk.size();
-    
-            std::string chunkData = hexStream.str() + "\r\n" + chunk + "\r\n";
-            if (!m_sock->send(chunkData.c_str(), chunkData.size())) {
-                return; // 发送失败，返回
+    void sendChunkedResponse() {
+        // 响应头和各块先写入池中的缓冲区，写满后一次发出，而不是每块单独写一次
+        IoBuffer buffer(kSendBufferSize);
+        size_t used = 0;
+        bool ok = true;
+        auto flush = [&] {
+            ok = ok && (used == 0 || m_sock->send(buffer.data(), used));
+            used = 0;
+        };
+        auto append = [&](std::string_view data) {
+            while (ok && !data.empty()) {
+                if (used == buffer.capacity()) {
+                    flush();
+                    continue;
+                }
+                size_t n = std::min(data.size(), buffer.capacity() - used);
+                std::memcpy(buffer.data() + used, data.data(), n);
+                used += n;
+                data.remove_prefix(n);
             }
-    
-            pos = end;
+        };
+
+        std::pmr::string responseHead(m_body.get_allocator());
+        appendChunkedHead(responseHead);
+        append(responseHead);
+
+        std::string_view body = getBody();
+        char sizeLine[24];
+        for (size_t pos = 0; pos < body.size(); pos += kChunkSize) {
+            size_t length = std::min(kChunkSize, body.size() - pos);
+            char *end = std::to_chars(sizeLine, sizeLine + sizeof(sizeLine) - 2, length, 16).ptr;
+            *end++ = '\r';
+            *end++ = '\n';
+            append(std::string_view(sizeLine, end - sizeLine));
+            append(body.substr(pos, length));
+            append("\r\n");
         }
 
-        // 发送结束块
-        if (!m_sock->send("0\r\n\r\n", 5)) {
+        // 结束块
+        append("0\r\n\r\n");
+        flush();
+        if (!ok) {
             spdlog::warn("[Response] Chunked Send error");
-            return; 
         }
     }
 };
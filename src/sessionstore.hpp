@@ -0,0 +1,782 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <optional>
+#include <pthread.h>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+struct SessionRecord {
+    int64_t expiry = 0; // Unix 时间戳（秒）
+    std::string user;
+};
+
+// 会话存储后端。get 不检查过期，由调用方比较 expiry
+class SessionStore {
+public:
+    using ptr = std::shared_ptr<SessionStore>;
+
+    virtual ~SessionStore() = default;
+
+    virtual bool put(const std::string &sid, const SessionRecord &record) = 0;
+    virtual std::optional<SessionRecord> get(const std::string &sid) = 0;
+    virtual void remove(const std::string &sid) = 0;
+
+    // 清理 now 之前过期的会话，返回清理数量；自带过期机制的后端无需实现
+    virtual size_t sweep(int64_t now) {
+        (void) now;
+        return 0;
+    }
+};
+
+// 进程内存储：按 ID 哈希分片，每片独立加锁；每片内按创建顺序维护链表，
+// 过期清理与超出容量时的淘汰都只需从链表头部开始
+class MemorySessionStore : public SessionStore {
+public:
+    // maxSessions 为 0 表示不限制
+    explicit MemorySessionStore(size_t maxSessions)
+        : m_maxPerShard(maxSessions == 0 ? 0 : std::max<size_t>(1, maxSessions / kShardCount)) {}
+
+    bool put(const std::string &sid, const SessionRecord &record) override {
+        Shard &shard = shardFor(sid);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.sessions.find(sid);
+        if (it != shard.sessions.end()) {
+            it->second.record = record;
+            return true;
+        }
+        if (m_maxPerShard && shard.sessions.size() >= m_maxPerShard) {
+            // 达到上限时淘汰本分片中最早创建的会话
+            shard.sessions.erase(shard.order.front());
+            shard.order.pop_front();
+        }
+        auto pos = shard.order.insert(shard.order.end(), sid);
+        shard.sessions[sid] = {record, pos};
+        return true;
+    }
+
+    std::optional<SessionRecord> get(const std::string &sid) override {
+        Shard &shard = shardFor(sid);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.sessions.find(sid);
+        if (it == shard.sessions.end()) {
+            return std::nullopt;
+        }
+        return it->second.record;
+    }
+
+    void remove(const std::string &sid) override {
+        Shard &shard = shardFor(sid);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.sessions.find(sid);
+        if (it != shard.sessions.end()) {
+            shard.order.erase(it->second.pos);
+            shard.sessions.erase(it);
+        }
+    }
+
+    // 会话超时固定，创建顺序即过期顺序
+    size_t sweep(int64_t now) override {
+        size_t removed = 0;
+        for (auto &shard: m_shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            while (!shard.order.empty()) {
+                auto it = shard.sessions.find(shard.order.front());
+                if (it->second.record.expiry > now) {
+                    break;
+                }
+                shard.sessions.erase(it);
+                shard.order.pop_front();
+                ++removed;
+            }
+        }
+        return removed;
+    }
+
+private:
+    static constexpr size_t kShardCount = 16;
+
+    struct Entry {
+        SessionRecord record;
+        std::list<std::string>::iterator pos;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<std::string, Entry> sessions;
+        std::list<std::string> order; // 按创建时间排序
+    };
+
+    std::array<Shard, kShardCount> m_shards;
+    size_t m_maxPerShard;
+
+    Shard &shardFor(const std::string &sid) { return m_shards[std::hash<std::string>{}(sid) % kShardCount]; }
+};
+
+// 基于 mmap 文件的组相联哈希表：每个桶 8 个定长槽位，桶满时覆盖最早过期的槽位。
+// 数据随写入落到页缓存，进程重启后会话仍然有效；槽位由文件内的进程间互斥量保护，
+// 热重载时新旧进程同时读写同一个文件也不会撕裂槽位
+class MmapSessionStore : public SessionStore {
+public:
+    static constexpr size_t kMaxSidSize = 47;
+    static constexpr size_t kMaxUserSize = 63;
+
+    MmapSessionStore(const std::string &path, size_t maxSessions) {
+        size_t buckets = 1;
+        while (buckets * kBucketSlots < std::max<size_t>(maxSessions, kBucketSlots)) {
+            buckets <<= 1;
+        }
+        m_bucketMask = buckets - 1;
+        m_size = sizeof(Header) + buckets * kBucketSlots * sizeof(Slot);
+
+        // 打开过程经锁文件串行化；每个进程对数据文件持有共享锁直到退出，
+        // 能取得排他锁说明没有其他进程在用，可以原地重建
+        int guard = ::open((path + ".lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        if (guard == -1) {
+            throw std::runtime_error("Failed to open session lock file " + path + ".lock: " + std::strerror(errno));
+        }
+        if (!lockFile(guard, F_WRLCK, true)) {
+            ::close(guard);
+            throw std::runtime_error("Failed to lock session file " + path + ": " + std::strerror(errno));
+        }
+        try {
+            open(path, buckets);
+        } catch (...) {
+            ::close(guard);
+            throw;
+        }
+        ::close(guard);
+    }
+
+    ~MmapSessionStore() override {
+        unmap();
+        ::close(m_fd);
+    }
+
+    bool put(const std::string &sid, const SessionRecord &record) override {
+        if (sid.size() > kMaxSidSize || record.user.size() > kMaxUserSize) {
+            return false;
+        }
+        size_t bucket = bucketOf(sid);
+        BucketLock lock(lockFor(bucket));
+        Slot *slots = m_slots + bucket * kBucketSlots;
+        Slot *target = nullptr;
+        for (size_t i = 0; i < kBucketSlots; ++i) {
+            if (slots[i].used && sid == slots[i].sid) {
+                target = &slots[i];
+                break;
+            }
+            if (!target || (target->used && (!slots[i].used || slots[i].expiry < target->expiry))) {
+                target = &slots[i];
+            }
+        }
+        std::memset(target, 0, sizeof(Slot));
+        std::memcpy(target->sid, sid.data(), sid.size());
+        std::memcpy(target->user, record.user.data(), record.user.size());
+        target->expiry = record.expiry;
+        target->used = 1;
+        return true;
+    }
+
+    std::optional<SessionRecord> get(const std::string &sid) override {
+        if (sid.size() > kMaxSidSize) {
+            return std::nullopt;
+        }
+        size_t bucket = bucketOf(sid);
+        BucketLock lock(lockFor(bucket));
+        Slot *slot = find(bucket, sid);
+        if (!slot) {
+            return std::nullopt;
+        }
+        return SessionRecord{slot->expiry, slot->user};
+    }
+
+    void remove(const std::string &sid) override {
+        if (sid.size() > kMaxSidSize) {
+            return;
+        }
+        size_t bucket = bucketOf(sid);
+        BucketLock lock(lockFor(bucket));
+        Slot *slot = find(bucket, sid);
+        if (slot) {
+            slot->used = 0;
+        }
+    }
+
+private:
+    static constexpr size_t kBucketSlots = 8;
+    static constexpr size_t kLockCount = 64;
+    // 头部含进程间互斥量，与第一版布局不兼容
+    static constexpr char kMagic[8] = {'S', 'E', 'S', 'S', 'I', 'O', 'N', '2'};
+
+    struct Header {
+        char magic[8];
+        uint64_t buckets;
+        // 按桶分段的锁，PTHREAD_PROCESS_SHARED + ROBUST：持锁进程崩溃后其他进程仍能取得
+        pthread_mutex_t locks[kLockCount];
+    };
+
+    struct Slot {
+        int64_t expiry;
+        uint8_t used;
+        char sid[kMaxSidSize + 1];
+        char user[kMaxUserSize + 1];
+    };
+
+    class BucketLock {
+    public:
+        explicit BucketLock(pthread_mutex_t *mutex) : m_mutex(mutex) {
+            if (pthread_mutex_lock(m_mutex) == EOWNERDEAD) {
+                // 上一个持有者在写槽位时退出，槽位可能不完整；会话丢失可以接受，锁恢复可用即可
+                pthread_mutex_consistent(m_mutex);
+            }
+        }
+
+        ~BucketLock() { pthread_mutex_unlock(m_mutex); }
+
+        BucketLock(const BucketLock &) = delete;
+        BucketLock &operator=(const BucketLock &) = delete;
+
+    private:
+        pthread_mutex_t *m_mutex;
+    };
+
+    int m_fd = -1;
+    size_t m_size = 0;
+    size_t m_bucketMask = 0;
+    Header *m_header = nullptr;
+    Slot *m_slots = nullptr;
+
+    // 整个文件上的 OFD 锁：随打开的文件描述存在，进程退出时自动释放，读写锁之间可原子转换
+    static bool lockFile(int fd, short type, bool wait) {
+        struct flock fl {};
+        fl.l_type = type;
+        fl.l_whence = SEEK_SET;
+        return fcntl(fd, wait ? F_OFD_SETLKW : F_OFD_SETLK, &fl) == 0;
+    }
+
+    void open(const std::string &path, size_t buckets) {
+        m_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        if (m_fd == -1) {
+            throw std::runtime_error("Failed to open session file " + path + ": " + std::strerror(errno));
+        }
+        struct stat st {};
+        fstat(m_fd, &st);
+        bool sized = static_cast<size_t>(st.st_size) == m_size;
+        if (lockFile(m_fd, F_WRLCK, false)) {
+            // 没有其他进程映射此文件：布局不同就原地重建；相同则保留会话，只重置上次运行残留的锁状态
+            if (!sized && (ftruncate(m_fd, 0) == -1 || ftruncate(m_fd, static_cast<off_t>(m_size)) == -1)) {
+                fail(path, "resize");
+            }
+            if (!map(path)) {
+                fail(path, "mmap");
+            }
+            bool keep = sized && matches(buckets);
+            if (!keep && st.st_size > 0) {
+                spdlog::warn("[MmapSessionStore] {} has a different layout, discarding stored sessions", path);
+            }
+            if (!initialize(buckets, keep)) {
+                fail(path, "initialize");
+            }
+        } else if (!sized || !map(path) || !matches(buckets)) {
+            // 其他进程（如热重载前的旧进程）仍在使用另一种布局（如 max_sessions 已改变）：
+            // 不能截断它正在映射的文件，另建新文件原子替换，旧进程继续使用旧文件直到退出
+            spdlog::warn("[MmapSessionStore] {} is in use with a different layout, replacing it with an empty store", path);
+            unmap();
+            ::close(m_fd);
+            replace(path, buckets);
+        }
+        if (!lockFile(m_fd, F_RDLCK, true)) {
+            fail(path, "lock");
+        }
+    }
+
+    void replace(const std::string &path, size_t buckets) {
+        std::string temp = path + ".tmp";
+        m_fd = ::open(temp.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        if (m_fd == -1) {
+            throw std::runtime_error("Failed to create session file " + temp + ": " + std::strerror(errno));
+        }
+        if (ftruncate(m_fd, static_cast<off_t>(m_size)) == -1 || !map(temp) || !initialize(buckets, false) ||
+            ::rename(temp.c_str(), path.c_str()) == -1) {
+            ::unlink(temp.c_str());
+            fail(temp, "replace");
+        }
+    }
+
+    bool map(const std::string &path) {
+        void *addr = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+        if (addr == MAP_FAILED) {
+            spdlog::error("[MmapSessionStore] Failed to mmap {}: {}", path, std::strerror(errno));
+            return false;
+        }
+        m_header = static_cast<Header *>(addr);
+        m_slots = reinterpret_cast<Slot *>(m_header + 1);
+        return true;
+    }
+
+    void unmap() {
+        if (m_header) {
+            munmap(m_header, m_size);
+            m_header = nullptr;
+            m_slots = nullptr;
+        }
+    }
+
+    [[noreturn]] void fail(const std::string &path, const char *what) {
+        int saved = errno;
+        unmap();
+        ::close(m_fd);
+        throw std::runtime_error(std::string("Failed to ") + what + " session file " + path + ": " + std::strerror(saved));
+    }
+
+    bool matches(size_t buckets) const {
+        return std::memcmp(m_header->magic, kMagic, sizeof(m_header->magic)) == 0 && m_header->buckets == buckets;
+    }
+
+    // 只在没有其他进程映射时调用；keep 为 true 时保留槽位，只重建锁
+    bool initialize(size_t buckets, bool keep) {
+        if (!keep) {
+            std::memset(static_cast<void *>(m_header), 0, m_size);
+        }
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+        bool ok = true;
+        for (auto &lock: m_header->locks) {
+            ok = ok && pthread_mutex_init(&lock, &attr) == 0;
+        }
+        pthread_mutexattr_destroy(&attr);
+        m_header->buckets = buckets;
+        std::memcpy(m_header->magic, kMagic, sizeof(m_header->magic));
+        return ok;
+    }
+
+    pthread_mutex_t *lockFor(size_t bucket) { return &m_header->locks[bucket % kLockCount]; }
+
+    // FNV-1a：布局写入文件，哈希必须在不同进程间保持一致
+    size_t bucketOf(const std::string &sid) const {
+        uint64_t hash = 1469598103934665603ULL;
+        for (unsigned char c: sid) {
+            hash = (hash ^ c) * 1099511628211ULL;
+        }
+        return hash & m_bucketMask;
+    }
+
+    Slot *find(size_t bucket, const std::string &sid) {
+        Slot *slots = m_slots + bucket * kBucketSlots;
+        for (size_t i = 0; i < kBucketSlots; ++i) {
+            if (slots[i].used && sid == slots[i].sid) {
+                return &slots[i];
+            }
+        }
+        return nullptr;
+    }
+};
+
+// RESP（Redis 协议）存储：所有请求进入队列，由一个 I/O 线程把队列中的命令一次写出、
+// 按顺序读取应答（pipelining），连续的 GET 合并为一条 MGET。
+// 前面有一层短 TTL 的本地读缓存，热点会话不必每次往返网络
+class RespSessionStore : public SessionStore {
+public:
+    RespSessionStore(std::string host, uint16_t port, std::chrono::milliseconds cacheTtl, size_t cacheCapacity = 4096)
+        : m_host(std::move(host)), m_port(port), m_cacheTtl(cacheTtl), m_cacheCapacity(cacheCapacity) {
+        m_thread = std::thread(&RespSessionStore::ioLoop, this);
+    }
+
+    ~RespSessionStore() override {
+        {
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            m_stopped = true;
+        }
+        m_queueCond.notify_all();
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+        closeConnection();
+    }
+
+    // 写入不等待应答；同一连接上的命令按序执行，之后的读取能看到这次写入
+    bool put(const std::string &sid, const SessionRecord &record) override {
+        int64_t ttl = record.expiry - unixNow();
+        if (ttl <= 0) {
+            remove(sid);
+            return true;
+        }
+        cacheStore(sid, record);
+        submit({"SET", key(sid), std::to_string(record.expiry) + "|" + record.user, "EX", std::to_string(ttl)});
+        return true;
+    }
+
+    std::optional<SessionRecord> get(const std::string &sid) override {
+        if (auto cached = cacheLookup(sid)) {
+            return cached;
+        }
+        auto future = submit({"GET", key(sid)});
+        if (future.wait_for(kRequestTimeout) != std::future_status::ready) {
+            return std::nullopt;
+        }
+        auto reply = future.get();
+        if (!reply) {
+            return std::nullopt;
+        }
+        size_t sep = reply->find('|');
+        if (sep == std::string::npos) {
+            return std::nullopt;
+        }
+        SessionRecord record;
+        try {
+            record.expiry = std::stoll(reply->substr(0, sep));
+        } catch (...) {
+            return std::nullopt;
+        }
+        record.user = reply->substr(sep + 1);
+        cacheStore(sid, record);
+        return record;
+    }
+
+    void remove(const std::string &sid) override {
+        {
+            std::lock_guard<std::mutex> lock(m_cacheMutex);
+            m_cache.erase(sid);
+        }
+        submit({"DEL", key(sid)});
+    }
+
+private:
+    static constexpr size_t kMaxBatch = 256;
+    static constexpr auto kRequestTimeout = std::chrono::seconds(1);
+    static constexpr auto kReconnectDelay = std::chrono::seconds(1);
+
+    // 应答为 bulk string 时有值，nil 或出错时为空
+    using Reply = std::optional<std::string>;
+
+    struct Request {
+        std::vector<std::string> args;
+        std::promise<Reply> promise;
+    };
+
+    struct CacheEntry {
+        SessionRecord record;
+        std::chrono::steady_clock::time_point fetched;
+    };
+
+    std::string m_host;
+    uint16_t m_port;
+    std::chrono::milliseconds m_cacheTtl;
+    size_t m_cacheCapacity;
+
+    std::mutex m_queueMutex;
+    std::condition_variable m_queueCond;
+    std::deque<Request> m_queue;
+    bool m_stopped = false;
+    std::thread m_thread;
+
+    // 以下仅由 I/O 线程访问
+    int m_fd = -1;
+    std::string m_readBuf;
+    size_t m_readPos = 0;
+    std::chrono::steady_clock::time_point m_nextConnect;
+
+    std::mutex m_cacheMutex;
+    std::unordered_map<std::string, CacheEntry> m_cache;
+
+    static std::string key(const std::string &sid) { return "sid:" + sid; }
+
+    static int64_t unixNow() {
+        return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    std::optional<SessionRecord> cacheLookup(const std::string &sid) {
+        std::lock_guard<std::mutex> lock(m_cacheMutex);
+        auto it = m_cache.find(sid);
+        if (it == m_cache.end()) {
+            return std::nullopt;
+        }
+        if (std::chrono::steady_clock::now() - it->second.fetched > m_cacheTtl) {
+            m_cache.erase(it);
+            return std::nullopt;
+        }
+        return it->second.record;
+    }
+
+    void cacheStore(const std::string &sid, const SessionRecord &record) {
+        if (m_cacheTtl.count() == 0) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(m_cacheMutex);
+        if (m_cache.size() >= m_cacheCapacity) {
+            m_cache.clear();
+        }
+        m_cache[sid] = {record, std::chrono::steady_clock::now()};
+    }
+
+    std::future<Reply> submit(std::vector<std::string> args) {
+        Request request{std::move(args), {}};
+        auto future = request.promise.get_future();
+        {
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            m_queue.push_back(std::move(request));
+        }
+        m_queueCond.notify_one();
+        return future;
+    }
+
+    static void appendCommand(std::string &out, const std::vector<std::string> &args) {
+        out += "*" + std::to_string(args.size()) + "\r\n";
+        for (const auto &arg: args) {
+            out += "$" + std::to_string(arg.size()) + "\r\n";
+            out += arg;
+            out += "\r\n";
+        }
+    }
+
+    void ioLoop() {
+        while (true) {
+            std::vector<Request> batch;
+            {
+                std::unique_lock<std::mutex> lock(m_queueMutex);
+                m_queueCond.wait(lock, [this] { return m_stopped || !m_queue.empty(); });
+                if (m_stopped && m_queue.empty()) {
+                    return;
+                }
+                while (!m_queue.empty() && batch.size() < kMaxBatch) {
+                    batch.push_back(std::move(m_queue.front()));
+                    m_queue.pop_front();
+                }
+            }
+            if (!execute(batch)) {
+                for (auto &request: batch) {
+                    request.promise.set_value(std::nullopt);
+                }
+            }
+        }
+    }
+
+    // 执行一批请求：连续的 GET 合并为一条 MGET，全部命令一次写出后按序读取应答
+    bool execute(std::vector<Request> &batch) {
+        if (!ensureConnected()) {
+            return false;
+        }
+
+        struct Command {
+            size_t first;
+            size_t count;
+            bool mget;
+        };
+        std::vector<Command> commands;
+        std::string out;
+        for (size_t i = 0; i < batch.size();) {
+            size_t j = i;
+            while (j < batch.size() && batch[j].args[0] == "GET") {
+                ++j;
+            }
+            if (j - i > 1) {
+                std::vector<std::string> args{"MGET"};
+                for (size_t k = i; k < j; ++k) {
+                    args.push_back(batch[k].args[1]);
+                }
+                appendCommand(out, args);
+                commands.push_back({i, j - i, true});
+                i = j;
+                continue;
+            }
+            appendCommand(out, batch[i].args);
+            commands.push_back({i, 1, false});
+            ++i;
+        }
+
+        if (!writeAll(out)) {
+            closeConnection();
+            return false;
+        }
+
+        size_t done = 0;
+        for (const auto &command: commands) {
+            std::vector<Reply> replies;
+            if (!readReply(replies)) {
+                closeConnection();
+                // 已收到应答的请求照常完成，其余按失败处理
+                for (size_t i = done; i < batch.size(); ++i) {
+                    batch[i].promise.set_value(std::nullopt);
+                }
+                return true;
+            }
+            if (command.mget && replies.size() != command.count) {
+                replies.assign(command.count, std::nullopt);
+            }
+            for (size_t k = 0; k < command.count; ++k) {
+                batch[command.first + k].promise.set_value(k < replies.size() ? replies[k] : std::nullopt);
+            }
+            done = command.first + command.count;
+        }
+        return true;
+    }
+
+    bool ensureConnected() {
+        if (m_fd != -1) {
+            return true;
+        }
+        auto now = std::chrono::steady_clock::now();
+        if (now < m_nextConnect) {
+            return false;
+        }
+        m_nextConnect = now + kReconnectDelay;
+
+        struct addrinfo hints {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        struct addrinfo *result = nullptr;
+        if (getaddrinfo(m_host.c_str(), std::to_string(m_port).c_str(), &hints, &result) != 0) {
+            spdlog::warn("[RespSessionStore] Cannot resolve {}", m_host);
+            return false;
+        }
+        for (auto *ai = result; ai; ai = ai->ai_next) {
+            int fd = ::socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+            if (fd == -1) {
+                continue;
+            }
+            if (::connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+                int one = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                struct timeval tv {kRequestTimeout.count(), 0};
+                setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+                setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+                m_fd = fd;
+                break;
+            }
+            ::close(fd);
+        }
+        freeaddrinfo(result);
+        if (m_fd == -1) {
+            spdlog::warn("[RespSessionStore] Cannot connect to {}:{}", m_host, m_port);
+            return false;
+        }
+        spdlog::info("[RespSessionStore] Connected to {}:{}", m_host, m_port);
+        return true;
+    }
+
+    void closeConnection() {
+        if (m_fd != -1) {
+            ::close(m_fd);
+            m_fd = -1;
+        }
+        m_readBuf.clear();
+        m_readPos = 0;
+    }
+
+    bool writeAll(const std::string &data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t n = ::send(m_fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) {
+                return false;
+            }
+            sent += n;
+        }
+        return true;
+    }
+
+    bool readLine(std::string &line) {
+        while (true) {
+            size_t end = m_readBuf.find("\r\n", m_readPos);
+            if (end != std::string::npos) {
+                line = m_readBuf.substr(m_readPos, end - m_readPos);
+                m_readPos = end + 2;
+                return true;
+            }
+            if (!fill()) {
+                return false;
+            }
+        }
+    }
+
+    bool readExact(size_t length, std::string &out) {
+        while (m_readBuf.size() - m_readPos < length + 2) {
+            if (!fill()) {
+                return false;
+            }
+        }
+        out = m_readBuf.substr(m_readPos, length);
+        m_readPos += length + 2;
+        return true;
+    }
+
+    bool fill() {
+        if (m_readPos > 0) {
+            m_readBuf.erase(0, m_readPos);
+            m_readPos = 0;
+        }
+        char chunk[16384];
+        ssize_t n = ::recv(m_fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) {
+            return false;
+        }
+        m_readBuf.append(chunk, n);
+        return true;
+    }
+
+    // 读取一条应答；数组应答展开为多个元素，其余应答为单个元素
+    bool readReply(std::vector<Reply> &replies) {
+        std::string line;
+        if (!readLine(line) || line.empty()) {
+            return false;
+        }
+        switch (line[0]) {
+            case '+':
+            case ':':
+                replies.emplace_back(line.substr(1));
+                return true;
+            case '-':
+                spdlog::warn("[RespSessionStore] Server error: {}", line.substr(1));
+                replies.emplace_back(std::nullopt);
+                return true;
+            case '$': {
+                long long length = std::atoll(line.c_str() + 1);
+                if (length < 0) {
+                    replies.emplace_back(std::nullopt);
+                    return true;
+                }
+                std::string value;
+                if (!readExact(static_cast<size_t>(length), value)) {
+                    return false;
+                }
+                replies.emplace_back(std::move(value));
+                return true;
+            }
+            case '*': {
+                long long count = std::atoll(line.c_str() + 1);
+                for (long long i = 0; i < count; ++i) {
+                    std::vector<Reply> element;
+                    if (!readReply(element)) {
+                        return false;
+                    }
+                    replies.push_back(element.empty() ? std::nullopt : std::move(element.front()));
+                }
+                return true;
+            }
+            default:
+                return false;
+        }
+    }
+};
@@ -0,0 +1,241 @@
+#pragma once
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "sitesnapshot.hpp"
+
+// 站点打包文件：整个站点一个文件，启动时一次 mmap 即可使用，耗时与文件数无关。布局（本机字节序）：
+//
+//   Header | 桶种子 uint32[seedCount] | 槽 uint32[slotCount] | Entry[fileCount] | 字符串区 | 按页对齐的文件内容
+//
+// 完美哈希的种子与槽直接存放在文件中，查找时就地使用；字符串区依次存放路径、MIME 类型、ETag 与预先序列化的
+// 响应头；每个文件的原始内容与 gzip 版本各自从页边界开始（不足一页的从缓存行边界开始）。由 sitepack 工具生成
+class SiteBundle : public SiteIndex {
+public:
+    static constexpr char kMagic[8] = {'S', 'I', 'T', 'E', 'B', 'N', 'D', 'L'};
+    static constexpr uint32_t kVersion = 1;
+    static constexpr uint64_t kPageSize = 4096;
+    // 不足一页的内容只按缓存行对齐，否则小文件多的站点打包后会膨胀数倍
+    static constexpr uint64_t kSmallAlignment = 64;
+
+    SiteBundle(const SiteBundle &) = delete;
+    SiteBundle &operator=(const SiteBundle &) = delete;
+
+    ~SiteBundle() override {
+        if (m_data) {
+            ::munmap(const_cast<char *>(m_data), m_size);
+        }
+    }
+
+    // 映射并校验文件头，不读取任何文件条目；失败时返回空
+    static std::shared_ptr<const SiteBundle> open(const std::string &path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            spdlog::error("[SiteBundle] Failed to open {}: {}", path, std::strerror(errno));
+            return nullptr;
+        }
+        struct stat st {};
+        void *data = MAP_FAILED;
+        if (::fstat(fd, &st) == 0 && static_cast<uint64_t>(st.st_size) >= sizeof(Header)) {
+            data = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            spdlog::error("[SiteBundle] Failed to map {}", path);
+            return nullptr;
+        }
+        std::shared_ptr<SiteBundle> bundle(new SiteBundle(static_cast<const char *>(data), st.st_size));
+        if (!bundle->valid()) {
+            spdlog::error("[SiteBundle] {} is not a valid site bundle (version {})", path, kVersion);
+            return nullptr;
+        }
+        return bundle;
+    }
+
+    // 把站点快照写成打包文件。先写入临时文件再改名，替换正在被服务进程映射的旧文件也是安全的
+    static bool write(const SiteSnapshot &snapshot, const std::string &path) {
+        const auto &files = snapshot.files();
+        const auto &seeds = snapshot.index().seeds();
+        const auto &slots = snapshot.index().slots();
+
+        Header header{};
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kVersion;
+        header.fileCount = static_cast<uint32_t>(files.size());
+        header.seedCount = static_cast<uint32_t>(seeds.size());
+        header.slotCount = static_cast<uint32_t>(slots.size());
+        header.seedsOffset = sizeof(Header);
+        header.slotsOffset = header.seedsOffset + seeds.size() * sizeof(uint32_t);
+        header.entriesOffset = align(header.slotsOffset + slots.size() * sizeof(uint32_t), alignof(Entry));
+
+        std::string strings;
+        std::vector<Entry> entries(files.size());
+        uint64_t stringsOffset = header.entriesOffset + entries.size() * sizeof(Entry);
+        auto addString = [&](std::string_view value, uint64_t &offset, uint32_t &length) {
+            offset = stringsOffset + strings.size();
+            length = static_cast<uint32_t>(value.size());
+            strings += value;
+        };
+        for (size_t i = 0; i < files.size(); ++i) {
+            addString(files[i].path, entries[i].path, entries[i].pathLength);
+            addString(files[i].mimeType, entries[i].mimeType, entries[i].mimeTypeLength);
+            addString(files[i].etag, entries[i].etag, entries[i].etagLength);
+            addString(files[i].head, entries[i].head, entries[i].headLength);
+        }
+        uint64_t offset = align(stringsOffset + strings.size(), kPageSize);
+        auto place = [&offset](size_t length) {
+            offset = align(offset, length >= kPageSize ? kPageSize : kSmallAlignment);
+            uint64_t start = offset;
+            offset += length;
+            return start;
+        };
+        for (size_t i = 0; i < files.size(); ++i) {
+            entries[i].contentLength = files[i].content.size();
+            entries[i].content = place(files[i].content.size());
+            entries[i].gzipLength = files[i].gzip.size();
+            entries[i].gzip = place(files[i].gzip.size());
+        }
+        header.size = align(offset, kPageSize);
+
+        std::string temp = path + ".tmp";
+        int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            spdlog::error("[SiteBundle] Failed to create {}: {}", temp, std::strerror(errno));
+            return false;
+        }
+        bool ok = writeAt(fd, 0, &header, sizeof(header)) &&
+                  writeAt(fd, header.seedsOffset, seeds.data(), seeds.size() * sizeof(uint32_t)) &&
+                  writeAt(fd, header.slotsOffset, slots.data(), slots.size() * sizeof(uint32_t)) &&
+                  writeAt(fd, header.entriesOffset, entries.data(), entries.size() * sizeof(Entry)) &&
+                  writeAt(fd, stringsOffset, strings.data(), strings.size());
+        for (size_t i = 0; ok && i < files.size(); ++i) {
+            ok = writeAt(fd, entries[i].content, files[i].content.data(), files[i].content.size()) &&
+                 writeAt(fd, entries[i].gzip, files[i].gzip.data(), files[i].gzip.size());
+        }
+        // 末尾的对齐空洞也要占位，否则映射时最后一页不完整
+        ok = ok && ::ftruncate(fd, static_cast<off_t>(header.size)) == 0 && ::fsync(fd) == 0;
+        ::close(fd);
+        if (!ok || ::rename(temp.c_str(), path.c_str()) != 0) {
+            spdlog::error("[SiteBundle] Failed to write {}: {}", path, std::strerror(errno));
+            ::unlink(temp.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    std::optional<StaticFile> find(std::string_view path) const override {
+        uint32_t index = PerfectHash::find(m_seeds, m_slots, path);
+        if (index >= m_entries.size()) {
+            return std::nullopt;
+        }
+        const Entry &entry = m_entries[index];
+        std::string_view entryPath = view(entry.path, entry.pathLength);
+        if (entryPath.data() == nullptr || entryPath != path) {
+            return std::nullopt;
+        }
+        StaticFile file{view(entry.content, entry.contentLength), view(entry.gzip, entry.gzipLength),
+                        view(entry.mimeType, entry.mimeTypeLength), view(entry.etag, entry.etagLength),
+                        view(entry.head, entry.headLength)};
+        // 条目越界说明文件已损坏，按未收录处理
+        if ((entry.contentLength && !file.content.data()) || (entry.gzipLength && !file.gzip.data()) ||
+            !file.mimeType.data() || !file.etag.data() || !file.head.data()) {
+            return std::nullopt;
+        }
+        return file;
+    }
+
+    size_t fileCount() const { return m_entries.size(); }
+
+    size_t size() const { return m_size; }
+
+private:
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t fileCount;
+        uint32_t seedCount;
+        uint32_t slotCount;
+        uint64_t seedsOffset;
+        uint64_t slotsOffset;
+        uint64_t entriesOffset;
+        uint64_t size;
+    };
+
+    // 偏移量均相对文件起点
+    struct Entry {
+        uint64_t path;
+        uint64_t mimeType;
+        uint64_t etag;
+        uint64_t head;
+        uint64_t content;
+        uint64_t contentLength;
+        uint64_t gzip;
+        uint64_t gzipLength;
+        uint32_t pathLength;
+        uint32_t mimeTypeLength;
+        uint32_t etagLength;
+        uint32_t headLength;
+    };
+
+    const char *m_data;
+    size_t m_size;
+    std::span<const uint32_t> m_seeds;
+    std::span<const uint32_t> m_slots;
+    std::span<const Entry> m_entries;
+
+    SiteBundle(const char *data, size_t size) : m_data(data), m_size(size) {}
+
+    static uint64_t align(uint64_t value, uint64_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+    static bool writeAt(int fd, uint64_t offset, const void *data, size_t size) {
+        const char *p = static_cast<const char *>(data);
+        while (size > 0) {
+            ssize_t n = ::pwrite(fd, p, size, static_cast<off_t>(offset));
+            if (n <= 0) {
+                return false;
+            }
+            p += n;
+            offset += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    bool inBounds(uint64_t offset, uint64_t length) const { return offset <= m_size && length <= m_size - offset; }
+
+    // 越界时返回空指针的视图
+    std::string_view view(uint64_t offset, uint64_t length) const {
+        if (!inBounds(offset, length)) {
+            return {};
+        }
+        return {m_data + offset, length};
+    }
+
+    bool valid() {
+        Header header;
+        std::memcpy(&header, m_data, sizeof(header));
+        if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion ||
+            header.size != m_size || header.seedCount == 0 || header.slotCount == 0 ||
+            header.fileCount > header.slotCount || header.seedsOffset % alignof(uint32_t) != 0 ||
+            header.slotsOffset % alignof(uint32_t) != 0 || header.entriesOffset % alignof(Entry) != 0 ||
+            !inBounds(header.seedsOffset, uint64_t(header.seedCount) * sizeof(uint32_t)) ||
+            !inBounds(header.slotsOffset, uint64_t(header.slotCount) * sizeof(uint32_t)) ||
+            !inBounds(header.entriesOffset, uint64_t(header.fileCount) * sizeof(Entry))) {
+            return false;
+        }
+        m_seeds = {reinterpret_cast<const uint32_t *>(m_data + header.seedsOffset), header.seedCount};
+        m_slots = {reinterpret_cast<const uint32_t *>(m_data + header.slotsOffset), header.slotCount};
+        m_entries = {reinterpret_cast<const Entry *>(m_data + header.entriesOffset), header.fileCount};
+        return true;
+    }
+};
@@ -0,0 +1,451 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// server.hpp 须先于 gzip.hpp 引入
+#include "server.hpp"
+#include "gzip.hpp"
+
+// 静态文件响应的 Cache-Control
+inline constexpr std::string_view kStaticCacheControl = "no-cache";
+
+// 静态文件 200 响应的 ETag 与预先序列化的头部，文件缓存、站点快照与站点打包文件共用。
+// ETag 由修改时间与大小生成（与 nginx 相同的形式）
+inline std::string formatFileEtag(int64_t mtime, uint64_t size) {
+    return fmt::format("\"{:x}-{:x}\"", static_cast<uint64_t>(mtime), size);
+}
+
+inline std::string formatFileHead(std::string_view mimeType, uint64_t size, std::string_view etag,
+                                  std::string_view cacheControl) {
+    return fmt::format("HTTP/1.1 200 OK\r\nContent-Type: {}\r\nContent-Length: {}\r\nETag: {}\r\nCache-Control: {}\r\n",
+                       mimeType, size, etag, cacheControl);
+}
+
+// 最小完美哈希（CHD：先分桶，再为每个桶找一个让桶内所有键落到空槽的种子）。
+// 查找只需一次哈希、两次数组访问，不会冲突；不在键集合中的键也会落到某个槽，调用方须比对键
+class PerfectHash {
+public:
+    static constexpr uint32_t kEmpty = UINT32_MAX;
+
+    // 键须互不相同；失败（极少见）时返回 false
+    bool build(const std::vector<std::string_view> &keys) {
+        size_t count = keys.size();
+        m_slots.assign(std::max<size_t>(1, count + count / 4), kEmpty);
+        m_seeds.assign(std::max<size_t>(1, count / 4), 0);
+
+        std::vector<std::vector<uint32_t>> buckets(m_seeds.size());
+        std::vector<uint64_t> hashes(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            hashes[i] = hash(keys[i]);
+            buckets[bucketOf(hashes[i], m_seeds.size())].push_back(i);
+        }
+        // 大桶先放，空槽多时更容易找到种子
+        std::vector<uint32_t> order(buckets.size());
+        for (uint32_t i = 0; i < order.size(); ++i) {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(),
+                  [&](uint32_t a, uint32_t b) { return buckets[a].size() > buckets[b].size(); });
+
+        std::vector<size_t> placed;
+        for (uint32_t bucket: order) {
+            const auto &members = buckets[bucket];
+            if (members.empty()) {
+                break;
+            }
+            uint32_t seed = 0;
+            for (; seed < kMaxSeed; ++seed) {
+                placed.clear();
+                for (uint32_t key: members) {
+                    size_t slot = slotOf(hashes[key], seed, m_slots.size());
+                    if (m_slots[slot] != kEmpty || std::find(placed.begin(), placed.end(), slot) != placed.end()) {
+                        break;
+                    }
+                    placed.push_back(slot);
+                }
+                if (placed.size() == members.size()) {
+                    break;
+                }
+            }
+            if (seed == kMaxSeed) {
+                return false;
+            }
+            m_seeds[bucket] = seed;
+            for (size_t i = 0; i < members.size(); ++i) {
+                m_slots[placed[i]] = members[i];
+            }
+        }
+        return true;
+    }
+
+    // 返回候选键的下标，kEmpty 表示一定不存在
+    uint32_t find(std::string_view key) const { return find(m_seeds, m_slots, key); }
+
+    // 直接在外部数组（如 mmap 的打包文件）上查找
+    static uint32_t find(std::span<const uint32_t> seeds, std::span<const uint32_t> slots, std::string_view key) {
+        uint64_t h = hash(key);
+        return slots[slotOf(h, seeds[bucketOf(h, seeds.size())], slots.size())];
+    }
+
+    const std::vector<uint32_t> &seeds() const { return m_seeds; }
+
+    const std::vector<uint32_t> &slots() const { return m_slots; }
+
+private:
+    static constexpr uint32_t kMaxSeed = 1 << 20;
+
+    std::vector<uint32_t> m_seeds;
+    std::vector<uint32_t> m_slots;
+
+    // FNV-1a
+    static uint64_t hash(std::string_view key) {
+        uint64_t h = 0xcbf29ce484222325ULL;
+        for (unsigned char c: key) {
+            h = (h ^ c) * 0x100000001b3ULL;
+        }
+        return h;
+    }
+
+    // splitmix64 的末尾混合
+    static uint64_t mix(uint64_t x) {
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    static size_t bucketOf(uint64_t h, size_t buckets) { return mix(h) % buckets; }
+
+    static size_t slotOf(uint64_t h, uint32_t seed, size_t slots) {
+        return mix(h ^ (static_cast<uint64_t>(seed) * 0x9e3779b97f4a7c15ULL)) % slots;
+    }
+};
+
+// 快照或打包文件中一个文件的只读视图，内存由索引对象持有
+struct StaticFile {
+    std::string_view content;
+    std::string_view gzip; // 预压缩版本，为空表示不值得压缩
+    std::string_view mimeType;
+    std::string_view etag;
+    std::string_view head;
+};
+
+// 按规范路径查找静态文件的只读索引
+class SiteIndex {
+public:
+    virtual ~SiteIndex() = default;
+
+    virtual std::optional<StaticFile> find(std::string_view path) const = 0;
+};
+
+// 启动时预热的站点快照：遍历站点根目录，把每个文件的内容、预压缩的 gzip 版本、ETag 和预先序列化的
+// 响应头放进一个只读结构，以规范路径为键建立完美哈希。小文件读入一整块连续内存，大文件直接 mmap，
+// 避免几十万个映射超出 vm.max_map_count。快照建成后不再修改，多线程无锁读取，响应体直接引用其中的内存。
+// 部署时应以改名方式替换文件：原地截断已映射的大文件会让正在发送它的线程收到 SIGBUS
+class SiteSnapshot : public SiteIndex {
+public:
+    struct File {
+        std::string path;
+        std::string_view content;
+        std::string gzip; // 为空表示不值得压缩
+        std::string_view mimeType;
+        std::string etag;
+        std::string head;
+    };
+
+    struct Stats {
+        size_t files = 0;
+        size_t bytes = 0;
+        size_t gzipBytes = 0;
+        size_t mapped = 0;
+        std::chrono::milliseconds elapsed{0};
+    };
+
+    SiteSnapshot(const SiteSnapshot &) = delete;
+    SiteSnapshot &operator=(const SiteSnapshot &) = delete;
+
+    ~SiteSnapshot() override {
+        for (auto &mapping: m_mappings) {
+            ::munmap(mapping.first, mapping.second);
+        }
+    }
+
+    // 遍历 root 建立快照，按 CPU 核数并行读取与压缩；失败时返回空
+    static std::shared_ptr<const SiteSnapshot> build(const std::string &root, std::string_view cacheControl) {
+        auto start = std::chrono::steady_clock::now();
+        std::shared_ptr<SiteSnapshot> snapshot(new SiteSnapshot);
+        std::vector<Source> sources;
+        std::error_code ec;
+        for (std::filesystem::recursive_directory_iterator it(root, ec), end; !ec && it != end; it.increment(ec)) {
+            struct stat st {};
+            if (::stat(it->path().c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+                continue;
+            }
+            File file;
+            file.path = "/" + it->path().lexically_relative(root).string();
+            sources.push_back({it->path().string(), static_cast<uint64_t>(st.st_size), static_cast<int64_t>(st.st_mtime)});
+            snapshot->m_files.push_back(std::move(file));
+        }
+        if (ec) {
+            spdlog::error("[SiteSnapshot] Failed to walk {}: {}", root, ec.message());
+            return nullptr;
+        }
+
+        // 小文件在连续内存中的位置
+        size_t packedSize = 0;
+        for (auto &source: sources) {
+            if (source.size < kMapThreshold) {
+                source.offset = packedSize;
+                packedSize += source.size;
+            }
+        }
+        snapshot->m_packed = std::make_unique<char[]>(std::max<size_t>(packedSize, 1));
+
+        // 读不了的文件不收录，请求时回退到逐文件缓存
+        std::atomic<size_t> next{0};
+        std::mutex mappingMutex;
+        auto worker = [&] {
+            for (size_t i = next.fetch_add(1); i < sources.size(); i = next.fetch_add(1)) {
+                if (!snapshot->load(sources[i], snapshot->m_files[i], cacheControl, mappingMutex)) {
+                    snapshot->m_files[i].path.clear();
+                }
+            }
+        };
+        std::vector<std::thread> workers;
+        size_t threads = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, 16);
+        for (size_t i = 1; i < threads; ++i) {
+            workers.emplace_back(worker);
+        }
+        worker();
+        for (auto &thread: workers) {
+            thread.join();
+        }
+        std::erase_if(snapshot->m_files, [](const File &file) { return file.path.empty(); });
+
+        std::vector<std::string_view> keys;
+        keys.reserve(snapshot->m_files.size());
+        for (const auto &file: snapshot->m_files) {
+            keys.push_back(file.path);
+        }
+        if (!snapshot->m_index.build(keys)) {
+            spdlog::error("[SiteSnapshot] Failed to build the path index for {}", root);
+            return nullptr;
+        }
+
+        Stats &stats = snapshot->m_stats;
+        stats.files = snapshot->m_files.size();
+        stats.mapped = snapshot->m_mappings.size();
+        for (const auto &file: snapshot->m_files) {
+            stats.bytes += file.content.size();
+            stats.gzipBytes += file.gzip.size();
+        }
+        stats.elapsed =
+                std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        return snapshot;
+    }
+
+    std::optional<StaticFile> find(std::string_view path) const override {
+        uint32_t index = m_index.find(path);
+        if (index == PerfectHash::kEmpty || m_files[index].path != path) {
+            return std::nullopt;
+        }
+        const File &file = m_files[index];
+        return StaticFile{file.content, file.gzip, file.mimeType, file.etag, file.head};
+    }
+
+    const Stats &stats() const { return m_stats; }
+
+    const std::vector<File> &files() const { return m_files; }
+
+    const PerfectHash &index() const { return m_index; }
+
+private:
+    // 不小于该大小的文件直接 mmap
+    static constexpr uint64_t kMapThreshold = 64 * 1024;
+    // 太小的文件压缩后省不了多少，不预压缩
+    static constexpr uint64_t kMinGzipSize = 256;
+
+    struct Source {
+        std::string fullPath;
+        uint64_t size;
+        int64_t mtime;
+        size_t offset = 0;
+    };
+
+    std::vector<File> m_files;
+    PerfectHash m_index;
+    std::unique_ptr<char[]> m_packed;
+    std::vector<std::pair<void *, size_t>> m_mappings;
+    Stats m_stats;
+
+    SiteSnapshot() = default;
+
+    static bool compressible(std::string_view mimeType) {
+        return mimeType.starts_with("text/") || mimeType.find("javascript") != std::string_view::npos ||
+               mimeType.find("json") != std::string_view::npos || mimeType.find("xml") != std::string_view::npos;
+    }
+
+    bool load(const Source &source, File &file, std::string_view cacheControl, std::mutex &mappingMutex) {
+        int fd = ::open(source.fullPath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            spdlog::warn("[SiteSnapshot] Failed to open {}: {}", source.fullPath, std::strerror(errno));
+            return false;
+        }
+        bool ok = true;
+        if (source.size == 0) {
+            file.content = {};
+        } else if (source.size < kMapThreshold) {
+            // 文件在遍历之后变短时只保留实际读到的部分，之后的 inotify 事件会触发重建
+            char *data = m_packed.get() + source.offset;
+            size_t done = 0;
+            while (done < source.size) {
+                ssize_t n = ::pread(fd, data + done, source.size - done, static_cast<off_t>(done));
+                if (n <= 0) {
+                    ok = n == 0;
+                    break;
+                }
+                done += n;
+            }
+            file.content = std::string_view(data, done);
+        } else {
+            void *data = ::mmap(nullptr, source.size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) {
+                ok = false;
+            } else {
+                std::lock_guard<std::mutex> lock(mappingMutex);
+                m_mappings.emplace_back(data, source.size);
+                file.content = std::string_view(static_cast<const char *>(data), source.size);
+            }
+        }
+        ::close(fd);
+        if (!ok) {
+            spdlog::warn("[SiteSnapshot] Failed to read {}: {}", source.fullPath, std::strerror(errno));
+            return false;
+        }
+
+        file.mimeType = getMimeType(file.path);
+        file.etag = formatFileEtag(source.mtime, file.content.size());
+        file.head = formatFileHead(file.mimeType, file.content.size(), file.etag, cacheControl);
+        if (file.content.size() >= kMinGzipSize && compressible(file.mimeType)) {
+            if (!GzipHandler::compress(file.content, file.gzip) || file.gzip.size() >= file.content.size()) {
+                file.gzip.clear();
+            }
+        }
+        return true;
+    }
+};
+
+// 当前快照的持有者。读取方每个请求原子地取一次快照引用，只持有到响应发出为止，线程不缓存引用，
+// 替换或过期后旧快照在最后一个进行中的请求结束时释放，空闲的工作线程不会让它继续占用内存。
+// 站点文件变化时立即丢弃当前快照，读取方回退到逐文件缓存，后台线程稍后重建新快照再原子替换
+class SiteSnapshotStore {
+public:
+    SiteSnapshotStore(std::string root, std::string cacheControl) :
+        m_root(std::move(root)), m_cacheControl(std::move(cacheControl)) {
+        rebuild();
+        m_thread = std::thread(&SiteSnapshotStore::rebuildLoop, this);
+    }
+
+    SiteSnapshotStore(const SiteSnapshotStore &) = delete;
+    SiteSnapshotStore &operator=(const SiteSnapshotStore &) = delete;
+
+    ~SiteSnapshotStore() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopped = true;
+        }
+        m_cond.notify_all();
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+    }
+
+    // 过期或尚未建成时返回空
+    std::shared_ptr<const SiteSnapshot> current() const { return m_snapshot.load(std::memory_order_acquire); }
+
+    // 站点文件发生变化
+    void invalidate() {
+        std::shared_ptr<const SiteSnapshot> old;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_changes;
+            old = m_snapshot.exchange(nullptr, std::memory_order_acq_rel);
+        }
+        m_cond.notify_all();
+        // 最后一个引用时在锁外解除映射
+        old.reset();
+    }
+
+private:
+    // 连续的变化（如部署时批量复制）合并为一次重建
+    static constexpr std::chrono::milliseconds kRebuildDelay{500};
+
+    std::string m_root;
+    std::string m_cacheControl;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::atomic<std::shared_ptr<const SiteSnapshot>> m_snapshot;
+    uint64_t m_changes = 0;
+    bool m_stopped = false;
+    std::thread m_thread;
+
+    void rebuild() {
+        uint64_t changes;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            changes = m_changes;
+        }
+        auto snapshot = SiteSnapshot::build(m_root, m_cacheControl);
+        if (!snapshot) {
+            spdlog::warn("[SiteSnapshot] Pre-warm of {} failed, serving from the file cache", m_root);
+            return;
+        }
+        const auto &stats = snapshot->stats();
+        spdlog::info("[SiteSnapshot] Loaded {} file(s) from {} in {} ms: {} KB, {} KB gzip, {} mapped", stats.files,
+                     m_root, stats.elapsed.count(), stats.bytes / 1024, stats.gzipBytes / 1024, stats.mapped);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // 建立期间又有变化时这份快照已经过时，丢弃并等下一次重建
+        if (m_changes == changes) {
+            m_snapshot.store(std::move(snapshot), std::memory_order_release);
+        }
+    }
+
+    void rebuildLoop() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        // 构造时的首次建立对应第 0 次变化
+        uint64_t built = 0;
+        while (!m_stopped) {
+            m_cond.wait(lock, [&] { return m_stopped || m_changes != built; });
+            if (m_stopped) {
+                break;
+            }
+            m_cond.wait_for(lock, kRebuildDelay, [&] { return m_stopped; });
+            if (m_stopped) {
+                break;
+            }
+            built = m_changes;
+            lock.unlock();
+            rebuild();
+            lock.lock();
+        }
+    }
+};
@@ -12,7 +12,13 @@
 #include <openssl/ssl.h>
 #include <openssl/err.h>
 #include <address.hpp>
+#include <bufferpool.hpp>
 #include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sstream>
+#include <cerrno>
 
 class Socket : public std::enable_shared_from_this<Socket> {
 public:
@@ -62,7 +68,29 @@ public:
         return server;
     }
 
+    // 接管一个已处于监听状态的套接字（热重载时由旧进程传入）
+    static ptr Adopt(int sockfd, bool tls) {
+        ptr server(new Socket(sockfd));
+        server->m_localAddress = Address::getLocalAddress(sockfd);
+        if (server->m_localAddress) {
+            server->m_family = server->m_localAddress->getFamily();
+        }
+        server->m_type = SOCK_STREAM;
+        if (tls) {
+            server->initSSL();
+        }
+        return server;
+    }
+
     bool bind(Address::ptr address) {
+        // 上次运行留下的 UNIX 套接字文件会让 bind 失败，只删除套接字类型的文件
+        if (address->getFamily() == AF_UNIX) {
+            std::string path = static_cast<const UnixAddress &>(*address).getPath();
+            struct stat st {};
+            if (!path.empty() && ::lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+                ::unlink(path.c_str());
+            }
+        }
         if (::bind(m_sockfd, address->getAddress(), address->getLength()) == -1) {
             return false;
         }
@@ -70,6 +98,12 @@ public:
         return true;
     }
 
+    // 为 false 时 IPv6 监听同时接受 IPv4 连接（双栈），需在 bind 之前调用
+    bool setV6Only(bool v6only) {
+        int value = v6only ? 1 : 0;
+        return setsockopt(IPPROTO_IPV6, IPV6_V6ONLY, &value, sizeof(value));
+    }
+
     bool listen(int backlog = SOMAXCONN) {
         if (::listen(m_sockfd, backlog) == -1) {
             return false;
@@ -80,31 +114,118 @@ public:
     ptr accept() {
         struct sockaddr_storage addr;
         socklen_t len = sizeof(addr);
-        int sock = ::accept(m_sockfd, reinterpret_cast<struct sockaddr*>(&addr), &len);
+        int sock = ::accept4(m_sockfd, reinterpret_cast<struct sockaddr*>(&addr), &len, SOCK_CLOEXEC);
         if (sock == -1) {
             return nullptr;
         }
 
         ptr client(new Socket(sock));
-        client->m_remoteAddress = Address::ptr(new IPv4Address(*reinterpret_cast<struct sockaddr_in*>(&addr)));
+        client->m_family = m_family;
+        client->m_type = m_type;
+        client->m_proxyProtocol = m_proxyProtocol;
+        client->m_remoteAddress = Address::create(reinterpret_cast<struct sockaddr*>(&addr), len);
         client->m_localAddress = Address::getLocalAddress(sock);
         client->m_isConnected = true;
+        // 响应都是整块写出的，关闭 Nagle：HTTP/2 同一连接上的后续响应不必等对端的延迟确认
+        if (m_family != AF_UNIX) {
+            int enable = 1;
+            client->setsockopt(IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        }
 
         if (ssl) {
+            // 握手推迟到 handshake() 中由工作线程完成，避免慢客户端阻塞 accept 线程
             client->ssl = SSL_new(ctx);
             SSL_set_fd(client->ssl, sock);
-            if (SSL_accept(client->ssl) <= 0) {
-                SSL_shutdown(client->ssl);
-                SSL_free(client->ssl);
-                client->ssl = nullptr;
-                ::close(sock);
-                return nullptr;
-            }
         }
 
         return client;
     }
 
+    // 监听套接字上设置后，接受的每个连接都必须以 PROXY 协议头开始（前面是四层负载均衡器）
+    void setProxyProtocol(bool enabled) {
+        m_proxyProtocol = enabled;
+    }
+
+    bool expectsProxyHeader() const {
+        return m_proxyProtocol;
+    }
+
+    // 读取 PROXY 协议 v1/v2 头部，须在 TLS 握手之前调用。只从内核读取头部本身的字节，
+    // 之后的 TLS ClientHello 或 HTTP 请求原样留给后续读取；均衡器与客户端之间没有额外往返。
+    // 成功后远端地址换成头部中的客户端地址（LOCAL / UNKNOWN 时保持不变），格式错误返回 false
+    bool readProxyHeader() {
+        static constexpr char kV2Signature[] = "\r\n\r\n\0\r\nQUIT\n";
+        char head[16];
+        // "PROXY " 与 v2 签名的前 8 字节都不会越过最短的头部（v1 的 "PROXY UNKNOWN\r\n" 共 15 字节）
+        if (!recvExact(head, 8)) {
+            return false;
+        }
+        if (std::memcmp(head, kV2Signature, 8) == 0) {
+            if (!recvExact(head + 8, 8) || std::memcmp(head, kV2Signature, 12) != 0 ||
+                (static_cast<uint8_t>(head[12]) >> 4) != 2) {
+                return false;
+            }
+            size_t length = (static_cast<uint8_t>(head[14]) << 8) | static_cast<uint8_t>(head[15]);
+            std::string payload(length, '\0');
+            if (!recvExact(payload.data(), length)) {
+                return false;
+            }
+            return applyProxyV2(static_cast<uint8_t>(head[12]) & 0x0f, static_cast<uint8_t>(head[13]), payload);
+        }
+        if (std::memcmp(head, "PROXY ", 6) != 0) {
+            return false;
+        }
+        // v1 最长 107 字节，以 CRLF 结尾。先窥视，只取到行尾为止；一次没收全时已收到的部分都属于头部，直接取走
+        std::string line(head, 8);
+        while (line.find('\n') == std::string::npos) {
+            char buffer[kProxyV1MaxLength];
+            size_t room = kProxyV1MaxLength - line.size();
+            ssize_t n = room > 0 ? ::recv(m_sockfd, buffer, room, MSG_PEEK) : 0;
+            if (n <= 0) {
+                return false;
+            }
+            const char *newline = static_cast<const char *>(std::memchr(buffer, '\n', n));
+            size_t take = newline ? newline - buffer + 1 : static_cast<size_t>(n);
+            if (!recvExact(buffer, take)) {
+                return false;
+            }
+            line.append(buffer, take);
+        }
+        return applyProxyV1(line);
+    }
+
+    // 服务端 TLS 握手，非 TLS 连接直接返回 true
+    bool handshake() {
+        if (!ssl) {
+            return true;
+        }
+        if (SSL_accept(ssl) <= 0) {
+            SSL_free(ssl);
+            ssl = nullptr;
+            // 定时器线程可能同时对该描述符调用 shutdown()：这里只断开连接，描述符留到析构时关闭，
+            // 不会出现描述符被关闭后号码被新连接复用、定时器却 shutdown 了新连接的情况
+            ::shutdown(m_sockfd, SHUT_RDWR);
+            return false;
+        }
+        return true;
+    }
+
+    bool setNonBlocking(bool enable) {
+        int flags = fcntl(m_sockfd, F_GETFL, 0);
+        if (flags == -1) {
+            return false;
+        }
+        flags = enable ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+        return fcntl(m_sockfd, F_SETFL, flags) != -1;
+    }
+
+    // 中断阻塞在该连接上的读写（可从其他线程调用），用于超时断开
+    void shutdown() {
+        if (m_sockfd != -1) {
+            ::shutdown(m_sockfd, SHUT_RDWR);
+        }
+    }
+
     bool send(const void* buffer, size_t length) {
         if (ssl) {
             int bytes_sent = SSL_write(ssl, buffer, length);
@@ -115,6 +236,38 @@ public:
         }
     }
 
+    // 聚集写：多段数据一次系统调用发出，明文连接上响应体不必先复制进发送缓冲区；
+    // TLS 连接逐段写。会修改 iov 以跳过部分写出的内容
+    bool sendv(struct iovec* iov, int count) {
+        if (ssl) {
+            for (int i = 0; i < count; ++i) {
+                if (iov[i].iov_len > 0 && !send(iov[i].iov_base, iov[i].iov_len)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        while (count > 0) {
+            ssize_t n = ::writev(m_sockfd, iov, count);
+            if (n == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            while (count > 0 && static_cast<size_t>(n) >= iov->iov_len) {
+                n -= iov->iov_len;
+                ++iov;
+                --count;
+            }
+            if (count > 0) {
+                iov->iov_base = static_cast<char*>(iov->iov_base) + n;
+                iov->iov_len -= n;
+            }
+        }
+        return true;
+    }
+
     bool recv(void* buffer, size_t length, size_t* received = nullptr) {
         if (ssl) {
             int bytes_received = SSL_read(ssl, buffer, length);
@@ -137,7 +290,27 @@ public:
         }
     }
     
+    // 读入连接的接收缓冲区，可写空间不足时先向池中借用或换用更大的缓冲区
+    bool recv(RecvBuffer& buffer, size_t* received = nullptr) {
+        if (buffer.writableSize() < kMinRecvSize) {
+            buffer.reserve(buffer.size() + kMinRecvSize);
+        }
+        size_t n = 0;
+        if (!recv(buffer.writable(), buffer.writableSize(), &n)) {
+            return false;
+        }
+        buffer.commit(n);
+        if (received) {
+            *received = n;
+        }
+        return true;
+    }
+
     bool enableKeepAlive(int timeout = 60, int interval = 10, int probes = 3) {
+        // UNIX 域套接字没有 TCP 保活
+        if (m_family == AF_UNIX) {
+            return true;
+        }
         // 启用 TCP Keep-Alive
         int enable = 1;
         if (!setsockopt(SOL_SOCKET, SO_KEEPALIVE, &enable, sizeof(enable))) {
@@ -171,6 +344,54 @@ public:
         return bytes_sent != -1;
     }
 
+    // 等待可读数据，SSL 内部已缓冲的数据也视为可读
+    bool waitReadable(int timeoutMs) {
+        if (ssl && SSL_has_pending(ssl)) {
+            return true;
+        }
+        struct pollfd pfd = {m_sockfd, POLLIN, 0};
+        return ::poll(&pfd, 1, timeoutMs) > 0;
+    }
+
+    // 同时等待另一个描述符（如 eventfd），otherReady 表示它是否可读；超时或出错返回 false
+    bool waitReadable(int timeoutMs, int otherFd, bool &otherReady) {
+        otherReady = false;
+        if (ssl && SSL_has_pending(ssl)) {
+            return true;
+        }
+        struct pollfd pfds[2] = {{m_sockfd, POLLIN, 0}, {otherFd, POLLIN, 0}};
+        if (::poll(pfds, 2, timeoutMs) <= 0) {
+            return false;
+        }
+        otherReady = pfds[1].revents & POLLIN;
+        return true;
+    }
+
+    // 在 TLS 握手时通过 ALPN 通告 h2，客户端不支持时回落到 http/1.1
+    void enableHttp2() {
+        if (ctx) {
+            SSL_CTX_set_alpn_select_cb(ctx, &Socket::selectAlpn, nullptr);
+        }
+    }
+
+    std::string getAlpnProtocol() const {
+        if (!ssl) {
+            return "";
+        }
+        const unsigned char *proto = nullptr;
+        unsigned int len = 0;
+        SSL_get0_alpn_selected(ssl, &proto, &len);
+        return proto ? std::string(reinterpret_cast<const char *>(proto), len) : "";
+    }
+
+    int getFamily() const {
+        return m_family;
+    }
+
+    bool isTls() const {
+        return ctx != nullptr || ssl != nullptr;
+    }
+
     int getSocket() const {
         return m_sockfd;
     }
@@ -195,7 +416,7 @@ public:
 
 private:
     void newSock() {
-        m_sockfd = socket(m_family, m_type, m_protocol);
+        m_sockfd = socket(m_family, m_type | SOCK_CLOEXEC, m_protocol);
         if (m_sockfd == -1) {
             throw std::runtime_error("Failed to create socket");
         }
@@ -213,6 +434,16 @@ private:
         return true;
     }
 
+    static int selectAlpn(SSL *, const unsigned char **out, unsigned char *outlen, const unsigned char *in,
+                          unsigned int inlen, void *) {
+        static const unsigned char protos[] = "\x02h2\x08http/1.1";
+        if (SSL_select_next_proto(const_cast<unsigned char **>(out), outlen, protos, sizeof(protos) - 1, in, inlen) !=
+            OPENSSL_NPN_NEGOTIATED) {
+            return SSL_TLSEXT_ERR_NOACK;
+        }
+        return SSL_TLSEXT_ERR_OK;
+    }
+
     bool initSSL() {
         SSL_library_init();
         OpenSSL_add_all_algorithms();
@@ -222,6 +453,8 @@ private:
         if (!ctx) {
             return false;
         }
+        // 连接空闲时释放 OpenSSL 内部的读写缓冲区（每条约 34KB），与空闲连接不持有接收缓冲区的做法一致
+        SSL_CTX_set_mode(ctx, SSL_MODE_RELEASE_BUFFERS);
 
         if (SSL_CTX_use_certificate_file(ctx, "../cert.pem", SSL_FILETYPE_PEM) <= 0) {
             return false;
@@ -236,11 +469,85 @@ private:
         return true;
     }
 
-    void close() {
-        if (m_sockfd != -1) {
-            ::close(m_sockfd);
-            m_sockfd = -1;
+    static constexpr size_t kProxyV1MaxLength = 107;
+
+    bool recvExact(char *buffer, size_t length) {
+        while (length > 0) {
+            ssize_t n = ::recv(m_sockfd, buffer, length, 0);
+            if (n <= 0) {
+                if (n == -1 && errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            buffer += n;
+            length -= n;
+        }
+        return true;
+    }
+
+    // "PROXY TCP4 源地址 目的地址 源端口 目的端口\r\n"
+    bool applyProxyV1(const std::string &line) {
+        if (line.size() < 2 || line.compare(line.size() - 2, 2, "\r\n") != 0) {
+            return false;
+        }
+        std::istringstream ss(line.substr(6, line.size() - 8));
+        std::string protocol, source, destination;
+        int sourcePort = -1, destinationPort = -1;
+        ss >> protocol;
+        if (protocol == "UNKNOWN") {
+            return true;
+        }
+        if ((protocol != "TCP4" && protocol != "TCP6") || !(ss >> source >> destination >> sourcePort >> destinationPort) ||
+            sourcePort < 0 || sourcePort > 65535 || destinationPort < 0 || destinationPort > 65535) {
+            return false;
+        }
+        std::string sourceText = protocol == "TCP4" ? source + ":" + std::to_string(sourcePort)
+                                                    : "[" + source + "]:" + std::to_string(sourcePort);
+        std::string destinationText = protocol == "TCP4" ? destination + ":" + std::to_string(destinationPort)
+                                                         : "[" + destination + "]:" + std::to_string(destinationPort);
+        Address::ptr remote = Address::parse(sourceText);
+        Address::ptr local = Address::parse(destinationText);
+        if (!remote || !local) {
+            return false;
         }
+        m_remoteAddress = remote;
+        m_localAddress = local;
+        return true;
+    }
+
+    // 二进制头部：命令（LOCAL=0 / PROXY=1）、地址族与传输协议、地址块；地址块之后的 TLV 忽略
+    bool applyProxyV2(uint8_t command, uint8_t family, const std::string &payload) {
+        if (command == 0x0) {
+            return true;
+        }
+        if (command != 0x1) {
+            return false;
+        }
+        if (family == 0x11 && payload.size() >= 12) {
+            struct sockaddr_in source {}, destination {};
+            source.sin_family = destination.sin_family = AF_INET;
+            std::memcpy(&source.sin_addr, payload.data(), 4);
+            std::memcpy(&destination.sin_addr, payload.data() + 4, 4);
+            std::memcpy(&source.sin_port, payload.data() + 8, 2);
+            std::memcpy(&destination.sin_port, payload.data() + 10, 2);
+            m_remoteAddress = std::make_shared<IPv4Address>(source);
+            m_localAddress = std::make_shared<IPv4Address>(destination);
+            return true;
+        }
+        if (family == 0x21 && payload.size() >= 36) {
+            struct sockaddr_in6 source {}, destination {};
+            source.sin6_family = destination.sin6_family = AF_INET6;
+            std::memcpy(&source.sin6_addr, payload.data(), 16);
+            std::memcpy(&destination.sin6_addr, payload.data() + 16, 16);
+            std::memcpy(&source.sin6_port, payload.data() + 32, 2);
+            std::memcpy(&destination.sin6_port, payload.data() + 34, 2);
+            m_remoteAddress = std::make_shared<IPv6Address>(source);
+            m_localAddress = std::make_shared<IPv6Address>(destination);
+            return true;
+        }
+        // UNSPEC、UNIX 域或 UDP：保留实际的对端地址
+        return family == 0x00 || (family & 0x0f) != 0x1 || (family >> 4) == 0x3;
     }
 
     int m_sockfd = -1;
@@ -248,8 +555,11 @@ private:
     int m_type;
     int m_protocol;
     bool m_isConnected;
+    bool m_proxyProtocol = false;
     Address::ptr m_localAddress;
     Address::ptr m_remoteAddress;
     SSL_CTX* ctx = nullptr;
     SSL* ssl = nullptr;
+
+    static constexpr size_t kMinRecvSize = 2048;
 };
\ No newline at end of file
@@ -0,0 +1,233 @@
+#pragma once
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <poll.h>
+#include <shared_mutex>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+
+#include "metrics.hpp"
+
+// 静态文件的元数据缓存：按规范化后的请求路径记录“不存在 / 目录 / 普通文件（修改时间、大小）”，
+// 命中时不调用 stat，重复的 404 同样命中。条目有较短的有效期作为兜底；
+// inotify 监视整个站点目录树，文件或目录变化时立即失效对应条目，并通知内容缓存一起丢弃
+class StatCache {
+public:
+    enum class Kind : uint8_t { Missing, Directory, File };
+
+    struct Entry {
+        Kind kind = Kind::Missing;
+        int64_t mtime = 0;
+        uint64_t size = 0;
+    };
+
+    // 路径对应的文件可能已变化；参数为空时表示全部失效
+    using Listener = std::function<void(const std::string &path)>;
+
+    StatCache(std::string root, std::chrono::milliseconds ttl, Listener listener = {}) :
+        m_root(std::move(root)), m_ttl(ttl), m_listener(std::move(listener)) {
+        m_inotify = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (m_inotify < 0) {
+            spdlog::warn("[StatCache] inotify unavailable ({}), relying on {} ms TTL", std::strerror(errno), ttl.count());
+            return;
+        }
+        watchTree("");
+        m_running = true;
+        m_thread = std::thread(&StatCache::watchLoop, this);
+    }
+
+    StatCache(const StatCache &) = delete;
+    StatCache &operator=(const StatCache &) = delete;
+
+    ~StatCache() {
+        m_running = false;
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+        if (m_inotify >= 0) {
+            ::close(m_inotify);
+        }
+    }
+
+    // path 为以 '/' 开头的规范路径
+    Entry lookup(const std::string &path) {
+        auto now = std::chrono::steady_clock::now();
+        {
+            std::shared_lock<std::shared_mutex> lock(m_mutex);
+            auto it = m_entries.find(path);
+            if (it != m_entries.end() && now < it->second.expires) {
+                metrics::Registry::instance().statCacheHits.inc();
+                return it->second.entry;
+            }
+        }
+        metrics::Registry::instance().statCacheMisses.inc();
+
+        // stat 期间若收到失效事件，结果可能已经过时，不写入缓存
+        uint64_t generation = m_generation.load(std::memory_order_acquire);
+        Entry entry = statPath(m_root + path);
+        bool changed = false;
+        {
+            std::unique_lock<std::shared_mutex> lock(m_mutex);
+            auto it = m_entries.find(path);
+            if (it != m_entries.end()) {
+                const Entry &old = it->second.entry;
+                changed = old.kind != entry.kind || old.mtime != entry.mtime || old.size != entry.size;
+            }
+            if (m_generation.load(std::memory_order_acquire) == generation) {
+                if (it == m_entries.end() && m_entries.size() >= kMaxEntries) {
+                    evict(now);
+                }
+                m_entries[path] = {entry, now + m_ttl};
+            }
+        }
+        // 没有 inotify 时靠这里发现文件被修改
+        if (changed && m_listener) {
+            m_listener(path);
+        }
+        return entry;
+    }
+
+private:
+    // 大量不同路径的 404 扫描不能让缓存无限增长
+    static constexpr size_t kMaxEntries = 64 * 1024;
+    static constexpr uint32_t kWatchMask = IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVED_FROM |
+                                           IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+
+    struct Slot {
+        Entry entry;
+        std::chrono::steady_clock::time_point expires;
+    };
+
+    std::string m_root;
+    std::chrono::milliseconds m_ttl;
+    Listener m_listener;
+
+    std::shared_mutex m_mutex;
+    std::unordered_map<std::string, Slot> m_entries;
+    std::atomic<uint64_t> m_generation{0};
+
+    int m_inotify = -1;
+    std::atomic<bool> m_running{false};
+    std::thread m_thread;
+    // 监视描述符到目录（相对站点根目录，根目录为空串），只由监视线程和构造函数访问
+    std::unordered_map<int, std::string> m_watches;
+
+    static Entry statPath(const std::string &fullPath) {
+        struct stat st {};
+        Entry entry;
+        if (::stat(fullPath.c_str(), &st) != 0) {
+            return entry;
+        }
+        if (S_ISDIR(st.st_mode)) {
+            entry.kind = Kind::Directory;
+        } else {
+            entry.kind = Kind::File;
+            entry.mtime = static_cast<int64_t>(st.st_mtime);
+            entry.size = static_cast<uint64_t>(st.st_size);
+        }
+        return entry;
+    }
+
+    // 先丢弃过期条目，仍然满时整体清空
+    void evict(std::chrono::steady_clock::time_point now) {
+        std::erase_if(m_entries, [now](const auto &item) { return item.second.expires <= now; });
+        if (m_entries.size() >= kMaxEntries) {
+            m_entries.clear();
+        }
+    }
+
+    void invalidate(const std::string &path) {
+        {
+            std::unique_lock<std::shared_mutex> lock(m_mutex);
+            m_generation.fetch_add(1, std::memory_order_acq_rel);
+            if (path.empty()) {
+                m_entries.clear();
+            } else {
+                m_entries.erase(path);
+            }
+        }
+        if (m_listener) {
+            m_listener(path);
+        }
+    }
+
+    void watchTree(const std::string &dir) {
+        addWatch(dir);
+        std::error_code ec;
+        for (std::filesystem::recursive_directory_iterator it(m_root + dir, ec), end; !ec && it != end; it.increment(ec)) {
+            if (it->is_directory(ec)) {
+                addWatch(dir + "/" + it->path().lexically_relative(m_root + dir).string());
+            }
+        }
+    }
+
+    void addWatch(const std::string &dir) {
+        int wd = ::inotify_add_watch(m_inotify, (m_root + dir).c_str(), kWatchMask);
+        if (wd < 0) {
+            spdlog::warn("[StatCache] Cannot watch {}: {}, relying on TTL", m_root + dir, std::strerror(errno));
+            return;
+        }
+        m_watches[wd] = dir;
+    }
+
+    void watchLoop() {
+        alignas(inotify_event) char buffer[16 * 1024];
+        pollfd pfd{m_inotify, POLLIN, 0};
+        while (m_running) {
+            if (::poll(&pfd, 1, 200) <= 0) {
+                continue;
+            }
+            ssize_t n;
+            while ((n = ::read(m_inotify, buffer, sizeof(buffer))) > 0) {
+                for (char *p = buffer; p < buffer + n;) {
+                    auto *event = reinterpret_cast<inotify_event *>(p);
+                    handleEvent(*event);
+                    p += sizeof(inotify_event) + event->len;
+                }
+            }
+        }
+    }
+
+    void handleEvent(const inotify_event &event) {
+        if (event.mask & IN_Q_OVERFLOW) {
+            spdlog::warn("[StatCache] inotify queue overflow, dropping all entries");
+            invalidate("");
+            return;
+        }
+        auto it = m_watches.find(event.wd);
+        if (it == m_watches.end()) {
+            return;
+        }
+        if (event.mask & IN_IGNORED) {
+            m_watches.erase(it);
+            return;
+        }
+        // 目录改名后在新位置重新添加监视时会拿到同一个描述符，映射随之更新，这里不必处理
+        if (event.mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+            return;
+        }
+        std::string path = it->second + "/" + (event.len ? event.name : "");
+        if (event.mask & IN_ISDIR) {
+            // 目录增删或改名影响其下所有路径，全部失效；新目录加入监视
+            if (event.mask & (IN_CREATE | IN_MOVED_TO)) {
+                watchTree(path);
+            }
+            if (event.mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)) {
+                invalidate("");
+                return;
+            }
+        }
+        invalidate(path);
+    }
+};
@@ -12,9 +12,15 @@ public:
     explicit ThreadPool(size_t num_threads);
     ~ThreadPool();
 
+    // 停止接收新任务，执行完队列中剩余任务后回收线程；可重复调用
+    void shutdown();
+
     template <typename F>
     void enqueue(F&& job);
 
+    // 等待执行的任务数
+    size_t queueDepth();
+
 private:
     std::vector<std::thread> threads;
     std::queue<std::function<void()>> jobs;
@@ -42,16 +48,27 @@ ThreadPool::ThreadPool(size_t num_threads) {
 }
 
 ThreadPool::~ThreadPool() {
+    shutdown();
+}
+
+void ThreadPool::shutdown() {
     {
         std::unique_lock<std::mutex> lock(queue_mutex);
         stop = true;
     }
     condition.notify_all();
     for (auto& thread : threads) {
-        thread.join();
+        if (thread.joinable()) {
+            thread.join();
+        }
     }
 }
 
+size_t ThreadPool::queueDepth() {
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    return jobs.size();
+}
+
 template <typename F>
 void ThreadPool::enqueue(F&& job) {
     {
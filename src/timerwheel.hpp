@@ -0,0 +1,172 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// 分层时间轮：4 层 × 64 槽，添加/取消定时器均为 O(1)，
+// 由一个后台线程按 tick 推进，到期回调在该线程中执行（不持锁）
+class TimerWheel {
+public:
+    using TimerId = uint64_t;
+    using Callback = std::function<void()>;
+
+    explicit TimerWheel(std::chrono::milliseconds tick = std::chrono::milliseconds(100)) : m_tick(tick) {}
+
+    ~TimerWheel() { stop(); }
+
+    void start() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_running) {
+            return;
+        }
+        m_running = true;
+        m_start = std::chrono::steady_clock::now();
+        m_currentTick = 0;
+        m_thread = std::thread(&TimerWheel::run, this);
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_running) {
+                return;
+            }
+            m_running = false;
+        }
+        m_cond.notify_all();
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+    }
+
+    TimerId add(std::chrono::milliseconds delay, Callback cb) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        TimerId id = m_nextId++;
+        Timer &timer = m_timers[id];
+        // 以真实时间为基准向上取整，保证不会提前触发
+        auto deadline = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start + delay);
+        auto tick = std::chrono::duration_cast<std::chrono::nanoseconds>(m_tick);
+        timer.expire = (deadline.count() + tick.count() - 1) / tick.count();
+        timer.callback = std::move(cb);
+        place(id, timer);
+        return id;
+    }
+
+    bool cancel(TimerId id) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_timers.find(id);
+        if (it == m_timers.end()) {
+            return false;
+        }
+        m_slots[it->second.level][it->second.slot].erase(it->second.pos);
+        m_timers.erase(it);
+        return true;
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_timers.size();
+    }
+
+private:
+    static constexpr int kLevels = 4;
+    static constexpr int kSlotBits = 6;
+    static constexpr uint64_t kSlots = 1 << kSlotBits;
+
+    struct Timer {
+        uint64_t expire = 0;
+        Callback callback;
+        int level = 0;
+        int slot = 0;
+        std::list<TimerId>::iterator pos;
+    };
+
+    std::chrono::milliseconds m_tick;
+    std::chrono::steady_clock::time_point m_start;
+    uint64_t m_currentTick = 0;
+    TimerId m_nextId = 1;
+
+    std::unordered_map<TimerId, Timer> m_timers;
+    std::list<TimerId> m_slots[kLevels][kSlots];
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::thread m_thread;
+    bool m_running = false;
+
+    // 按剩余 tick 数选择层级：第 n 层每槽覆盖 64^n 个 tick
+    void place(TimerId id, Timer &timer) {
+        if (timer.expire <= m_currentTick) {
+            timer.expire = m_currentTick + 1;
+        }
+        uint64_t delta = timer.expire - m_currentTick;
+        int level = 0;
+        while (level < kLevels - 1 && delta >= (kSlots << (kSlotBits * level))) {
+            ++level;
+        }
+        timer.level = level;
+        timer.slot = static_cast<int>((timer.expire >> (kSlotBits * level)) & (kSlots - 1));
+        auto &slot = m_slots[level][timer.slot];
+        timer.pos = slot.insert(slot.end(), id);
+    }
+
+    // 把高层槽中的定时器重新放置到更精细的层级
+    void cascade(int level) {
+        int index = static_cast<int>((m_currentTick >> (kSlotBits * level)) & (kSlots - 1));
+        std::list<TimerId> pending;
+        pending.swap(m_slots[level][index]);
+        for (TimerId id: pending) {
+            place(id, m_timers[id]);
+        }
+    }
+
+    void advance(std::vector<Callback> &expired) {
+        ++m_currentTick;
+        for (int level = 1; level < kLevels; ++level) {
+            if (m_currentTick & ((uint64_t(1) << (kSlotBits * level)) - 1)) {
+                break;
+            }
+            cascade(level);
+        }
+
+        std::list<TimerId> due;
+        due.swap(m_slots[0][m_currentTick & (kSlots - 1)]);
+        for (TimerId id: due) {
+            auto it = m_timers.find(id);
+            if (it->second.expire <= m_currentTick) {
+                expired.push_back(std::move(it->second.callback));
+                m_timers.erase(it);
+            } else {
+                place(id, it->second);
+            }
+        }
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (m_running) {
+            m_cond.wait_for(lock, m_tick);
+            auto elapsed = std::chrono::steady_clock::now() - m_start;
+            uint64_t target = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() / m_tick.count();
+
+            std::vector<Callback> expired;
+            while (m_currentTick < target) {
+                advance(expired);
+            }
+
+            if (!expired.empty()) {
+                lock.unlock();
+                for (auto &callback: expired) {
+                    callback();
+                }
+                lock.lock();
+            }
+        }
+    }
+};
@@ -0,0 +1,98 @@
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+
+#include "httpscan.hpp"
+
+// 请求路径的解码与规范化：百分号解码、合并重复斜杠、去掉 "." 段并回退 ".." 段（RFC 3986 5.2.4），
+// 一遍原地完成。得到的规范路径可以直接拼接到站点根目录，也用作文件缓存的键。
+// 越过根目录的 ".."、编码后的 '/' 与控制字符一律拒绝，不做修正
+namespace urlpath {
+
+inline int hexValue(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// 原地规范化 data 中的 origin-form 请求目标，返回新长度，非法时返回 npos。
+// 只处理 '?' 之前的路径部分，查询串原样保留。"*"（OPTIONS *）原样返回
+inline size_t normalize(char *data, size_t size) {
+    if (size == 1 && data[0] == '*') {
+        return size;
+    }
+    if (size == 0 || data[0] != '/') {
+        return std::string_view::npos;
+    }
+    const char *end = data + size;
+    const char *special = httpscan::findPathSpecial(data, end);
+    if (special == end || *special == '?') {
+        return size;
+    }
+
+    // 第一个需要处理的位置之前已是规范形式，从它所在段的 '/' 开始改写。改写只会缩短路径，写位置不会超过读位置
+    const char *queryStart = static_cast<const char *>(std::memchr(special, '?', end - special));
+    size_t pathEnd = queryStart ? queryStart - data : size;
+    size_t read = special - data;
+    while (data[read] != '/') {
+        --read;
+    }
+    size_t write = read;
+    bool directory = false;
+    while (read < pathEnd) {
+        // data[read] 是段前的 '/'
+        size_t slash = write;
+        data[write++] = '/';
+        ++read;
+        size_t segment = write;
+        while (read < pathEnd && data[read] != '/') {
+            char c = data[read];
+            if (c == '%') {
+                int high = read + 2 < pathEnd ? hexValue(data[read + 1]) : -1;
+                int low = high >= 0 ? hexValue(data[read + 2]) : -1;
+                if (low < 0) {
+                    return std::string_view::npos;
+                }
+                c = static_cast<char>(high << 4 | low);
+                read += 3;
+            } else {
+                ++read;
+            }
+            if (c == '/' || static_cast<unsigned char>(c) < 0x20 || c == 0x7f) {
+                return std::string_view::npos;
+            }
+            data[write++] = c;
+        }
+
+        std::string_view name(data + segment, write - segment);
+        directory = name.empty() || name == "." || name == "..";
+        if (name == "..") {
+            if (slash == 0) {
+                return std::string_view::npos;
+            }
+            // 回退到上一段的 '/'
+            write = slash - 1;
+            while (data[write] != '/') {
+                --write;
+            }
+        } else if (directory) {
+            write = slash;
+        }
+    }
+    // 以 '/'、"." 或 ".." 结尾的路径指向目录，保留结尾的 '/'
+    if (write == 0 || directory) {
+        data[write++] = '/';
+    }
+    std::memmove(data + write, data + pathEnd, size - pathEnd);
+    return write + (size - pathEnd);
+}
+
+} // namespace urlpath
@@ -0,0 +1,209 @@
+#pragma once
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <netinet/in.h>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// 测试用的最小 RESP 服务器：监听 127.0.0.1 的随机端口，支持 GET、MGET、SET（含 EX）、DEL。
+// 记录收到的命令名以便检查合并与流水线；过期时间按可手动推进的时钟计算，测试不必真的等待
+class RespStub {
+public:
+    RespStub() {
+        m_listenFd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        sockaddr_in addr {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        if (::bind(m_listenFd, reinterpret_cast<sockaddr *>(&addr), len) == -1 || ::listen(m_listenFd, 16) == -1 ||
+            ::getsockname(m_listenFd, reinterpret_cast<sockaddr *>(&addr), &len) == -1) {
+            throw std::runtime_error("RespStub: cannot listen");
+        }
+        m_port = ntohs(addr.sin_port);
+        m_acceptThread = std::thread([this] { acceptLoop(); });
+    }
+
+    ~RespStub() {
+        m_stopped = true;
+        ::shutdown(m_listenFd, SHUT_RDWR);
+        ::close(m_listenFd);
+        m_acceptThread.join();
+        disconnectAll();
+        for (auto &thread: m_clientThreads) {
+            thread.join();
+        }
+    }
+
+    uint16_t port() const { return m_port; }
+
+    size_t connections() const { return m_connections; }
+
+    // 收到的命令名（大写），按到达顺序
+    std::vector<std::string> commands() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_commands;
+    }
+
+    void clearCommands() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_commands.clear();
+    }
+
+    // 之后的每条命令先等待这么久再应答，让客户端的请求在队列中积压
+    void setReplyDelay(std::chrono::milliseconds delay) { m_delayMs = delay.count(); }
+
+    void advance(std::chrono::seconds seconds) { m_clockOffset += seconds.count(); }
+
+    // 断开所有已建立的连接，模拟服务器重启（数据保留）
+    void disconnectAll() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (int fd: m_clientFds) {
+            ::shutdown(fd, SHUT_RDWR);
+        }
+    }
+
+private:
+    int m_listenFd = -1;
+    uint16_t m_port = 0;
+    std::atomic<bool> m_stopped{false};
+    std::atomic<size_t> m_connections{0};
+    std::atomic<int64_t> m_delayMs{0};
+    std::atomic<int64_t> m_clockOffset{0};
+    std::thread m_acceptThread;
+    std::vector<std::thread> m_clientThreads;
+
+    std::mutex m_mutex;
+    std::vector<int> m_clientFds;
+    std::vector<std::string> m_commands;
+    // 值与过期时刻（stub 时钟的秒数，0 表示不过期）
+    std::map<std::string, std::pair<std::string, int64_t>> m_data;
+
+    int64_t now() const {
+        return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count() +
+               m_clockOffset;
+    }
+
+    void acceptLoop() {
+        while (!m_stopped) {
+            int fd = ::accept4(m_listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd == -1) {
+                continue;
+            }
+            ++m_connections;
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_clientFds.push_back(fd);
+            m_clientThreads.emplace_back([this, fd] { serve(fd); });
+        }
+    }
+
+    void serve(int fd) {
+        std::string buffer;
+        std::vector<std::string> args;
+        while (parse(fd, buffer, args)) {
+            if (m_delayMs > 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(m_delayMs));
+            }
+            std::string reply = execute(args);
+            if (::send(fd, reply.data(), reply.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(reply.size())) {
+                break;
+            }
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::erase(m_clientFds, fd);
+        ::close(fd);
+    }
+
+    static bool fill(int fd, std::string &buffer) {
+        char chunk[4096];
+        ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) {
+            return false;
+        }
+        buffer.append(chunk, n);
+        return true;
+    }
+
+    static bool readLine(int fd, std::string &buffer, std::string &line) {
+        size_t end;
+        while ((end = buffer.find("\r\n")) == std::string::npos) {
+            if (!fill(fd, buffer)) {
+                return false;
+            }
+        }
+        line = buffer.substr(0, end);
+        buffer.erase(0, end + 2);
+        return true;
+    }
+
+    // 只接受客户端发送的数组形式：*N\r\n 后跟 N 个 bulk string
+    static bool parse(int fd, std::string &buffer, std::vector<std::string> &args) {
+        std::string line;
+        if (!readLine(fd, buffer, line) || line.empty() || line[0] != '*') {
+            return false;
+        }
+        args.assign(std::stoul(line.substr(1)), {});
+        for (auto &arg: args) {
+            if (!readLine(fd, buffer, line) || line.empty() || line[0] != '$') {
+                return false;
+            }
+            size_t length = std::stoul(line.substr(1));
+            while (buffer.size() < length + 2) {
+                if (!fill(fd, buffer)) {
+                    return false;
+                }
+            }
+            arg = buffer.substr(0, length);
+            buffer.erase(0, length + 2);
+        }
+        return !args.empty();
+    }
+
+    static std::string bulk(const std::string *value) {
+        return value ? "$" + std::to_string(value->size()) + "\r\n" + *value + "\r\n" : "$-1\r\n";
+    }
+
+    const std::string *lookup(const std::string &key) {
+        auto it = m_data.find(key);
+        if (it == m_data.end()) {
+            return nullptr;
+        }
+        if (it->second.second != 0 && it->second.second <= now()) {
+            m_data.erase(it);
+            return nullptr;
+        }
+        return &it->second.first;
+    }
+
+    std::string execute(const std::vector<std::string> &args) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const std::string &name = args[0];
+        m_commands.push_back(name);
+        if (name == "GET" && args.size() == 2) {
+            return bulk(lookup(args[1]));
+        }
+        if (name == "MGET" && args.size() >= 2) {
+            std::string reply = "*" + std::to_string(args.size() - 1) + "\r\n";
+            for (size_t i = 1; i < args.size(); ++i) {
+                reply += bulk(lookup(args[i]));
+            }
+            return reply;
+        }
+        if (name == "SET" && (args.size() == 3 || (args.size() == 5 && args[3] == "EX"))) {
+            int64_t expiry = args.size() == 5 ? now() + std::stoll(args[4]) : 0;
+            m_data[args[1]] = {args[2], expiry};
+            return "+OK\r\n";
+        }
+        if (name == "DEL" && args.size() == 2) {
+            return ":" + std::to_string(m_data.erase(args[1])) + "\r\n";
+        }
+        return "-ERR unknown command '" + name + "'\r\n";
+    }
+};
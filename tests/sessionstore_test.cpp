@@ -0,0 +1,123 @@
+// RespSessionStore 对照 tests/resp_stub.hpp 中的最小 RESP 服务器：
+// 读写往返、连续 GET 合并为 MGET、SET EX 过期、服务器断开后重连。失败时返回非零，由 ctest 运行
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "resp_stub.hpp"
+#include "sessionstore.hpp"
+
+static int g_failures = 0;
+
+#define CHECK(cond)                                                                                                    \
+    do {                                                                                                               \
+        if (!(cond)) {                                                                                                 \
+            std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond);                              \
+            ++g_failures;                                                                                              \
+        }                                                                                                              \
+    } while (0)
+
+static int64_t unixNow() {
+    return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// 关闭本地读缓存，每次读取都经过服务器
+static RespSessionStore makeStore(const RespStub &stub) {
+    return RespSessionStore("127.0.0.1", stub.port(), std::chrono::milliseconds(0));
+}
+
+static void testRoundTrip() {
+    RespStub stub;
+    auto store = makeStore(stub);
+    CHECK(store.put("s1", {unixNow() + 60, "alice"}));
+    auto record = store.get("s1");
+    CHECK(record && record->user == "alice");
+    CHECK(!store.get("missing"));
+    store.remove("s1");
+    CHECK(!store.get("s1"));
+}
+
+static void testGetsMergedIntoMget() {
+    RespStub stub;
+    auto store = makeStore(stub);
+    constexpr int kReaders = 16;
+    for (int i = 0; i < kReaders; ++i) {
+        store.put("s" + std::to_string(i), {unixNow() + 60, "user" + std::to_string(i)});
+    }
+    CHECK(store.get("s0"));
+    stub.clearCommands();
+
+    // 第一条 GET 的应答被推迟，其余读取在队列中积压，下一批应合并为 MGET
+    stub.setReplyDelay(std::chrono::milliseconds(100));
+    std::vector<std::thread> readers;
+    std::vector<int> matched(kReaders, 0);
+    for (int i = 0; i < kReaders; ++i) {
+        readers.emplace_back([&store, &matched, i] {
+            auto record = store.get("s" + std::to_string(i));
+            matched[i] = record && record->user == "user" + std::to_string(i);
+        });
+        if (i == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+    }
+    for (auto &reader: readers) {
+        reader.join();
+    }
+    CHECK(std::all_of(matched.begin(), matched.end(), [](int ok) { return ok; }));
+    auto commands = stub.commands();
+    CHECK(std::count(commands.begin(), commands.end(), "MGET") >= 1);
+    CHECK(commands.size() < static_cast<size_t>(kReaders));
+}
+
+static void testSetExExpires() {
+    RespStub stub;
+    auto store = makeStore(stub);
+    store.put("s1", {unixNow() + 5, "alice"});
+    CHECK(store.get("s1"));
+    stub.advance(std::chrono::seconds(6));
+    CHECK(!store.get("s1"));
+
+    // 已过期的记录不写入，而是删除
+    store.put("s2", {unixNow() + 60, "bob"});
+    store.put("s2", {unixNow() - 1, "bob"});
+    CHECK(!store.get("s2"));
+    auto commands = stub.commands();
+    CHECK(std::count(commands.begin(), commands.end(), "DEL") == 1);
+}
+
+static void testReconnects() {
+    RespStub stub;
+    auto store = makeStore(stub);
+    store.put("s1", {unixNow() + 60, "alice"});
+    CHECK(store.get("s1"));
+    CHECK(stub.connections() == 1);
+
+    stub.disconnectAll();
+    // 断开后的第一批请求失败，之后按重连间隔重新连接
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    std::optional<SessionRecord> record;
+    while (!record && std::chrono::steady_clock::now() < deadline) {
+        record = store.get("s1");
+        if (!record) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+    CHECK(record && record->user == "alice");
+    CHECK(stub.connections() == 2);
+}
+
+int main() {
+    spdlog::set_level(spdlog::level::err);
+    testRoundTrip();
+    testGetsMergedIntoMget();
+    testSetExExpires();
+    testReconnects();
+    if (g_failures) {
+        std::fprintf(stderr, "%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    std::printf("all session store tests passed\n");
+    return 0;
+}
@@ -0,0 +1,47 @@
+// 站点打包工具：把站点目录打成一个打包文件（格式见 src/sitebundle.hpp），配置 site.bundle 指向它即可直接服务。
+//
+//   ./sitepack sites/demo1 sites/demo1.bundle
+//
+// 写完后重新映射一遍，确认每个文件都能查到
+#include <cstdio>
+#include <spdlog/spdlog.h>
+#include <string>
+
+#include "sitebundle.hpp"
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        std::fprintf(stderr, "usage: %s <site-dir> <output-bundle>\n", argv[0]);
+        return 2;
+    }
+    std::string root = argv[1];
+    std::string output = argv[2];
+    if (root.size() > 1 && root.back() == '/') {
+        root.pop_back();
+    }
+
+    auto snapshot = SiteSnapshot::build(root, kStaticCacheControl);
+    if (!snapshot) {
+        return 1;
+    }
+    if (!SiteBundle::write(*snapshot, output)) {
+        return 1;
+    }
+
+    auto bundle = SiteBundle::open(output);
+    if (!bundle) {
+        return 1;
+    }
+    for (const auto &file: snapshot->files()) {
+        auto packed = bundle->find(file.path);
+        if (!packed || packed->content != file.content || packed->gzip != file.gzip) {
+            spdlog::error("[sitepack] Verification failed for {}", file.path);
+            return 1;
+        }
+    }
+
+    const auto &stats = snapshot->stats();
+    spdlog::info("[sitepack] Packed {} file(s) from {} into {}: {} KB of content, {} KB gzip, {} KB on disk", stats.files,
+                 root, output, stats.bytes / 1024, stats.gzipBytes / 1024, bundle->size() / 1024);
+    return 0;
+}